@@ -99,6 +99,12 @@
 #if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
 #define _POSIX_C_SOURCE 200809L
 #endif
+/* Linux 下实现单元同时保留 glibc 默认扩展（syscall、wait4、MAP_ANONYMOUS 等）；
+ * 只包含声明的文件不改变特性测试宏，缺少扩展时相应功能自动退化 */
+#if defined(__linux__) && defined(EZCTEST_IMPLEMENTATION) &&                   \
+    !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
 
 /* VC6 特殊支持：使用 Magic Number + 内存扫描实现自动注册 */
 
@@ -171,6 +177,13 @@ EZCTEST_DISABLE_UNUSED_FUNCTION_BEGIN
 #define EZCTEST_PLATFORM_LINUX
 #endif
 
+/* 多线程基准测试（BENCHMARK_THREADS）需要定义 EZCTEST_THREADS 才启用：
+ * POSIX 下要链接 -pthread（glibc 2.34 之前），默认不引入这个依赖；
+ * 未启用时 BENCHMARK_THREADS 在调用线程上测量。裸机没有线程 */
+#if defined(EZCTEST_THREADS) && !defined(EZCTEST_STM32_MODE)
+#define EZCTEST_THREADS_AVAILABLE
+#endif
+
 /* 检测MSVC编译器 */
 #if defined(_MSC_VER)
 #define EZCTEST_COMPILER_MSVC
@@ -218,6 +231,10 @@ EZCTEST_DISABLE_UNUSED_FUNCTION_BEGIN
 #endif
 #include <io.h>
 #include <windows.h>
+/* VC8+：_ReadWriteBarrier（基准测试的优化屏障使用） */
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+#include <intrin.h>
+#endif
 
 /* VC7-VC9兼容性：显式声明IsDebuggerPresent */
 #if defined(_MSC_VER) && _MSC_VER >= 1300 && _MSC_VER < 1600
@@ -260,16 +277,28 @@ WINBASEAPI BOOL WINAPI IsDebuggerPresent(VOID);
 #else
 /* Linux/Unix特定头文件 */
 #ifndef EZCTEST_STM32_MODE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/types.h>
 #include <unistd.h>
+#ifdef EZCTEST_THREADS_AVAILABLE
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #endif
 #endif
 
-/* C++标准库（用于异常处理和值格式化） */
+/* C++标准库（用于异常处理、值格式化和 operator new 拦截） */
 #ifdef __cplusplus
 #include <exception>
+#include <new>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -287,6 +316,22 @@ WINBASEAPI BOOL WINAPI IsDebuggerPresent(VOID);
 #define EZCTEST_HAS_GENERIC 1
 #endif
 
+/* ============================================================================
+ * 64位整数类型
+ * ========================================================================== */
+
+/* VC6-VC9 没有 <stdint.h>；C++98 -pedantic 不接受 long long 字面量，
+ * 因此64位常量统一用 EZCTEST_U64_C(高32位, 低32位) 拼接 */
+#if defined(_MSC_VER) && _MSC_VER < 1600
+typedef unsigned __int64 ezctest_u64;
+#else
+#include <stdint.h>
+typedef uint64_t ezctest_u64;
+#endif
+
+#define EZCTEST_U64_C(hi, lo)                                                  \
+  ((((ezctest_u64)(hi)) << 32) | (ezctest_u64)(lo))
+
 /* ============================================================================
  * 配置选项
  * ========================================================================== */
@@ -319,7 +364,7 @@ WINBASEAPI BOOL WINAPI IsDebuggerPresent(VOID);
 #define EZCTEST_STM32_CMD_BUFFER_SIZE 128
 #endif
 
-/* DEFER清理回调栈大小 */
+/* DEFER清理回调栈的内联容量（不分配内存的部分） */
 #ifndef EZCTEST_MAX_DEFER_CALLBACKS
 #ifdef EZCTEST_STM32_MODE
 #define EZCTEST_MAX_DEFER_CALLBACKS 8
@@ -328,6 +373,176 @@ WINBASEAPI BOOL WINAPI IsDebuggerPresent(VOID);
 #endif
 #endif
 
+/* 内联容量用完后每次向堆申请的回调个数（STM32 下不扩展，栈满即失败） */
+#ifndef EZCTEST_DEFER_CHUNK_SIZE
+#define EZCTEST_DEFER_CHUNK_SIZE 256
+#endif
+
+/* DEFER_SCOPE_BEGIN 的最大嵌套深度，更深的作用域在外层结束时一并执行 */
+#ifndef EZCTEST_DEFER_MAX_SCOPES
+#define EZCTEST_DEFER_MAX_SCOPES 16
+#endif
+
+/* 测试内存池（ezctest_arena_alloc）每次向系统申请的块大小和默认对齐 */
+#ifndef EZCTEST_ARENA_BLOCK_SIZE
+#ifdef EZCTEST_STM32_MODE
+#define EZCTEST_ARENA_BLOCK_SIZE 1024
+#else
+#define EZCTEST_ARENA_BLOCK_SIZE (64 * 1024)
+#endif
+#endif
+#ifndef EZCTEST_ARENA_ALIGN
+#define EZCTEST_ARENA_ALIGN 16
+#endif
+/* 可选：定义 EZCTEST_ARENA_POISON 为一个字节值（如 0xA5），测试结束回收时
+ * 用它填充内存池，悬空指针读到的是明显的垃圾值；
+ * 定义 EZCTEST_ARENA_GUARD 后每次分配单独映射，末尾紧贴一个不可访问的
+ * 保护页，越界写立即崩溃（隔离子进程报告信号），回收后访问同样崩溃。
+ * 此时 ezctest_arena_alloc/EZCTEST_ALLOC 的对齐降为整除大小的最大 2 的幂
+ * （不超过 EZCTEST_ARENA_ALIGN），数据恰好结束在保护页前；
+ * ezctest_arena_alloc_aligned 指定的对齐不整除大小时，末尾会留下不到
+ * align 字节的空隙，写入空隙不会被发现 */
+
+/* 每个测试同时存在的保护页分配（ezctest_guarded_alloc）个数上限 */
+#ifndef EZCTEST_GUARDED_MAX
+#define EZCTEST_GUARDED_MAX 64
+#endif
+
+/* 文本差异比较的内存预算（字节），差异区间按预算分窗口比较 */
+#ifndef EZCTEST_DIFF_MEMORY_BUDGET
+#ifdef EZCTEST_STM32_MODE
+#define EZCTEST_DIFF_MEMORY_BUDGET (16 * 1024)
+#else
+#define EZCTEST_DIFF_MEMORY_BUDGET (8 * 1024 * 1024)
+#endif
+#endif
+
+/* 文本差异输出的上下文行数 */
+#ifndef EZCTEST_DIFF_CONTEXT_LINES
+#define EZCTEST_DIFF_CONTEXT_LINES 3
+#endif
+
+/* 文本差异最多输出的行数 */
+#ifndef EZCTEST_DIFF_MAX_OUTPUT_LINES
+#ifdef EZCTEST_STM32_MODE
+#define EZCTEST_DIFF_MAX_OUTPUT_LINES 40
+#else
+#define EZCTEST_DIFF_MAX_OUTPUT_LINES 200
+#endif
+#endif
+
+/* 文本差异中单行最多显示的字符数 */
+#ifndef EZCTEST_DIFF_LINE_WIDTH
+#ifdef EZCTEST_STM32_MODE
+#define EZCTEST_DIFF_LINE_WIDTH 80
+#else
+#define EZCTEST_DIFF_LINE_WIDTH 160
+#endif
+#endif
+
+/* 不超过该长度的单行字符串仍按原格式直接打印 */
+#ifndef EZCTEST_STREQ_INLINE_LIMIT
+#define EZCTEST_STREQ_INLINE_LIMIT 80
+#endif
+
+/* 文件读取缓冲区大小（哈希/文件比较断言使用） */
+#ifndef EZCTEST_IO_BUFFER_SIZE
+#ifdef EZCTEST_STM32_MODE
+#define EZCTEST_IO_BUFFER_SIZE 512
+#else
+#define EZCTEST_IO_BUFFER_SIZE (1024 * 1024)
+#endif
+#endif
+
+/* 文件映射窗口大小：大文件按窗口依次映射，常驻内存与文件大小无关
+ * （需为页大小和 Windows 分配粒度 64KB 的整数倍） */
+#ifndef EZCTEST_MAP_WINDOW_SIZE
+#define EZCTEST_MAP_WINDOW_SIZE (64UL * 1024 * 1024)
+#endif
+
+/* 性能预算作用域（EXPECT_DURATION_LT_US 等）的最大嵌套深度 */
+#ifndef EZCTEST_PERF_MAX_DEPTH
+#define EZCTEST_PERF_MAX_DEPTH 4
+#endif
+
+/* 自定义时钟：裸机平台（如 STM32）可定义为返回单调纳秒数的表达式，
+ * 例如由 DWT->CYCCNT 或 HAL_GetTick() 换算；定义后在所有平台上优先使用。
+ * EZCTEST_USER_CPU_TIME_NS() 同理；STM32 未定义时 CPU 时间等于墙钟时间
+ *   #define EZCTEST_USER_NOW_NS() my_board_now_ns()
+ */
+
+/* 子进程上报记录与基准测试基线文件的最大行长度 */
+#ifndef EZCTEST_CHANNEL_LINE_MAX
+#define EZCTEST_CHANNEL_LINE_MAX 4096
+#endif
+
+/* 硬件性能计数器（--ezctest_perf_counters）同时打开的最大个数 */
+#ifndef EZCTEST_PERF_MAX_COUNTERS
+#define EZCTEST_PERF_MAX_COUNTERS 8
+#endif
+
+/* 基准测试单轮测量的最短时间（毫秒），迭代次数自动放大直到达到该时间 */
+#ifndef EZCTEST_BENCH_MIN_TIME_MS
+#define EZCTEST_BENCH_MIN_TIME_MS 200
+#endif
+
+/* 基准测试迭代次数上限（防止空循环被无限放大） */
+#ifndef EZCTEST_BENCH_MAX_ITERATIONS
+#define EZCTEST_BENCH_MAX_ITERATIONS 1000000000UL
+#endif
+
+/* 基准测试默认的预热轮数（结果丢弃）和正式重复轮数 */
+#ifndef EZCTEST_BENCH_WARMUP
+#define EZCTEST_BENCH_WARMUP 1
+#endif
+#ifndef EZCTEST_BENCH_REPETITIONS
+#define EZCTEST_BENCH_REPETITIONS 5
+#endif
+
+/* bootstrap 置信区间的重采样次数 */
+#ifndef EZCTEST_STATS_BOOTSTRAP
+#define EZCTEST_STATS_BOOTSTRAP 1000
+#endif
+
+/* 样本数少于此值时不剔除离群值（样本太少，MAD 估计不可靠） */
+#ifndef EZCTEST_STATS_MIN_OUTLIER_SAMPLES
+#define EZCTEST_STATS_MIN_OUTLIER_SAMPLES 5
+#endif
+
+/* BENCHMARK_RANGE 最多测量的输入规模个数 */
+#ifndef EZCTEST_BENCH_MAX_RANGE_POINTS
+#define EZCTEST_BENCH_MAX_RANGE_POINTS 32
+#endif
+
+/* 基线比较的显著性水平（单侧 Mann-Whitney U 检验） */
+#ifndef EZCTEST_BENCH_ALPHA
+#define EZCTEST_BENCH_ALPHA 0.05
+#endif
+
+/* 测量前忙等预热 CPU 的时间（毫秒），让频率升到稳态 */
+#ifndef EZCTEST_CPU_WARMUP_MS
+#define EZCTEST_CPU_WARMUP_MS 100
+#endif
+
+/* 泄漏检测（--ezctest_leak_check）为每个块记录的调用栈深度，
+ * 以及每个测试最多列出的不同泄漏位置个数 */
+#ifndef EZCTEST_LEAK_BACKTRACE_DEPTH
+#define EZCTEST_LEAK_BACKTRACE_DEPTH 6
+#endif
+#ifndef EZCTEST_LEAK_MAX_REPORTS
+#define EZCTEST_LEAK_MAX_REPORTS 5
+#endif
+
+/* 1分钟平均负载超过在线 CPU 数的该比例时警告系统繁忙 */
+#ifndef EZCTEST_ENV_MAX_LOAD
+#define EZCTEST_ENV_MAX_LOAD 0.5
+#endif
+
+/* 变异系数超过该值时标记测量不稳定 */
+#ifndef EZCTEST_STATS_UNSTABLE_CV
+#define EZCTEST_STATS_UNSTABLE_CV 0.05
+#endif
+
 /* ============================================================================
  * 颜色输出支持
  * ========================================================================== */
@@ -365,18 +580,161 @@ typedef struct {
   int failed_assertions; /* 失败的断言数 */
 } ezctest_result_t;
 
+/* ============================================================================
+ * 断言位置记录
+ * ========================================================================== */
+
+/* Site magic number: "SITE" = 0x45544953（MSVC 内存扫描用） */
+#define EZCTEST_SITE_MAGIC 0x45544953
+
+/**
+ * @brief 断言位置记录：每个 EXPECT_* 和 ASSERT_* 展开处拥有一个静态实例
+ * @note 通过断言只执行一次 passed++；失败时 failed++
+ */
+typedef struct ezctest_site {
+  unsigned int magic;        /* EZCTEST_SITE_MAGIC */
+  const char *file;          /* 所在文件 */
+  int line;                  /* 所在行 */
+  const char *expr;          /* 断言文本，如 "EXPECT_EQ(a, b)" */
+  unsigned long passed;      /* 通过次数 */
+  unsigned long failed;      /* 失败次数 */
+  struct ezctest_site *next; /* 已登记位置的链表 */
+  int linked;                /* 是否已登记 */
+} ezctest_site_t;
+
+/*
+ * 位置登记方式：
+ * - ELF + GCC/Clang：把位置指针放入 ezctest_sites 段，启动时枚举
+ * - MSVC：启动时与测试注册一起做 magic number 内存扫描
+ * - 其他情况：首次执行时登记（从未执行的位置不会出现在报告中）。
+ *   C++ 以 -fPIC（非 PIE）编译时 inline 函数中静态变量的地址可被抢占，
+ *   不是链接时常量，写不进段，也走这一路
+ */
+#if defined(__ELF__) && defined(__GNUC__) && !defined(EZCTEST_STM32_MODE)
+#define EZCTEST_SITE_COLLECT /* 实现端枚举段 */
+#if !defined(__cplusplus) || !defined(__PIC__) || defined(__PIE__)
+#define EZCTEST_SITE_SECTION /* 断言宏写入段条目 */
+#endif
+#endif
+#if defined(EZCTEST_SITE_SECTION) || defined(_MSC_VER)
+#define EZCTEST_SITES_ENUMERABLE
+#endif
+
+#if defined(EZCTEST_SITE_SECTION) && defined(__cplusplus)
+/* C++ 的 inline 函数和模板中的静态变量位于 COMDAT 组，带 section 属性的
+ * 指针变量会和普通函数中的条目引起 "section type conflict"；
+ * 改由函数体内的汇编把地址写进段（同一位置可能有多个条目，登记时去重） */
+#if defined(__LP64__) || defined(_LP64)
+#define EZCTEST_SITE_WORD ".quad"
+#else
+#define EZCTEST_SITE_WORD ".long"
+#endif
+#define EZCTEST_SITE(text)                                                     \
+  static ezctest_site_t ezctest_site = {                                       \
+      EZCTEST_SITE_MAGIC, __FILE__, __LINE__, text, 0, 0, NULL, 0};            \
+  __asm__(".pushsection ezctest_sites,\"aw\"\n\t" EZCTEST_SITE_WORD            \
+          " %c0\n\t.popsection" ::"i"(&ezctest_site))
+#elif defined(EZCTEST_SITE_SECTION)
+#define EZCTEST_SITE(text)                                                     \
+  static ezctest_site_t ezctest_site = {                                       \
+      EZCTEST_SITE_MAGIC, __FILE__, __LINE__, text, 0, 0, NULL, 0};            \
+  static ezctest_site_t *const ezctest_site_entry                              \
+      __attribute__((section("ezctest_sites"), used)) = &ezctest_site
+#else
+#define EZCTEST_SITE(text)                                                     \
+  static ezctest_site_t ezctest_site = {                                       \
+      EZCTEST_SITE_MAGIC, __FILE__, __LINE__, text, 0, 0, NULL, 0}
+#endif
+
+/* 多线程基准测试的各个线程可能同时执行同一个断言：工作线程运行期间
+ * （g_ezctest_threads_active）计数用原子加，其余时间只有一个线程，
+ * 通过的断言仍然只是一次内存加法；首次登记（插入链表）加锁 */
+#if !defined(EZCTEST_THREADS_AVAILABLE)
+#define EZCTEST_SITE_INC(counter) ((counter)++)
+#elif defined(EZCTEST_PLATFORM_WINDOWS)
+#define EZCTEST_SITE_INC(counter)                                              \
+  (g_ezctest_threads_active                                                    \
+       ? (void)InterlockedIncrement((LONG *)&(counter))                        \
+       : (void)(counter)++)
+#elif defined(__GNUC__)
+#define EZCTEST_SITE_INC(counter)                                              \
+  (g_ezctest_threads_active ? (void)__sync_fetch_and_add(&(counter), 1)        \
+                            : (void)(counter)++)
+#endif
+
+#if !defined(EZCTEST_SITE_INC)
+/* 编译器没有原子加：加锁计数 */
+#define EZCTEST_SITE_PASSED() ezctest_site_hit(&ezctest_site, 1)
+#define EZCTEST_SITE_FAILED() ezctest_site_hit(&ezctest_site, 0)
+#elif defined(EZCTEST_SITES_ENUMERABLE)
+#define EZCTEST_SITE_PASSED() EZCTEST_SITE_INC(ezctest_site.passed)
+#define EZCTEST_SITE_FAILED() EZCTEST_SITE_INC(ezctest_site.failed)
+#else
+#define EZCTEST_SITE_PASSED()                                                  \
+  ((void)(ezctest_site.linked || ezctest_site_link(&ezctest_site)),            \
+   EZCTEST_SITE_INC(ezctest_site.passed))
+#define EZCTEST_SITE_FAILED()                                                  \
+  ((void)(ezctest_site.linked || ezctest_site_link(&ezctest_site)),            \
+   EZCTEST_SITE_INC(ezctest_site.failed))
+#endif
+
 /* ============================================================================
  * 测试用例定义
  * ========================================================================== */
 
 typedef void (*ezctest_func_t)(void);
 
+/**
+ * @brief 基准测试状态：BENCHMARK 函数通过 BENCHMARK_LOOP(state) 驱动迭代
+ * @note iterations 是本轮要执行的迭代次数，由框架自动标定，只读
+ */
+typedef struct {
+  unsigned long iterations;    /* 本轮迭代次数 */
+  unsigned long remaining;     /* 剩余迭代次数（BENCHMARK_LOOP 内部使用） */
+  int started;                 /* 计时是否已开始 */
+  ezctest_u64 start_ns;        /* 计时起点 */
+  ezctest_u64 elapsed_ns;      /* 本轮迭代耗时 */
+  unsigned long range;         /* 输入规模（BENCHMARK_RANGE，否则为0） */
+  int complexity;              /* EXPECT_COMPLEXITY 声明的上界（0=未声明） */
+  const char *complexity_file; /* EXPECT_COMPLEXITY 所在文件 */
+  int complexity_line;         /* EXPECT_COMPLEXITY 所在行 */
+  int thread_index;            /* 线程编号（BENCHMARK_THREADS，从0开始） */
+  int threads;                 /* 本轮线程数（单线程基准测试为1） */
+  void *gate;                  /* 多线程起跑线（框架内部使用） */
+} ezctest_bench_state_t;
+
+/* ezctest_bench_state_t::started 的取值 */
+#define EZCTEST_BENCH_IDLE 0
+#define EZCTEST_BENCH_TIMING 1
+#define EZCTEST_BENCH_DONE 2
+
+typedef void (*ezctest_bench_func_t)(ezctest_bench_state_t *state);
+
+/**
+ * @brief BENCHMARK_RANGE 的输入规模：lo, lo*m, lo*m*m, ... 直到 hi（含 hi）
+ */
+typedef struct {
+  unsigned long lo;         /* 最小规模 */
+  unsigned long hi;         /* 最大规模 */
+  unsigned long multiplier; /* 相邻规模的倍数（小于2时只测 lo） */
+} ezctest_bench_range_t;
+
+/* 复杂度类别（EXPECT_COMPLEXITY 使用），数值越大增长越快 */
+#define EZCTEST_O_1 1
+#define EZCTEST_O_LOG_N 2
+#define EZCTEST_O_N 3
+#define EZCTEST_O_N_LOG_N 4
+#define EZCTEST_O_N_SQUARED 5
+
 typedef struct {
-  const char *suite_name;   /* 测试套件名称 */
-  const char *test_name;    /* 测试用例名称 */
-  ezctest_func_t test_func; /* 测试函数指针 */
-  int enabled;              /* 是否启用 */
-  int failed;               /* 本轮测试是否失败 */
+  const char *suite_name;                   /* 测试套件名称 */
+  const char *test_name;                    /* 测试用例名称 */
+  ezctest_func_t test_func;                 /* 测试函数指针 */
+  int enabled;                              /* 是否启用 */
+  int failed;                               /* 本轮测试是否失败 */
+  ezctest_bench_func_t bench_func;          /* 基准测试函数（普通测试为NULL） */
+  const ezctest_bench_range_t *bench_range; /* 输入规模范围（可为NULL） */
+  int bench_threads;                        /* 最大线程数（0=单线程） */
 } ezctest_info_t;
 
 /* ============================================================================
@@ -400,12 +758,31 @@ typedef struct {
 
 /* 测试配置类型 */
 typedef struct {
-  const char *filter; /* 测试过滤器 */
-  int repeat;         /* 重复次数 */
-  int shuffle;        /* 是否随机顺序 */
-  int color;          /* 彩色输出 */
-  int list_tests;     /* 仅列出测试 */
-  int no_exec;        /* 禁用多进程隔离 (-1=自动, 0=启用, 1=禁用) */
+  const char *filter;        /* 测试过滤器 */
+  int repeat;                /* 重复次数 */
+  int shuffle;               /* 是否随机顺序 */
+  int color;                 /* 彩色输出 */
+  int list_tests;            /* 仅列出测试 */
+  int no_exec;               /* 禁用多进程隔离 (-1=自动, 0=启用, 1=禁用) */
+  int update_golden;         /* 用实际输出重写黄金文件而不是比较 */
+  int assertion_report;      /* 结束时输出每个断言位置的统计 */
+  int benchmarks;            /* 运行基准测试而不是普通测试 */
+  const char *perf_counters; /* 硬件性能计数器列表（逗号分隔） */
+  int bench_warmup;          /* 基准测试预热轮数 */
+  int bench_repetitions;     /* 基准测试重复轮数 */
+  const char *bench_save;    /* 基准测试结果保存为基线的文件 */
+  const char *bench_compare; /* 与之比较的基线文件 */
+  double bench_threshold;    /* 回归阈值（百分比） */
+  const char *cpu_list;      /* 绑定的 CPU 列表（逗号分隔，可含范围） */
+  int leak_check;            /* 检查每个测试结束后未释放的堆内存 */
+  int rusage;                /* 输出每个隔离子进程的资源占用 */
+  const char *rusage_report; /* 资源占用写入的报告文件 */
+  int fork_template;         /* 每个套件的 SETUP 只在模板进程中执行一次 */
+  double max_rss;            /* 子进程地址空间上限（字节，0=不限） */
+  double max_cpu;            /* 子进程 CPU 时间上限（秒，0=不限） */
+  double max_fds;            /* 子进程文件描述符个数上限（0=不限） */
+  double max_core;           /* 子进程 core 文件上限（字节，-1=不改） */
+  int fd_check;              /* 检查每个测试结束后未关闭的描述符和线程 */
 } ezctest_config_t;
 
 /* Worker模式支持 - 声明在后面的全局变量块中 */
@@ -430,28 +807,39 @@ typedef struct {
   const char *suite_name;
   ezctest_setup_func_t setup;
   ezctest_teardown_func_t teardown;
-  int is_setup; /* 1=setup, 0=teardown */
+  int is_setup; /* 1=setup, 0=teardown, 2/3=套件级, 4/5=全局 */
 } ezctest_fixture_metadata_t;
 #endif
 
-/* DEFER清理回调栈 */
+/* DEFER清理回调栈：前 EZCTEST_MAX_DEFER_CALLBACKS 项在内联数组中，
+ * 其余放在按块分配的溢出链表里（栈顶块在前） */
 typedef struct {
   ezctest_cleanup_func_t callbacks[EZCTEST_MAX_DEFER_CALLBACKS];
   void *data[EZCTEST_MAX_DEFER_CALLBACKS];
-  int count;
+  int count;                         /* 总项数（含溢出部分） */
+  struct ezctest_defer_chunk *spill; /* 溢出块链表 */
+  int scope_marks[EZCTEST_DEFER_MAX_SCOPES]; /* 各层作用域开始时的 count */
+  int scope_depth;                           /* 当前嵌套深度 */
 } ezctest_defer_stack_t;
 
 /* Setup/Teardown注册表 */
 typedef struct {
   const char *suite_name;
-  ezctest_setup_func_t setup;
-  ezctest_teardown_func_t teardown;
+  ezctest_setup_func_t setup;             /* 每个测试之前 */
+  ezctest_teardown_func_t teardown;       /* 每个测试之后 */
+  ezctest_setup_func_t suite_setup;       /* 套件的第一个测试之前 */
+  ezctest_teardown_func_t suite_teardown; /* 套件的最后一个测试之后 */
 } ezctest_fixture_t;
 
 #ifndef EZCTEST_MAX_FIXTURES
 #define EZCTEST_MAX_FIXTURES 64
 #endif
 
+/* GLOBAL_SETUP/GLOBAL_TEARDOWN 的最大个数（每个源文件各一个） */
+#ifndef EZCTEST_MAX_GLOBAL_FIXTURES
+#define EZCTEST_MAX_GLOBAL_FIXTURES 8
+#endif
+
 /* longjmp支持 */
 #include <setjmp.h>
 
@@ -460,6 +848,26 @@ typedef struct {
   int has_jumped;
 } ezctest_longjmp_context_t;
 
+/**
+ * @brief 记录执行测试的线程（ezctest_run_test 开始时调用）
+ */
+EZCTEST_API void ezctest_mark_runner_thread(void);
+
+/**
+ * @brief 当前线程是否为执行测试的线程
+ * @note 多线程基准测试的工作线程不能 longjmp 到测试线程的 jmp_buf
+ */
+EZCTEST_API int ezctest_on_runner_thread(void);
+
+/* ASSERT 失败时能否 longjmp 回测试入口；工作线程中的 ASSERT 记录失败后
+ * 只从所在函数返回 */
+#ifdef EZCTEST_THREADS_AVAILABLE
+#define EZCTEST_CAN_LONGJMP()                                                  \
+  (g_ezctest_longjmp_ctx.has_jumped && ezctest_on_runner_thread())
+#else
+#define EZCTEST_CAN_LONGJMP() g_ezctest_longjmp_ctx.has_jumped
+#endif
+
 /* 全局变量将在后面的全局变量块中声明/定义 */
 
 /* ============================================================================
@@ -476,6 +884,44 @@ typedef struct {
 EZCTEST_API int ezctest_register(const char *suite_name, const char *test_name,
                                  ezctest_func_t test_func);
 
+/**
+ * @brief 注册一个基准测试
+ * @param suite_name 测试套件名称
+ * @param bench_name 基准测试名称
+ * @param bench_func 基准测试函数指针
+ * @return 注册成功返回1，失败返回0
+ */
+EZCTEST_API int ezctest_register_benchmark(const char *suite_name,
+                                           const char *bench_name,
+                                           ezctest_bench_func_t bench_func);
+
+/**
+ * @brief 注册一个按输入规模参数化的基准测试
+ * @param suite_name 测试套件名称
+ * @param bench_name 基准测试名称
+ * @param bench_func 基准测试函数指针
+ * @param range 输入规模范围（须为静态存储期）
+ * @return 注册成功返回1，失败返回0
+ */
+EZCTEST_API int
+ezctest_register_benchmark_range(const char *suite_name, const char *bench_name,
+                                 ezctest_bench_func_t bench_func,
+                                 const ezctest_bench_range_t *range);
+
+/**
+ * @brief 注册一个多线程扩展性基准测试
+ * @param suite_name 测试套件名称
+ * @param bench_name 基准测试名称
+ * @param bench_func 基准测试函数指针
+ * @param max_threads 最大线程数（依次测量 1, 2, 4, ..., max_threads）
+ * @return 注册成功返回1，失败返回0
+ */
+EZCTEST_API int
+ezctest_register_benchmark_threads(const char *suite_name,
+                                   const char *bench_name,
+                                   ezctest_bench_func_t bench_func,
+                                   int max_threads);
+
 /**
  * @brief 注册测试套件的Setup函数
  * @param suite_name 测试套件名称
@@ -494,6 +940,40 @@ EZCTEST_API int ezctest_register_setup(const char *suite_name,
 EZCTEST_API int ezctest_register_teardown(const char *suite_name,
                                           ezctest_teardown_func_t teardown);
 
+/**
+ * @brief 注册测试套件的一次性Setup函数（SETUP_SUITE）
+ * @param suite_name 测试套件名称
+ * @param setup Setup函数指针
+ * @return 注册成功返回1，失败返回0
+ */
+EZCTEST_API int ezctest_register_suite_setup(const char *suite_name,
+                                             ezctest_setup_func_t setup);
+
+/**
+ * @brief 注册测试套件的一次性Teardown函数（TEARDOWN_SUITE）
+ * @param suite_name 测试套件名称
+ * @param teardown Teardown函数指针
+ * @return 注册成功返回1，失败返回0
+ */
+EZCTEST_API int
+ezctest_register_suite_teardown(const char *suite_name,
+                                ezctest_teardown_func_t teardown);
+
+/**
+ * @brief 注册进程级的全局Setup函数（GLOBAL_SETUP）
+ * @param setup Setup函数指针
+ * @return 注册成功返回1，失败返回0
+ */
+EZCTEST_API int ezctest_register_global_setup(ezctest_setup_func_t setup);
+
+/**
+ * @brief 注册进程级的全局Teardown函数（GLOBAL_TEARDOWN）
+ * @param teardown Teardown函数指针
+ * @return 注册成功返回1，失败返回0
+ */
+EZCTEST_API int
+ezctest_register_global_teardown(ezctest_teardown_func_t teardown);
+
 /**
  * @brief 添加DEFER清理回调
  * @param func 清理函数指针
@@ -503,15 +983,25 @@ EZCTEST_API int ezctest_register_teardown(const char *suite_name,
 EZCTEST_API int ezctest_defer_add(ezctest_cleanup_func_t func, void *data);
 
 /**
- * @brief 执行所有DEFER清理回调（LIFO顺序）
+ * @brief 执行所有DEFER清理回调（LIFO顺序），执行过的回调出栈
  */
 EZCTEST_API void ezctest_defer_execute(void);
 
 /**
- * @brief 清空DEFER栈
+ * @brief 清空DEFER栈（不执行回调），释放溢出块
  */
 EZCTEST_API void ezctest_defer_clear(void);
 
+/**
+ * @brief 开始一个DEFER作用域（由 DEFER_SCOPE_BEGIN 调用），记下当前栈深度
+ */
+EZCTEST_API void ezctest_defer_scope_begin(void);
+
+/**
+ * @brief 结束最内层的DEFER作用域：按LIFO顺序执行并弹出作用域内注册的回调
+ */
+EZCTEST_API void ezctest_defer_scope_end(void);
+
 /* ============================================================================
  * 全局变量声明与定义
  * ========================================================================== */
@@ -525,11 +1015,26 @@ int g_ezctest_current_failed = 0;
 int g_ezctest_current_assertion_failed = 0;
 ezctest_result_t g_ezctest_result = {0, 0, 0, 0, 0};
 ezctest_config_t g_ezctest_config = {NULL, 1, 0,
-                                     -1,   0, -1}; /* 增加no_exec=-1 */
+                                     -1,   0, -1,
+                                     0,    0, 0,
+                                     NULL, EZCTEST_BENCH_WARMUP,
+                                     EZCTEST_BENCH_REPETITIONS,
+                                     NULL, NULL, 5.0, NULL, 0,
+                                     0,    NULL, 0,
+                                     0.0,  0.0,  0.0,
+                                     -1.0, 0};
+/* no_exec=-1 表示自动决定是否进程隔离 */
 int g_ezctest_color_enabled = -1;
 ezctest_fixture_t g_ezctest_fixtures[EZCTEST_MAX_FIXTURES];
 int g_ezctest_fixture_count = 0;
-ezctest_defer_stack_t g_ezctest_defer_stack = {{0}, {0}, 0};
+int g_ezctest_plan[EZCTEST_MAX_TESTS]; /* 执行计划（注册表下标） */
+int g_ezctest_plan_count = 0;
+ezctest_setup_func_t g_ezctest_global_setups[EZCTEST_MAX_GLOBAL_FIXTURES];
+int g_ezctest_global_setup_count = 0;
+ezctest_teardown_func_t
+    g_ezctest_global_teardowns[EZCTEST_MAX_GLOBAL_FIXTURES];
+int g_ezctest_global_teardown_count = 0;
+ezctest_defer_stack_t g_ezctest_defer_stack = {{0}, {0}, 0, NULL, {0}, 0};
 /* jmp_buf 初始化：使用 memset 在运行时初始化以避免编译警告 */
 #if defined(__GNUC__) && !defined(__clang__)
 #pragma GCC diagnostic push
@@ -542,6 +1047,9 @@ ezctest_longjmp_context_t g_ezctest_longjmp_ctx = {{0}, 0};
 #endif
 int g_ezctest_worker_index = -1; /* 主进程 */
 char *g_ezctest_argv0 = NULL;
+#ifdef EZCTEST_THREADS_AVAILABLE
+int g_ezctest_threads_active = 0; /* 多线程基准测试的线程正在运行 */
+#endif
 
 #if defined(_MSC_VER)
 int g_ezctest_scanned = 0;
@@ -559,10 +1067,21 @@ extern ezctest_config_t g_ezctest_config;
 extern int g_ezctest_color_enabled;
 extern ezctest_fixture_t g_ezctest_fixtures[EZCTEST_MAX_FIXTURES];
 extern int g_ezctest_fixture_count;
+extern int g_ezctest_plan[EZCTEST_MAX_TESTS];
+extern int g_ezctest_plan_count;
+extern ezctest_setup_func_t
+    g_ezctest_global_setups[EZCTEST_MAX_GLOBAL_FIXTURES];
+extern int g_ezctest_global_setup_count;
+extern ezctest_teardown_func_t
+    g_ezctest_global_teardowns[EZCTEST_MAX_GLOBAL_FIXTURES];
+extern int g_ezctest_global_teardown_count;
 extern ezctest_defer_stack_t g_ezctest_defer_stack;
 extern ezctest_longjmp_context_t g_ezctest_longjmp_ctx;
 extern int g_ezctest_worker_index;
 extern char *g_ezctest_argv0;
+#ifdef EZCTEST_THREADS_AVAILABLE
+extern int g_ezctest_threads_active;
+#endif
 
 #if defined(_MSC_VER)
 extern int g_ezctest_scanned;
@@ -576,6 +1095,36 @@ extern int g_ezctest_scanned;
 
 #ifdef EZCTEST_IMPLEMENTATION
 
+#if defined(EZCTEST_THREADS_AVAILABLE) && defined(EZCTEST_PLATFORM_WINDOWS)
+static DWORD g_ezctest_runner_thread = 0;
+
+void ezctest_mark_runner_thread(void) {
+  g_ezctest_runner_thread = GetCurrentThreadId();
+}
+
+int ezctest_on_runner_thread(void) {
+  return g_ezctest_runner_thread == 0 ||
+         GetCurrentThreadId() == g_ezctest_runner_thread;
+}
+#elif defined(EZCTEST_THREADS_AVAILABLE)
+static pthread_t g_ezctest_runner_thread;
+static int g_ezctest_runner_marked = 0;
+
+void ezctest_mark_runner_thread(void) {
+  g_ezctest_runner_thread = pthread_self();
+  g_ezctest_runner_marked = 1;
+}
+
+int ezctest_on_runner_thread(void) {
+  return !g_ezctest_runner_marked ||
+         pthread_equal(pthread_self(), g_ezctest_runner_thread);
+}
+#else
+void ezctest_mark_runner_thread(void) {}
+
+int ezctest_on_runner_thread(void) { return 1; }
+#endif
+
 int ezctest_register(const char *suite_name, const char *test_name,
                      ezctest_func_t test_func) {
   if (g_ezctest_count >= EZCTEST_MAX_TESTS) {
@@ -588,19 +1137,54 @@ int ezctest_register(const char *suite_name, const char *test_name,
   g_ezctest_registry[g_ezctest_count].test_name = test_name;
   g_ezctest_registry[g_ezctest_count].test_func = test_func;
   g_ezctest_registry[g_ezctest_count].enabled = 1;
+  g_ezctest_registry[g_ezctest_count].bench_func = NULL;
+  g_ezctest_registry[g_ezctest_count].bench_range = NULL;
+  g_ezctest_registry[g_ezctest_count].bench_threads = 0;
   g_ezctest_count++;
 
   return 1;
 }
 
-int ezctest_register_setup(const char *suite_name, ezctest_setup_func_t setup) {
+int ezctest_register_benchmark(const char *suite_name, const char *bench_name,
+                               ezctest_bench_func_t bench_func) {
+  if (!ezctest_register(suite_name, bench_name, NULL)) {
+    return 0;
+  }
+  g_ezctest_registry[g_ezctest_count - 1].bench_func = bench_func;
+  return 1;
+}
+
+int ezctest_register_benchmark_range(const char *suite_name,
+                                     const char *bench_name,
+                                     ezctest_bench_func_t bench_func,
+                                     const ezctest_bench_range_t *range) {
+  if (!ezctest_register_benchmark(suite_name, bench_name, bench_func)) {
+    return 0;
+  }
+  g_ezctest_registry[g_ezctest_count - 1].bench_range = range;
+  return 1;
+}
+
+int ezctest_register_benchmark_threads(const char *suite_name,
+                                       const char *bench_name,
+                                       ezctest_bench_func_t bench_func,
+                                       int max_threads) {
+  if (!ezctest_register_benchmark(suite_name, bench_name, bench_func)) {
+    return 0;
+  }
+  g_ezctest_registry[g_ezctest_count - 1].bench_threads =
+      (max_threads < 1) ? 1 : max_threads;
+  return 1;
+}
+
+/* 查找或新建套件的fixture记录 */
+static ezctest_fixture_t *ezctest_fixture_slot(const char *suite_name) {
   int i;
 
   /* 查找是否已存在该suite */
   for (i = 0; i < g_ezctest_fixture_count; i++) {
     if (strcmp(g_ezctest_fixtures[i].suite_name, suite_name) == 0) {
-      g_ezctest_fixtures[i].setup = setup;
-      return 1;
+      return &g_ezctest_fixtures[i];
     }
   }
 
@@ -608,84 +1192,480 @@ int ezctest_register_setup(const char *suite_name, ezctest_setup_func_t setup) {
   if (g_ezctest_fixture_count >= EZCTEST_MAX_FIXTURES) {
     fprintf(stderr, "Error: Maximum number of fixtures (%d) exceeded\n",
             EZCTEST_MAX_FIXTURES);
-    return 0;
+    return NULL;
   }
 
   g_ezctest_fixtures[g_ezctest_fixture_count].suite_name = suite_name;
-  g_ezctest_fixtures[g_ezctest_fixture_count].setup = setup;
+  g_ezctest_fixtures[g_ezctest_fixture_count].setup = NULL;
   g_ezctest_fixtures[g_ezctest_fixture_count].teardown = NULL;
-  g_ezctest_fixture_count++;
+  g_ezctest_fixtures[g_ezctest_fixture_count].suite_setup = NULL;
+  g_ezctest_fixtures[g_ezctest_fixture_count].suite_teardown = NULL;
+  return &g_ezctest_fixtures[g_ezctest_fixture_count++];
+}
 
+int ezctest_register_setup(const char *suite_name, ezctest_setup_func_t setup) {
+  ezctest_fixture_t *fixture = ezctest_fixture_slot(suite_name);
+  if (fixture == NULL) {
+    return 0;
+  }
+  fixture->setup = setup;
   return 1;
 }
 
 int ezctest_register_teardown(const char *suite_name,
                               ezctest_teardown_func_t teardown) {
-  int i;
-
-  /* 查找是否已存在该suite */
-  for (i = 0; i < g_ezctest_fixture_count; i++) {
-    if (strcmp(g_ezctest_fixtures[i].suite_name, suite_name) == 0) {
-      g_ezctest_fixtures[i].teardown = teardown;
-      return 1;
-    }
+  ezctest_fixture_t *fixture = ezctest_fixture_slot(suite_name);
+  if (fixture == NULL) {
+    return 0;
   }
+  fixture->teardown = teardown;
+  return 1;
+}
 
-  /* 新建fixture */
-  if (g_ezctest_fixture_count >= EZCTEST_MAX_FIXTURES) {
-    fprintf(stderr, "Error: Maximum number of fixtures (%d) exceeded\n",
-            EZCTEST_MAX_FIXTURES);
+int ezctest_register_suite_setup(const char *suite_name,
+                                 ezctest_setup_func_t setup) {
+  ezctest_fixture_t *fixture = ezctest_fixture_slot(suite_name);
+  if (fixture == NULL) {
     return 0;
   }
-
-  g_ezctest_fixtures[g_ezctest_fixture_count].suite_name = suite_name;
-  g_ezctest_fixtures[g_ezctest_fixture_count].setup = NULL;
-  g_ezctest_fixtures[g_ezctest_fixture_count].teardown = teardown;
-  g_ezctest_fixture_count++;
-
+  fixture->suite_setup = setup;
   return 1;
 }
 
-int ezctest_defer_add(ezctest_cleanup_func_t func, void *data) {
-  if (g_ezctest_defer_stack.count >= EZCTEST_MAX_DEFER_CALLBACKS) {
-    fprintf(stderr, "Error: DEFER stack full (max %d)\n",
-            EZCTEST_MAX_DEFER_CALLBACKS);
+int ezctest_register_suite_teardown(const char *suite_name,
+                                    ezctest_teardown_func_t teardown) {
+  ezctest_fixture_t *fixture = ezctest_fixture_slot(suite_name);
+  if (fixture == NULL) {
     return 0;
   }
+  fixture->suite_teardown = teardown;
+  return 1;
+}
 
-  g_ezctest_defer_stack.callbacks[g_ezctest_defer_stack.count] = func;
-  g_ezctest_defer_stack.data[g_ezctest_defer_stack.count] = data;
-  g_ezctest_defer_stack.count++;
+int ezctest_register_global_setup(ezctest_setup_func_t setup) {
+  int i;
 
+  /* MSVC 的内存扫描可能重复找到同一条记录 */
+  for (i = 0; i < g_ezctest_global_setup_count; i++) {
+    if (g_ezctest_global_setups[i] == setup) {
+      return 1;
+    }
+  }
+  if (g_ezctest_global_setup_count >= EZCTEST_MAX_GLOBAL_FIXTURES) {
+    fprintf(stderr, "Error: Maximum number of GLOBAL_SETUPs (%d) exceeded\n",
+            EZCTEST_MAX_GLOBAL_FIXTURES);
+    return 0;
+  }
+  g_ezctest_global_setups[g_ezctest_global_setup_count++] = setup;
   return 1;
 }
 
-void ezctest_defer_execute(void) {
+int ezctest_register_global_teardown(ezctest_teardown_func_t teardown) {
   int i;
 
-  /* LIFO顺序执行清理回调 */
-  for (i = g_ezctest_defer_stack.count - 1; i >= 0; i--) {
-    if (g_ezctest_defer_stack.callbacks[i]) {
-      g_ezctest_defer_stack.callbacks[i](g_ezctest_defer_stack.data[i]);
+  for (i = 0; i < g_ezctest_global_teardown_count; i++) {
+    if (g_ezctest_global_teardowns[i] == teardown) {
+      return 1;
     }
   }
+  if (g_ezctest_global_teardown_count >= EZCTEST_MAX_GLOBAL_FIXTURES) {
+    fprintf(stderr,
+            "Error: Maximum number of GLOBAL_TEARDOWNs (%d) exceeded\n",
+            EZCTEST_MAX_GLOBAL_FIXTURES);
+    return 0;
+  }
+  g_ezctest_global_teardowns[g_ezctest_global_teardown_count++] = teardown;
+  return 1;
 }
 
-void ezctest_defer_clear(void) { g_ezctest_defer_stack.count = 0; }
+/* DEFER溢出块：存放序号 base 起的 EZCTEST_DEFER_CHUNK_SIZE 个回调 */
+struct ezctest_defer_chunk {
+  ezctest_cleanup_func_t callbacks[EZCTEST_DEFER_CHUNK_SIZE];
+  void *data[EZCTEST_DEFER_CHUNK_SIZE];
+  int base;                          /* 本块第一项在栈中的序号 */
+  struct ezctest_defer_chunk *below; /* 下一层（更早分配的）块 */
+};
 
-#endif /* EZCTEST_IMPLEMENTATION */
+int ezctest_defer_add(ezctest_cleanup_func_t func, void *data) {
+  ezctest_defer_stack_t *stack = &g_ezctest_defer_stack;
+#ifndef EZCTEST_STM32_MODE
+  struct ezctest_defer_chunk *chunk;
+#endif
 
-/* ============================================================================
- * 通配符匹配
- * ========================================================================== */
+  /* 快速路径：内联数组，不分配内存 */
+  if (stack->count < EZCTEST_MAX_DEFER_CALLBACKS) {
+    stack->callbacks[stack->count] = func;
+    stack->data[stack->count] = data;
+    stack->count++;
+    return 1;
+  }
 
-/**
- * @brief 通配符匹配函数（支持*和?）
- * @param pattern 匹配模式
- * @param str 待匹配字符串
- * @return 匹配返回1，不匹配返回0
- */
-static int ezctest_wildcard_match(const char *pattern, const char *str) {
+#ifdef EZCTEST_STM32_MODE
+  fprintf(stderr, "Error: DEFER stack full (max %d)\n",
+          EZCTEST_MAX_DEFER_CALLBACKS);
+  g_ezctest_current_failed = 1;
+  return 0;
+#else
+  chunk = stack->spill;
+  if (chunk == NULL || stack->count >= chunk->base + EZCTEST_DEFER_CHUNK_SIZE) {
+    chunk = (struct ezctest_defer_chunk *)malloc(sizeof(*chunk));
+    if (chunk == NULL) {
+      fprintf(stderr, "Error: out of memory growing the DEFER stack (%d "
+                      "callbacks)\n",
+              stack->count);
+      g_ezctest_current_failed = 1; /* 回调不会执行，不能让测试静默通过 */
+      return 0;
+    }
+    chunk->base = stack->count;
+    chunk->below = stack->spill;
+    stack->spill = chunk;
+  }
+  chunk->callbacks[stack->count - chunk->base] = func;
+  chunk->data[stack->count - chunk->base] = data;
+  stack->count++;
+  return 1;
+#endif
+}
+
+/* 按LIFO顺序执行并弹出回调，直到栈深度回到 mark；
+ * 先出栈再调用，回调中再注册的 DEFER 也会在本轮执行 */
+static void ezctest_defer_unwind(int mark) {
+  ezctest_defer_stack_t *stack = &g_ezctest_defer_stack;
+
+  while (stack->count > mark) {
+    int i = --stack->count;
+    ezctest_cleanup_func_t func;
+    void *data;
+
+    if (i < EZCTEST_MAX_DEFER_CALLBACKS) {
+      func = stack->callbacks[i];
+      data = stack->data[i];
+    } else {
+      struct ezctest_defer_chunk *chunk = stack->spill;
+      func = chunk->callbacks[i - chunk->base];
+      data = chunk->data[i - chunk->base];
+      if (i == chunk->base) {
+        stack->spill = chunk->below;
+        free(chunk);
+      }
+    }
+    if (func) {
+      func(data);
+    }
+  }
+}
+
+void ezctest_defer_execute(void) {
+  ezctest_defer_unwind(0);
+  g_ezctest_defer_stack.scope_depth = 0;
+}
+
+void ezctest_defer_clear(void) {
+  while (g_ezctest_defer_stack.spill != NULL) {
+    struct ezctest_defer_chunk *below = g_ezctest_defer_stack.spill->below;
+    free(g_ezctest_defer_stack.spill);
+    g_ezctest_defer_stack.spill = below;
+  }
+  g_ezctest_defer_stack.count = 0;
+  g_ezctest_defer_stack.scope_depth = 0;
+}
+
+/* 作用域的起点记在框架里而不是宏声明的局部变量中，
+ * 嵌套的 DEFER_SCOPE_BEGIN 不会互相遮蔽（-Wshadow） */
+void ezctest_defer_scope_begin(void) {
+  ezctest_defer_stack_t *stack = &g_ezctest_defer_stack;
+
+  if (stack->scope_depth < EZCTEST_DEFER_MAX_SCOPES) {
+    stack->scope_marks[stack->scope_depth] = stack->count;
+  }
+  stack->scope_depth++;
+}
+
+void ezctest_defer_scope_end(void) {
+  ezctest_defer_stack_t *stack = &g_ezctest_defer_stack;
+  int mark;
+
+  /* ASSERT 失败跳出作用域时不会到这里，剩余回调在测试结束时执行 */
+  if (stack->scope_depth <= 0) {
+    return;
+  }
+  stack->scope_depth--;
+  if (stack->scope_depth >= EZCTEST_DEFER_MAX_SCOPES) {
+    return; /* 超出记录深度：留给外层作用域 */
+  }
+  mark = stack->scope_marks[stack->scope_depth];
+  if (mark <= stack->count) {
+    ezctest_defer_unwind(mark);
+  }
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 测试内存池（arena）
+ * ========================================================================== */
+
+/**
+ * @brief 从当前测试的内存池分配，按 EZCTEST_ARENA_ALIGN 对齐
+ * @return 内存指针（内容未初始化）；失败返回NULL并让测试失败
+ * @note 不需要也不能 free，测试结束（Teardown 之后）统一回收
+ */
+EZCTEST_API void *ezctest_arena_alloc(size_t size);
+
+/**
+ * @brief 同 ezctest_arena_alloc，指定对齐（2 的幂）
+ */
+EZCTEST_API void *ezctest_arena_alloc_aligned(size_t size, size_t align);
+
+/**
+ * @brief 回收内存池中的全部分配（由 ezctest_run_test 在测试结束时调用）
+ * @note 保留第一块供下一个测试复用，其余块归还系统
+ */
+EZCTEST_API void ezctest_arena_reset(void);
+
+/**
+ * @brief 从测试内存池分配 n 个 T，返回 T*
+ */
+#define EZCTEST_ALLOC(T, n)                                                    \
+  ((T *)ezctest_arena_alloc_array(sizeof(T), (size_t)(n)))
+
+/**
+ * @brief 分配 count 个 size 字节的元素（检查乘法溢出）
+ */
+EZCTEST_API void *ezctest_arena_alloc_array(size_t size, size_t count);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+/* 块直接向系统映射，不经过 malloc：不计入分配统计，也不会被当作泄漏 */
+#if defined(EZCTEST_STM32_MODE)
+/* 没有虚拟内存，块来自 malloc */
+#elif defined(EZCTEST_PLATFORM_WINDOWS)
+#define EZCTEST_ARENA_MAPPED 1
+#define EZCTEST_ARENA_VIRTUALALLOC 1
+#elif defined(EZCTEST_PLATFORM_LINUX) &&                                       \
+    (defined(MAP_ANONYMOUS) || defined(MAP_ANON))
+#define EZCTEST_ARENA_MAPPED 1
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+typedef struct ezctest_arena_block {
+  struct ezctest_arena_block *next; /* 更早申请的块 */
+  size_t size;                      /* 整块大小（含块头） */
+  size_t used;                      /* 已分配到的偏移 */
+} ezctest_arena_block_t;
+
+static ezctest_arena_block_t *g_ezctest_arena = NULL; /* 当前块在前 */
+
+static size_t ezctest_arena_page_size(void) {
+#if defined(EZCTEST_ARENA_VIRTUALALLOC)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (size_t)info.dwPageSize;
+#elif defined(EZCTEST_ARENA_MAPPED)
+  long page = sysconf(_SC_PAGESIZE);
+  return page > 0 ? (size_t)page : 4096;
+#else
+  return 64;
+#endif
+}
+
+static void *ezctest_arena_map(size_t size) {
+#if defined(EZCTEST_ARENA_VIRTUALALLOC)
+  return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#elif defined(EZCTEST_ARENA_MAPPED)
+  void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return (p == MAP_FAILED) ? NULL : p;
+#else
+  return malloc(size);
+#endif
+}
+
+static void ezctest_arena_unmap(void *p, size_t size) {
+#if defined(EZCTEST_ARENA_VIRTUALALLOC)
+  (void)size;
+  VirtualFree(p, 0, MEM_RELEASE);
+#elif defined(EZCTEST_ARENA_MAPPED)
+  munmap(p, size);
+#else
+  (void)size;
+  free(p);
+#endif
+}
+
+static size_t ezctest_arena_round_up(size_t n, size_t align) {
+  return (n + align - 1) & ~(align - 1);
+}
+
+/* 默认对齐。保护页模式下降为整除 size 的最大 2 的幂（任何类型的对齐都
+ * 整除它的大小），数据末尾紧贴保护页，不留空隙 */
+static size_t ezctest_arena_default_align(size_t size) {
+  size_t align = EZCTEST_ARENA_ALIGN;
+#if defined(EZCTEST_ARENA_GUARD) && defined(EZCTEST_ARENA_MAPPED)
+  while (align > 1 && (size & (align - 1)) != 0) {
+    align >>= 1;
+  }
+#else
+  (void)size;
+#endif
+  return align;
+}
+
+/* 块内从 used 开始、按绝对地址对齐后的偏移 */
+static size_t ezctest_arena_offset(ezctest_arena_block_t *block, size_t used,
+                                   size_t align) {
+  size_t base = (size_t)(unsigned char *)block;
+  return ezctest_arena_round_up(base + used, align) - base;
+}
+
+#if defined(EZCTEST_ARENA_GUARD) && defined(EZCTEST_ARENA_MAPPED)
+/* 每次分配单独映射：[块头 ... 数据][保护页]，数据按 align 取整后紧贴保护页 */
+static void *ezctest_arena_alloc_guarded(size_t size, size_t align) {
+  size_t page = ezctest_arena_page_size();
+  size_t data = ezctest_arena_round_up(size, align);
+  size_t len = ezctest_arena_round_up(sizeof(ezctest_arena_block_t) + data,
+                                      page);
+  ezctest_arena_block_t *block;
+  unsigned char *guard;
+
+  if (data < size || len < data || align > page) {
+    return NULL;
+  }
+  block = (ezctest_arena_block_t *)ezctest_arena_map(len + page);
+  if (block == NULL) {
+    return NULL;
+  }
+  guard = (unsigned char *)block + len;
+#if defined(EZCTEST_ARENA_VIRTUALALLOC)
+  {
+    DWORD old;
+    VirtualProtect(guard, page, PAGE_NOACCESS, &old);
+  }
+#else
+  mprotect(guard, page, PROT_NONE);
+#endif
+  block->size = len + page;
+  block->used = block->size;
+  block->next = g_ezctest_arena;
+  g_ezctest_arena = block;
+  return guard - data;
+}
+#endif
+
+void *ezctest_arena_alloc_aligned(size_t size, size_t align) {
+  ezctest_arena_block_t *block = g_ezctest_arena;
+  size_t offset = 0;
+  size_t need = 0;
+
+  if (align == 0 || (align & (align - 1)) != 0) {
+    align = EZCTEST_ARENA_ALIGN;
+  }
+  if (size == 0) {
+    size = 1;
+  }
+
+#if defined(EZCTEST_ARENA_GUARD) && defined(EZCTEST_ARENA_MAPPED)
+  {
+    void *p = ezctest_arena_alloc_guarded(size, align);
+    if (p != NULL) {
+      return p;
+    }
+  }
+#else
+  /* 快速路径：在当前块中移动指针 */
+  if (block != NULL) {
+    offset = ezctest_arena_offset(block, block->used, align);
+    if (offset <= block->size && size <= block->size - offset) {
+      block->used = offset + size;
+      return (unsigned char *)block + offset;
+    }
+  }
+
+  /* 当前块放不下：申请新块，超大分配单独成块 */
+  need = sizeof(ezctest_arena_block_t) + (align - 1) + size;
+  if (need > size) {
+    size_t block_size = EZCTEST_ARENA_BLOCK_SIZE;
+    if (need > block_size) {
+      block_size = ezctest_arena_round_up(need, ezctest_arena_page_size());
+    }
+    if (block_size >= need &&
+        (block = (ezctest_arena_block_t *)ezctest_arena_map(block_size)) !=
+            NULL) {
+      offset = ezctest_arena_offset(block, sizeof(*block), align);
+      block->size = block_size;
+      block->used = offset + size;
+      block->next = g_ezctest_arena;
+      g_ezctest_arena = block;
+      return (unsigned char *)block + offset;
+    }
+  }
+#endif
+
+  (void)block;
+  (void)offset;
+  (void)need;
+  fprintf(stderr, "Error: test arena cannot allocate %lu bytes\n",
+          (unsigned long)size);
+  g_ezctest_current_failed = 1;
+  return NULL;
+}
+
+void *ezctest_arena_alloc(size_t size) {
+  return ezctest_arena_alloc_aligned(size, ezctest_arena_default_align(size));
+}
+
+void *ezctest_arena_alloc_array(size_t size, size_t count) {
+  if (size != 0 && count > (size_t)-1 / size) {
+    fprintf(stderr, "Error: test arena allocation of %lu x %lu bytes "
+                    "overflows\n",
+            (unsigned long)count, (unsigned long)size);
+    g_ezctest_current_failed = 1;
+    return NULL;
+  }
+  return ezctest_arena_alloc_aligned(size * count,
+                                     ezctest_arena_default_align(size * count));
+}
+
+void ezctest_arena_reset(void) {
+  ezctest_arena_block_t *keep = NULL;
+
+  while (g_ezctest_arena != NULL) {
+    ezctest_arena_block_t *block = g_ezctest_arena;
+    g_ezctest_arena = block->next;
+#if !defined(EZCTEST_ARENA_GUARD) || !defined(EZCTEST_ARENA_MAPPED)
+    /* 保留最早的标准大小块，下一个测试不必再向系统申请 */
+    if (block->next == NULL && block->size == EZCTEST_ARENA_BLOCK_SIZE) {
+      keep = block;
+      break;
+    }
+#endif
+    ezctest_arena_unmap(block, block->size);
+  }
+  if (keep != NULL) {
+#ifdef EZCTEST_ARENA_POISON
+    memset((unsigned char *)keep + sizeof(*keep), EZCTEST_ARENA_POISON,
+           keep->used - sizeof(*keep));
+#endif
+    keep->used = sizeof(*keep);
+    g_ezctest_arena = keep;
+  }
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 通配符匹配
+ * ========================================================================== */
+
+/**
+ * @brief 通配符匹配函数（支持*和?）
+ * @param pattern 匹配模式
+ * @param str 待匹配字符串
+ * @return 匹配返回1，不匹配返回0
+ */
+static int ezctest_wildcard_match(const char *pattern, const char *str) {
   const char *p = pattern;
   const char *s = str;
   const char *star_p = NULL;
@@ -782,6 +1762,22 @@ static int ezctest_matches_filter(const char *suite_name, const char *test_name,
   return 0;
 }
 
+/**
+ * @brief 检查测试是否参与本次运行
+ * @param test 测试信息
+ * @return 已启用、类型与本次运行一致（普通测试/基准测试）且匹配过滤器返回1
+ */
+static int ezctest_is_selected(const ezctest_info_t *test) {
+  if (!test->enabled) {
+    return 0;
+  }
+  if ((test->bench_func != NULL) != (g_ezctest_config.benchmarks != 0)) {
+    return 0;
+  }
+  return ezctest_matches_filter(test->suite_name, test->test_name,
+                                g_ezctest_config.filter);
+}
+
 /* ============================================================================
  * 开始 C 链接块（在全局变量定义之后）
  * ========================================================================== */
@@ -1023,288 +2019,6742 @@ static int ezctest_under_debugger(void) {
 }
 
 /* ============================================================================
- * 多进程隔离机制
+ * 统计引擎（基准测试重复测量与 --ezctest_repeat 计时）
  * ========================================================================== */
 
-#ifndef EZCTEST_STM32_MODE
-
-#ifdef EZCTEST_PLATFORM_LINUX
-#include <sys/types.h>
-#include <sys/wait.h>
-#endif
+/**
+ * @brief 一组测量值的统计结果
+ * @note 除 count/outliers 外均在剔除离群值后计算；
+ *       离群值按 |x - median| > 3 * 1.4826 * MAD 判定，
+ *       样本数少于 EZCTEST_STATS_MIN_OUTLIER_SAMPLES 时不剔除
+ */
+typedef struct {
+  int count;      /* 参与统计的样本数（已剔除离群值） */
+  int outliers;   /* 被剔除的离群值个数 */
+  double min;     /* 最小值 */
+  double max;     /* 最大值 */
+  double median;  /* 中位数 */
+  double mean;    /* 平均值 */
+  double stddev;  /* 样本标准差 */
+  double p90;     /* 90 分位 */
+  double p99;     /* 99 分位 */
+  double mad;     /* 中位数绝对偏差 */
+  double ci_low;  /* 平均值 95% 置信区间下限（bootstrap） */
+  double ci_high; /* 平均值 95% 置信区间上限（bootstrap） */
+  double cv;      /* 变异系数 stddev / mean */
+} ezctest_stats_t;
 
 /**
- * @brief 在子进程中执行测试（仅非STM32平台）
- * @param test 测试信息
- * @param test_index 测试索引
- * @return 子进程退出码
+ * @brief 计算一组样本的统计量
+ * @param samples 样本数组（不会被修改）
+ * @param n 样本个数
+ * @param out 输出结果；n 为0或内存不足时 out->count 为0
  */
-static int ezctest_exec_child(const ezctest_info_t *test, int test_index) {
-#ifdef EZCTEST_PLATFORM_LINUX
-  /* Unix/Linux: 使用fork */
-  /* 在fork前刷新所有缓冲区，避免子进程继承未刷新的内容 */
-  fflush(stdout);
-  fflush(stderr);
+EZCTEST_API void ezctest_stats_compute(const double *samples, int n,
+                                       ezctest_stats_t *out);
 
-  pid_t pid = fork();
+/**
+ * @brief 输出统计结果（两行：标题行 + 各统计量）
+ * @param name 测试名称（suite.name）
+ * @param st 统计结果
+ * @param unit 单位文本，如 "us" 或 "ns/op"
+ */
+EZCTEST_API void ezctest_stats_print(const char *name,
+                                     const ezctest_stats_t *st,
+                                     const char *unit);
 
-  if (pid < 0) {
-    /* fork失败 */
-    fprintf(stderr, "Error: fork() failed\n");
-    return -1;
-  }
+/**
+ * @brief 记录刚结束的测试的墙钟耗时（由执行器调用，隔离模式下经上报通道传回）
+ */
+EZCTEST_API void ezctest_test_time_set(double wall_ns);
 
-  if (pid == 0) {
-    /* 子进程：运行单个测试 */
-    int exit_code = 0;
+/**
+ * @brief 取出最近记录的测试耗时并清空
+ * @return 有记录返回1（子进程崩溃时没有记录）
+ */
+EZCTEST_API int ezctest_test_time_take(double *wall_ns);
 
-    /* 标记为worker进程（避免重复输出） */
-    g_ezctest_worker_index = test_index;
+/**
+ * @brief 记录刚结束的测试的分配统计（由执行器调用，隔离模式下经上报通道传回）
+ */
+EZCTEST_API void ezctest_test_allocs_set(unsigned long allocs, double bytes,
+                                         double peak);
 
-    /* 重置统计 */
-    g_ezctest_result.total_tests = 0;
-    g_ezctest_result.passed_tests = 0;
-    g_ezctest_result.failed_tests = 0;
-    g_ezctest_result.total_assertions = 0;
-    g_ezctest_result.failed_assertions = 0;
+/**
+ * @brief 取出最近记录的分配统计并清空
+ * @return 有记录返回1（未启用分配统计、基准测试或子进程崩溃时没有记录）
+ */
+EZCTEST_API int ezctest_test_allocs_take(unsigned long *allocs, double *bytes,
+                                         double *peak);
 
-    /* 执行测试 */
-    ezctest_run_test(test);
+/**
+ * @brief 为 --ezctest_repeat 的逐次计时分配样本表
+ * @param slots 注册表长度
+ * @param repeat 重复次数
+ */
+EZCTEST_API void ezctest_samples_begin(int slots, int repeat);
 
-    /* 子进程退出码：0=成功，1=失败 */
-    if (g_ezctest_current_failed || g_ezctest_current_assertion_failed) {
-      exit_code = 1;
-    } else {
-      exit_code = 0;
-    }
+/**
+ * @brief 记录注册表第 slot 项的一次耗时（纳秒）
+ */
+EZCTEST_API void ezctest_samples_add(int slot, double wall_ns);
 
-    exit(exit_code);
-  } else {
-    /* 父进程：等待子进程 */
-    int status;
-    waitpid(pid, &status, 0);
+/**
+ * @brief 输出每个测试跨迭代的耗时统计并释放样本表
+ */
+EZCTEST_API void ezctest_samples_report(void);
 
-    if (WIFEXITED(status)) {
-      return WEXITSTATUS(status);
-    } else if (WIFSIGNALED(status)) {
-      /* 信号终止（如段错误） - 返回特殊退出码 */
-      int sig = WTERMSIG(status);
-      /* 返回128+信号值，模拟shell的信号退出码约定 */
-      /* 这样父进程可以识别为异常退出并输出详细信息 */
-      return 128 + sig;
-    }
-    return 2; /* 其他异常情况 */
-  }
+/**
+ * @brief 记录一个基准测试的 ns/op 样本（同名多次记录会追加）
+ * @param name 基准测试名称（suite.name）
+ */
+EZCTEST_API void ezctest_bench_results_add(const char *name,
+                                           const double *samples, int n);
 
-#elif defined(EZCTEST_PLATFORM_WINDOWS)
-  /* Windows: 使用CreateProcess创建子进程 */
-  /* 注意：test参数在Windows下未直接使用，通过test_index在子进程中重新查找 */
-  (void)test;
-  {
-    STARTUPINFOA si;
-    PROCESS_INFORMATION pi;
-    char cmd_line[2048];
-    DWORD exit_code;
-    char exe_path[MAX_PATH];
-    int cmd_len;
+/**
+ * @brief 记录一个基准测试的内存分配情况（需要分配计数器）
+ * @param allocs 每次操作的分配次数
+ * @param bytes 每次操作申请的字节数
+ * @param peak 计时循环中存活字节数的峰值增量
+ */
+EZCTEST_API void ezctest_bench_results_alloc(const char *name, double allocs,
+                                             double bytes, double peak);
 
-    ZeroMemory(&si, sizeof(si));
-    si.cb = sizeof(si);
-    si.dwFlags = STARTF_USESTDHANDLES;
-    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
-    si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
-    si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
-    ZeroMemory(&pi, sizeof(pi));
+/**
+ * @brief 清空已记录的基准测试样本（隔离子进程开始时调用）
+ */
+EZCTEST_API void ezctest_bench_results_reset(void);
 
-    /* 获取当前程序路径 */
-    if (!GetModuleFileNameA(NULL, exe_path, MAX_PATH)) {
-      fprintf(stderr, "Error: GetModuleFileName failed (%lu)\n",
-              GetLastError());
-      return -1;
-    }
+/**
+ * @brief 解析一行 "bench NAME v1 v2 ..." 追加到当前结果，
+ *        或 "alloc NAME allocs bytes peak" 记录分配情况（上报通道使用）
+ */
+EZCTEST_API void ezctest_bench_results_parse(const char *line);
+
+/**
+ * @brief 把当前结果写为基线文件（每个基准测试一行原始样本，
+ *        有分配计数时另加一行 alloc 记录）
+ * @return 成功返回1
+ */
+EZCTEST_API int ezctest_bench_results_save(const char *path);
+
+/**
+ * @brief 与基线文件比较并输出差异表
+ * @param path 基线文件
+ * @param threshold 回归阈值（百分比，中位数变慢超过该值才可能判为回归）
+ * @return 显著回归的基准测试个数；基线无法读取时返回 -1
+ * @note 显著性使用单侧 Mann-Whitney U 检验（正态近似，含结的修正），
+ *       p < EZCTEST_BENCH_ALPHA 且中位数变化超过阈值才判定为回归或改进
+ */
+EZCTEST_API int ezctest_bench_results_compare(const char *path,
+                                              double threshold);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+static double g_ezctest_test_time_ns = 0.0;
+static int g_ezctest_test_time_valid = 0;
+static unsigned long g_ezctest_test_allocs = 0;
+static double g_ezctest_test_alloc_bytes = 0.0;
+static double g_ezctest_test_alloc_peak = 0.0;
+static int g_ezctest_test_allocs_valid = 0;
+static double *g_ezctest_samples = NULL; /* slots * repeat */
+static int *g_ezctest_sample_counts = NULL;
+static int g_ezctest_sample_slots = 0;
+static int g_ezctest_sample_repeat = 0;
+
+static int ezctest_stats_cmp(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+/* 绝对值与平方根：不依赖 libm（STM32 模式下不包含 math.h，也免去 -lm） */
+static double ezctest_stats_abs(double x) { return (x < 0.0) ? -x : x; }
+
+static double ezctest_stats_sqrt(double x) {
+  double r = (x > 1.0) ? x : 1.0;
+  int i;
+
+  if (x <= 0.0) {
+    return 0.0;
+  }
+  for (i = 0; i < 64; i++) { /* 牛顿迭代，从上方单调收敛 */
+    double next = 0.5 * (r + x / r);
+    if (next >= r) {
+      break;
+    }
+    r = next;
+  }
+  return r;
+}
+
+/* 已排序数组的分位数（线性插值） */
+static double ezctest_stats_quantile(const double *sorted, int n, double q) {
+  double pos = q * (double)(n - 1);
+  int lo = (int)pos;
+
+  if (lo >= n - 1) {
+    return sorted[n - 1];
+  }
+  return sorted[lo] + (sorted[lo + 1] - sorted[lo]) * (pos - (double)lo);
+}
+
+void ezctest_stats_compute(const double *samples, int n, ezctest_stats_t *out) {
+  double *sorted;
+  double *work;
+  double median;
+  double limit;
+  double sum = 0.0;
+  double sq = 0.0;
+  unsigned long rng = 2463534242UL; /* 固定种子：结果可复现 */
+  int kept = 0;
+  int i, b;
+
+  memset(out, 0, sizeof(*out));
+  if (n <= 0) {
+    return;
+  }
+  sorted = (double *)malloc(sizeof(double) * (size_t)n);
+  work = (double *)malloc(sizeof(double) *
+                          (size_t)(n > EZCTEST_STATS_BOOTSTRAP
+                                       ? n
+                                       : EZCTEST_STATS_BOOTSTRAP));
+  if (sorted == NULL || work == NULL) {
+    free(sorted);
+    free(work);
+    return;
+  }
+
+  /* 中位数与 MAD */
+  memcpy(sorted, samples, sizeof(double) * (size_t)n);
+  qsort(sorted, (size_t)n, sizeof(double), ezctest_stats_cmp);
+  median = ezctest_stats_quantile(sorted, n, 0.5);
+  for (i = 0; i < n; i++) {
+    work[i] = ezctest_stats_abs(sorted[i] - median);
+  }
+  qsort(work, (size_t)n, sizeof(double), ezctest_stats_cmp);
+  out->mad = ezctest_stats_quantile(work, n, 0.5);
+
+  /* 剔除离群值（MAD 为0说明多数样本相同，样本太少时 MAD 不可靠，都不剔除） */
+  limit = 3.0 * 1.4826 * out->mad;
+  for (i = 0; i < n; i++) {
+    if (out->mad == 0.0 || n < EZCTEST_STATS_MIN_OUTLIER_SAMPLES ||
+        ezctest_stats_abs(sorted[i] - median) <= limit) {
+      sorted[kept++] = sorted[i];
+    }
+  }
+  out->outliers = n - kept;
+  out->count = kept;
+
+  for (i = 0; i < kept; i++) {
+    sum += sorted[i];
+  }
+  out->mean = sum / (double)kept;
+  for (i = 0; i < kept; i++) {
+    sq += (sorted[i] - out->mean) * (sorted[i] - out->mean);
+  }
+  out->stddev = (kept > 1) ? ezctest_stats_sqrt(sq / (double)(kept - 1)) : 0.0;
+  out->min = sorted[0];
+  out->max = sorted[kept - 1];
+  out->median = ezctest_stats_quantile(sorted, kept, 0.5);
+  out->p90 = ezctest_stats_quantile(sorted, kept, 0.90);
+  out->p99 = ezctest_stats_quantile(sorted, kept, 0.99);
+  out->cv = (out->mean != 0.0) ? out->stddev / out->mean : 0.0;
+
+  /* bootstrap：有放回重采样求平均值，取 2.5% / 97.5% 分位 */
+  for (b = 0; b < EZCTEST_STATS_BOOTSTRAP; b++) {
+    double s = 0.0;
+    for (i = 0; i < kept; i++) {
+      rng ^= (rng << 13) & 0xFFFFFFFFUL; /* xorshift32 */
+      rng ^= rng >> 17;
+      rng ^= (rng << 5) & 0xFFFFFFFFUL;
+      s += sorted[rng % (unsigned long)kept];
+    }
+    work[b] = s / (double)kept;
+  }
+  qsort(work, EZCTEST_STATS_BOOTSTRAP, sizeof(double), ezctest_stats_cmp);
+  out->ci_low = ezctest_stats_quantile(work, EZCTEST_STATS_BOOTSTRAP, 0.025);
+  out->ci_high = ezctest_stats_quantile(work, EZCTEST_STATS_BOOTSTRAP, 0.975);
+
+  free(sorted);
+  free(work);
+}
+
+void ezctest_stats_print(const char *name, const ezctest_stats_t *st,
+                         const char *unit) {
+  if (st->count == 0) {
+    return;
+  }
+  ezctest_printf_colored(EZCTEST_COLOR_CYAN, "[   STATS  ] ");
+  printf("%s  n=%d", name, st->count);
+  if (st->outliers > 0) {
+    printf(" (+%d outlier(s) rejected)", st->outliers);
+  }
+  printf("  cv %.1f%%", st->cv * 100.0);
+  if (st->count > 1 && st->cv > EZCTEST_STATS_UNSTABLE_CV) {
+    ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "  UNSTABLE");
+  }
+  printf("\n");
+  printf("  min %.2f  median %.2f  mean %.2f +/- %.2f  p90 %.2f  p99 %.2f  "
+         "95%% CI [%.2f, %.2f] %s\n",
+         st->min, st->median, st->mean, st->stddev, st->p90, st->p99,
+         st->ci_low, st->ci_high, unit);
+}
+
+void ezctest_test_time_set(double wall_ns) {
+  g_ezctest_test_time_ns = wall_ns;
+  g_ezctest_test_time_valid = 1;
+}
+
+int ezctest_test_time_take(double *wall_ns) {
+  int valid = g_ezctest_test_time_valid;
+
+  *wall_ns = g_ezctest_test_time_ns;
+  g_ezctest_test_time_valid = 0;
+  return valid;
+}
+
+void ezctest_test_allocs_set(unsigned long allocs, double bytes,
+                             double peak) {
+  g_ezctest_test_allocs = allocs;
+  g_ezctest_test_alloc_bytes = bytes;
+  g_ezctest_test_alloc_peak = peak;
+  g_ezctest_test_allocs_valid = 1;
+}
+
+int ezctest_test_allocs_take(unsigned long *allocs, double *bytes,
+                             double *peak) {
+  int valid = g_ezctest_test_allocs_valid;
+
+  *allocs = g_ezctest_test_allocs;
+  *bytes = g_ezctest_test_alloc_bytes;
+  *peak = g_ezctest_test_alloc_peak;
+  g_ezctest_test_allocs_valid = 0;
+  return valid;
+}
+
+void ezctest_samples_begin(int slots, int repeat) {
+  g_ezctest_samples =
+      (double *)malloc(sizeof(double) * (size_t)slots * (size_t)repeat);
+  g_ezctest_sample_counts = (int *)calloc((size_t)slots, sizeof(int));
+  if (g_ezctest_samples == NULL || g_ezctest_sample_counts == NULL) {
+    free(g_ezctest_samples);
+    free(g_ezctest_sample_counts);
+    g_ezctest_samples = NULL;
+    g_ezctest_sample_counts = NULL;
+    return;
+  }
+  g_ezctest_sample_slots = slots;
+  g_ezctest_sample_repeat = repeat;
+}
+
+void ezctest_samples_add(int slot, double wall_ns) {
+  int *count;
+
+  if (g_ezctest_samples == NULL || slot < 0 ||
+      slot >= g_ezctest_sample_slots) {
+    return;
+  }
+  count = &g_ezctest_sample_counts[slot];
+  if (*count < g_ezctest_sample_repeat) {
+    g_ezctest_samples[slot * g_ezctest_sample_repeat + *count] =
+        wall_ns / 1000.0;
+    (*count)++;
+  }
+}
+
+void ezctest_samples_report(void) {
+  int slot;
+  int header = 0;
+
+  if (g_ezctest_samples == NULL) {
+    return;
+  }
+  for (slot = 0; slot < g_ezctest_sample_slots; slot++) {
+    char name[EZCTEST_MAX_NAME_LENGTH * 2];
+    ezctest_stats_t st;
+
+    if (g_ezctest_sample_counts[slot] < 2) {
+      continue;
+    }
+    if (!header) {
+      ezctest_printf_colored(EZCTEST_COLOR_CYAN, "\n[----------] ");
+      printf("Wall time across %d iteration(s)\n", g_ezctest_sample_repeat);
+      header = 1;
+    }
+    ezctest_stats_compute(&g_ezctest_samples[slot * g_ezctest_sample_repeat],
+                          g_ezctest_sample_counts[slot], &st);
+    snprintf(name, sizeof(name), "%s.%s", g_ezctest_registry[slot].suite_name,
+             g_ezctest_registry[slot].test_name);
+    ezctest_stats_print(name, &st, "us");
+  }
+  free(g_ezctest_samples);
+  free(g_ezctest_sample_counts);
+  g_ezctest_samples = NULL;
+  g_ezctest_sample_counts = NULL;
+}
+
+/* ---- 基准测试结果与基线比较 ---- */
+
+typedef struct ezctest_bench_result {
+  char *name;
+  double *samples;
+  int count;
+  int capacity;
+  int has_alloc;     /* 是否记录了分配情况 */
+  double allocs;     /* 每次操作的分配次数 */
+  double bytes;      /* 每次操作申请的字节数 */
+  double peak;       /* 存活字节数的峰值增量 */
+  struct ezctest_bench_result *next;
+} ezctest_bench_result_t;
+
+static ezctest_bench_result_t *g_ezctest_bench_results = NULL;
+
+static ezctest_bench_result_t *
+ezctest_bench_result_find(ezctest_bench_result_t *list, const char *name,
+                          size_t len) {
+  for (; list != NULL; list = list->next) {
+    if (strlen(list->name) == len && strncmp(list->name, name, len) == 0) {
+      return list;
+    }
+  }
+  return NULL;
+}
+
+/* 查找结果，名称不存在时在末尾新建（保持运行顺序） */
+static ezctest_bench_result_t *
+ezctest_bench_result_get(ezctest_bench_result_t **list, const char *name,
+                         size_t len) {
+  ezctest_bench_result_t *r = ezctest_bench_result_find(*list, name, len);
+
+  if (r == NULL) {
+    ezctest_bench_result_t **tail = list;
+    r = (ezctest_bench_result_t *)calloc(1, sizeof(*r));
+    if (r == NULL || (r->name = (char *)malloc(len + 1)) == NULL) {
+      free(r);
+      return NULL;
+    }
+    memcpy(r->name, name, len);
+    r->name[len] = '\0';
+    while (*tail != NULL) {
+      tail = &(*tail)->next;
+    }
+    *tail = r;
+  }
+  return r;
+}
+
+/* 向结果链表追加样本 */
+static void ezctest_bench_result_append(ezctest_bench_result_t **list,
+                                        const char *name, size_t len,
+                                        const double *samples, int n) {
+  ezctest_bench_result_t *r = ezctest_bench_result_get(list, name, len);
+  int i;
+
+  if (r == NULL) {
+    return;
+  }
+  if (r->count + n > r->capacity) {
+    int capacity = (r->capacity == 0) ? 16 : r->capacity;
+    double *grown;
+    while (capacity < r->count + n) {
+      capacity *= 2;
+    }
+    grown = (double *)realloc(r->samples, sizeof(double) * (size_t)capacity);
+    if (grown == NULL) {
+      return;
+    }
+    r->samples = grown;
+    r->capacity = capacity;
+  }
+  for (i = 0; i < n; i++) {
+    r->samples[r->count++] = samples[i];
+  }
+}
+
+static void ezctest_bench_result_free(ezctest_bench_result_t **list) {
+  while (*list != NULL) {
+    ezctest_bench_result_t *next = (*list)->next;
+    free((*list)->name);
+    free((*list)->samples);
+    free(*list);
+    *list = next;
+  }
+}
+
+/* 解析 "alloc NAME allocs bytes peak" */
+static void ezctest_bench_result_parse_alloc(ezctest_bench_result_t **list,
+                                             const char *line) {
+  ezctest_bench_result_t *r;
+  const char *name = line + 6;
+  size_t len = strcspn(name, " \t\r\n");
+  double values[3];
+  int i;
+
+  line = name + len;
+  for (i = 0; i < 3; i++) {
+    char *end;
+    values[i] = strtod(line, &end);
+    if (end == line) {
+      return;
+    }
+    line = end;
+  }
+  if (len > 0 && (r = ezctest_bench_result_get(list, name, len)) != NULL) {
+    r->has_alloc = 1;
+    r->allocs = values[0];
+    r->bytes = values[1];
+    r->peak = values[2];
+  }
+}
+
+/* 解析 "bench NAME v1 v2 ..." 或 "alloc NAME ..." */
+static void ezctest_bench_result_parse_into(ezctest_bench_result_t **list,
+                                            const char *line) {
+  double values[32];
+  const char *name;
+  size_t len;
+  int n = 0;
+
+  if (strncmp(line, "alloc ", 6) == 0) {
+    ezctest_bench_result_parse_alloc(list, line);
+    return;
+  }
+  if (strncmp(line, "bench ", 6) != 0) {
+    return;
+  }
+  name = line + 6;
+  len = strcspn(name, " \t\r\n");
+  line = name + len;
+  for (;;) {
+    char *end;
+    double v = strtod(line, &end);
+    if (end == line) {
+      break;
+    }
+    values[n++] = v;
+    line = end;
+    if (n == (int)(sizeof(values) / sizeof(values[0]))) {
+      ezctest_bench_result_append(list, name, len, values, n);
+      n = 0;
+    }
+  }
+  if (len > 0 && n > 0) {
+    ezctest_bench_result_append(list, name, len, values, n);
+  }
+}
+
+/* 把样本写成若干 "bench NAME ..." 行，每行最多 32 个值（不超过通道行长） */
+static void ezctest_bench_result_write(FILE *fp,
+                                       const ezctest_bench_result_t *r) {
+  int i;
+  for (i = 0; i < r->count; i++) {
+    if (i % 32 == 0) {
+      fprintf(fp, "%sbench %s", (i == 0) ? "" : "\n", r->name);
+    }
+    fprintf(fp, " %.6g", r->samples[i]);
+  }
+  fprintf(fp, "\n");
+  if (r->has_alloc) {
+    fprintf(fp, "alloc %s %.6g %.6g %.0f\n", r->name, r->allocs, r->bytes,
+            r->peak);
+  }
+}
+
+void ezctest_bench_results_add(const char *name, const double *samples,
+                               int n) {
+  ezctest_bench_result_append(&g_ezctest_bench_results, name, strlen(name),
+                              samples, n);
+}
+
+void ezctest_bench_results_alloc(const char *name, double allocs,
+                                 double bytes, double peak) {
+  ezctest_bench_result_t *r = ezctest_bench_result_get(
+      &g_ezctest_bench_results, name, strlen(name));
+
+  if (r != NULL) {
+    r->has_alloc = 1;
+    r->allocs = allocs;
+    r->bytes = bytes;
+    r->peak = peak;
+  }
+}
+
+void ezctest_bench_results_reset(void) {
+  ezctest_bench_result_free(&g_ezctest_bench_results);
+}
+
+void ezctest_bench_results_parse(const char *line) {
+  ezctest_bench_result_parse_into(&g_ezctest_bench_results, line);
+}
+
+int ezctest_bench_results_save(const char *path) {
+  const ezctest_bench_result_t *r;
+  FILE *fp;
+
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+  if (fopen_s(&fp, path, "w") != 0) {
+    fp = NULL;
+  }
+#else
+  fp = fopen(path, "w");
+#endif
+  if (fp == NULL) {
+    ezctest_printf_colored(EZCTEST_COLOR_RED, "Error: ");
+    printf("cannot write benchmark baseline '%s'\n", path);
+    return 0;
+  }
+  fprintf(fp, "# ezctest benchmark baseline: ns/op samples per benchmark\n");
+  fprintf(fp, "# alloc NAME allocs/op bytes/op peak-live-bytes\n");
+  for (r = g_ezctest_bench_results; r != NULL; r = r->next) {
+    ezctest_bench_result_write(fp, r);
+  }
+  fclose(fp);
+  ezctest_printf_colored(EZCTEST_COLOR_CYAN, "[----------] ");
+  printf("Benchmark baseline saved to %s\n", path);
+  return 1;
+}
+
+/* ln(x)（x > 0）：按 2 的幂缩放到 [1, 2) 后用 atanh 级数，不依赖 libm */
+static double ezctest_stats_log(double x) {
+  double k = 0.0;
+  double y2;
+  double term;
+  double sum = 0.0;
+  int i;
+
+  if (x <= 0.0) {
+    return 0.0;
+  }
+  while (x >= 2.0) {
+    x *= 0.5;
+    k += 1.0;
+  }
+  while (x < 1.0) {
+    x *= 2.0;
+    k -= 1.0;
+  }
+  term = (x - 1.0) / (x + 1.0); /* [0, 1/3)，级数收敛很快 */
+  y2 = term * term;
+  for (i = 1; i < 40; i += 2) {
+    sum += term / (double)i;
+    term *= y2;
+  }
+  return 2.0 * sum + k * 0.69314718055994530942;
+}
+
+/* e^x（x <= 0）：平方缩放 + 泰勒展开，不依赖 libm */
+static double ezctest_stats_exp_neg(double x) {
+  double term = 1.0;
+  double sum = 1.0;
+  int halvings = 0;
+  int i;
+
+  if (x < -700.0) {
+    return 0.0;
+  }
+  while (x < -0.5) {
+    x *= 0.5;
+    halvings++;
+  }
+  for (i = 1; i < 16; i++) {
+    term *= x / (double)i;
+    sum += term;
+  }
+  while (halvings-- > 0) {
+    sum *= sum;
+  }
+  return sum;
+}
+
+/* 标准正态分布函数（Abramowitz & Stegun 26.2.17，误差 < 7.5e-8） */
+static double ezctest_stats_normal_cdf(double z) {
+  double az = ezctest_stats_abs(z);
+  double t = 1.0 / (1.0 + 0.2316419 * az);
+  double pdf = 0.3989422804014327 * ezctest_stats_exp_neg(-0.5 * az * az);
+  double tail =
+      pdf * t *
+      (0.319381530 +
+       t * (-0.356563782 +
+            t * (1.781477937 + t * (-1.821255978 + t * 1.330274429))));
+  return (z >= 0.0) ? 1.0 - tail : tail;
+}
+
+/**
+ * @brief 单侧 Mann-Whitney U 检验
+ * @return H1 "b 整体大于 a" 的 p 值（正态近似，连续性校正与结的修正）
+ */
+static double ezctest_mann_whitney_greater(const double *a, int na,
+                                           const double *b, int nb) {
+  double u = 0.0;
+  double ties = 0.0;
+  double n = (double)(na + nb);
+  double sigma2;
+  double *all;
+  int i, j;
+
+  for (i = 0; i < na; i++) {
+    for (j = 0; j < nb; j++) {
+      u += (b[j] > a[i]) ? 1.0 : (b[j] == a[i]) ? 0.5 : 0.0;
+    }
+  }
+
+  /* 结的修正：sum(t^3 - t)，t 为每组相同值的个数 */
+  all = (double *)malloc(sizeof(double) * (size_t)(na + nb));
+  if (all != NULL) {
+    memcpy(all, a, sizeof(double) * (size_t)na);
+    memcpy(all + na, b, sizeof(double) * (size_t)nb);
+    qsort(all, (size_t)(na + nb), sizeof(double), ezctest_stats_cmp);
+    for (i = 0; i < na + nb; i = j) {
+      double t;
+      for (j = i + 1; j < na + nb && all[j] == all[i]; j++) {
+      }
+      t = (double)(j - i);
+      ties += t * t * t - t;
+    }
+    free(all);
+  }
+
+  sigma2 = (double)na * (double)nb / 12.0 *
+           ((n + 1.0) - ties / (n * (n - 1.0)));
+  if (sigma2 <= 0.0) {
+    return 1.0; /* 所有样本相同：没有差异的证据 */
+  }
+  return 1.0 - ezctest_stats_normal_cdf(
+                   (u - (double)na * (double)nb / 2.0 - 0.5) /
+                   ezctest_stats_sqrt(sigma2));
+}
+
+int ezctest_bench_results_compare(const char *path, double threshold) {
+  ezctest_bench_result_t *baseline = NULL;
+  const ezctest_bench_result_t *cur;
+  char line[EZCTEST_CHANNEL_LINE_MAX];
+  int regressions = 0;
+  FILE *fp;
+
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+  if (fopen_s(&fp, path, "r") != 0) {
+    fp = NULL;
+  }
+#else
+  fp = fopen(path, "r");
+#endif
+  if (fp == NULL) {
+    ezctest_printf_colored(EZCTEST_COLOR_RED, "Error: ");
+    printf("cannot read benchmark baseline '%s'\n", path);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    ezctest_bench_result_parse_into(&baseline, line);
+  }
+  fclose(fp);
+
+  ezctest_printf_colored(EZCTEST_COLOR_CYAN, "\n[----------] ");
+  printf("Benchmark comparison against %s (threshold %.1f%%, alpha %.2f)\n",
+         path, threshold, EZCTEST_BENCH_ALPHA);
+  printf("  %-36s %12s %12s %9s %8s  %s\n", "benchmark", "base ns/op",
+         "new ns/op", "delta", "p", "verdict");
+
+  for (cur = g_ezctest_bench_results; cur != NULL; cur = cur->next) {
+    const ezctest_bench_result_t *base =
+        ezctest_bench_result_find(baseline, cur->name, strlen(cur->name));
+    ezctest_stats_t st_base, st_cur;
+    double delta, p;
+
+    ezctest_stats_compute(cur->samples, cur->count, &st_cur);
+    if (base == NULL || base->count == 0) {
+      printf("  %-36s %12s %12.2f %9s %8s  new\n", cur->name, "-",
+             st_cur.median, "-", "-");
+      continue;
+    }
+    ezctest_stats_compute(base->samples, base->count, &st_base);
+    delta = (st_base.median > 0.0)
+                ? (st_cur.median - st_base.median) / st_base.median * 100.0
+                : 0.0;
+    /* 只检验与中位数变化同向的假设 */
+    p = (delta >= 0.0)
+            ? ezctest_mann_whitney_greater(base->samples, base->count,
+                                           cur->samples, cur->count)
+            : ezctest_mann_whitney_greater(cur->samples, cur->count,
+                                           base->samples, base->count);
+
+    printf("  %-36s %12.2f %12.2f %+8.1f%% %8.4f  ", cur->name,
+           st_base.median, st_cur.median, delta, p);
+    if (p < EZCTEST_BENCH_ALPHA && delta > threshold) {
+      ezctest_printf_colored(EZCTEST_COLOR_RED, "REGRESSION\n");
+      regressions++;
+    } else if (p < EZCTEST_BENCH_ALPHA && delta < -threshold) {
+      ezctest_printf_colored(EZCTEST_COLOR_GREEN, "improved\n");
+    } else {
+      printf("~\n");
+    }
+    /* 分配次数是确定的，有变化就值得一提（不计入回归） */
+    if (base->has_alloc && cur->has_alloc &&
+        (ezctest_stats_abs(base->allocs - cur->allocs) > 1e-6 * cur->allocs ||
+         ezctest_stats_abs(base->bytes - cur->bytes) > 1e-6 * cur->bytes)) {
+      printf("  %-36s allocs/op %.2f -> %.2f, bytes/op %.1f -> %.1f\n", "",
+             base->allocs, cur->allocs, base->bytes, cur->bytes);
+    }
+  }
+
+  ezctest_bench_result_free(&baseline);
+  return regressions;
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 断言位置统计
+ * ========================================================================== */
+
+/**
+ * @brief 登记断言位置（不能在启动时枚举的平台上由首次执行的断言调用）
+ * @return 总是返回1
+ */
+EZCTEST_API int ezctest_site_link(ezctest_site_t *site);
+
+/**
+ * @brief 加锁登记并计数一次断言执行（启用线程但编译器没有原子加时由断言宏调用）
+ * @param passed 1=通过，0=失败
+ */
+EZCTEST_API void ezctest_site_hit(ezctest_site_t *site, int passed);
+
+/**
+ * @brief 启动时登记所有断言位置（ELF 段枚举；MSVC 在内存扫描中完成）
+ */
+EZCTEST_API void ezctest_sites_collect(void);
+
+/**
+ * @brief 清零所有位置的计数（隔离子进程开始时调用，只上报本进程的增量）
+ */
+EZCTEST_API void ezctest_sites_reset(void);
+
+/**
+ * @brief 所有位置的通过次数之和
+ */
+EZCTEST_API unsigned long ezctest_sites_passed(void);
+
+/**
+ * @brief 按文件和行号输出每个断言位置的通过/失败次数
+ */
+EZCTEST_API void ezctest_sites_print_report(void);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+static ezctest_site_t *g_ezctest_sites = NULL;
+static int g_ezctest_site_count = 0;
+
+#ifdef EZCTEST_SITE_COLLECT
+/* 链接器为 ezctest_sites 段生成的起止符号（没有任何断言时不存在） */
+extern ezctest_site_t *const __start_ezctest_sites[] __attribute__((weak));
+extern ezctest_site_t *const __stop_ezctest_sites[] __attribute__((weak));
+#endif
+
+/* 断言计数的锁（只在启用多线程基准测试时需要） */
+#if defined(EZCTEST_THREADS_AVAILABLE) && defined(EZCTEST_PLATFORM_WINDOWS)
+static volatile LONG g_ezctest_stats_spin = 0;
+
+static void ezctest_stats_lock(void) {
+  while (InterlockedCompareExchange(&g_ezctest_stats_spin, 1, 0) != 0) {
+    Sleep(0);
+  }
+}
+
+static void ezctest_stats_unlock(void) {
+  InterlockedExchange(&g_ezctest_stats_spin, 0);
+}
+#elif defined(EZCTEST_THREADS_AVAILABLE)
+static pthread_mutex_t g_ezctest_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void ezctest_stats_lock(void) {
+  pthread_mutex_lock(&g_ezctest_stats_mutex);
+}
+
+static void ezctest_stats_unlock(void) {
+  pthread_mutex_unlock(&g_ezctest_stats_mutex);
+}
+#else
+#define ezctest_stats_lock() ((void)0)
+#define ezctest_stats_unlock() ((void)0)
+#endif
+
+static void ezctest_site_link_locked(ezctest_site_t *site) {
+  if (!site->linked) {
+    site->next = g_ezctest_sites;
+    g_ezctest_sites = site;
+    g_ezctest_site_count++;
+    site->linked = 1;
+  }
+}
+
+int ezctest_site_link(ezctest_site_t *site) {
+  /* 多个线程可能同时首次执行同一个断言，插入链表要串行 */
+  ezctest_stats_lock();
+  ezctest_site_link_locked(site);
+  ezctest_stats_unlock();
+  return 1;
+}
+
+void ezctest_site_hit(ezctest_site_t *site, int passed) {
+  ezctest_stats_lock();
+  ezctest_site_link_locked(site);
+  if (passed) {
+    site->passed++;
+  } else {
+    site->failed++;
+  }
+  ezctest_stats_unlock();
+}
+
+void ezctest_sites_collect(void) {
+#ifdef EZCTEST_SITE_COLLECT
+  ezctest_site_t *const *p;
+
+  for (p = __start_ezctest_sites; p != NULL && p < __stop_ezctest_sites; p++) {
+    if (*p != NULL) {
+      ezctest_site_link(*p);
+    }
+  }
+#endif
+}
+
+void ezctest_sites_reset(void) {
+  ezctest_site_t *site;
+
+  for (site = g_ezctest_sites; site != NULL; site = site->next) {
+    site->passed = 0;
+    site->failed = 0;
+  }
+}
+
+unsigned long ezctest_sites_passed(void) {
+  ezctest_site_t *site;
+  unsigned long total = 0;
+
+  for (site = g_ezctest_sites; site != NULL; site = site->next) {
+    total += site->passed;
+  }
+  return total;
+}
+
+/**
+ * @brief 合并子进程上报的位置计数
+ * @param record "<passed> <failed> <line> <file>\t<expr>"
+ */
+static void ezctest_sites_merge(char *record) {
+  ezctest_site_t *site;
+  unsigned long passed;
+  unsigned long failed;
+  int line;
+  char *file;
+  char *expr;
+  char *end;
+
+  passed = strtoul(record, &end, 10);
+  failed = strtoul(end, &end, 10);
+  line = (int)strtol(end, &end, 10);
+  if (*end != ' ') {
+    return;
+  }
+  file = end + 1;
+  expr = strchr(file, '\t');
+  if (expr == NULL) {
+    return;
+  }
+  *expr++ = '\0';
+
+  for (site = g_ezctest_sites; site != NULL; site = site->next) {
+    if (site->line == line && strcmp(site->file, file) == 0 &&
+        strcmp(site->expr, expr) == 0) {
+      break;
+    }
+  }
+  if (site == NULL) {
+    /* 父进程中尚未登记的位置（首次执行发生在子进程中）：保存一份副本 */
+    size_t file_len = strlen(file) + 1;
+    size_t expr_len = strlen(expr) + 1;
+    char *strings;
+
+    site = (ezctest_site_t *)malloc(sizeof(ezctest_site_t) + file_len +
+                                    expr_len);
+    if (site == NULL) {
+      return;
+    }
+    memset(site, 0, sizeof(ezctest_site_t));
+    strings = (char *)(site + 1);
+    memcpy(strings, file, file_len);
+    memcpy(strings + file_len, expr, expr_len);
+    site->file = strings;
+    site->expr = strings + file_len;
+    site->line = line;
+    ezctest_site_link(site);
+  }
+  site->passed += passed;
+  site->failed += failed;
+}
+
+static int ezctest_site_compare(const void *a, const void *b) {
+  const ezctest_site_t *sa = *(const ezctest_site_t *const *)a;
+  const ezctest_site_t *sb = *(const ezctest_site_t *const *)b;
+  int c = strcmp(sa->file, sb->file);
+
+  if (c != 0) {
+    return c;
+  }
+  if (sa->line != sb->line) {
+    return sa->line < sb->line ? -1 : 1;
+  }
+  return strcmp(sa->expr, sb->expr);
+}
+
+void ezctest_sites_print_report(void) {
+  ezctest_site_t **sorted;
+  ezctest_site_t *site;
+  int never = 0;
+  int n = 0;
+  int i;
+
+  if (g_ezctest_site_count == 0) {
+    printf("\nAssertion report: no assertion sites found\n");
+    return;
+  }
+  sorted = (ezctest_site_t **)malloc(sizeof(ezctest_site_t *) *
+                                     (size_t)g_ezctest_site_count);
+  if (sorted == NULL) {
+    return;
+  }
+  for (site = g_ezctest_sites; site != NULL && n < g_ezctest_site_count;
+       site = site->next) {
+    sorted[n++] = site;
+    if (site->passed == 0 && site->failed == 0) {
+      never++;
+    }
+  }
+  qsort(sorted, (size_t)n, sizeof(ezctest_site_t *), ezctest_site_compare);
+
+  printf("\nAssertion report: %d site(s), %d never executed\n", n, never);
+  printf("  %10s %10s  %s\n", "passed", "failed", "site");
+  for (i = 0; i < n; i++) {
+    site = sorted[i];
+    if (site->passed == 0 && site->failed == 0) {
+      printf("  %10s %10s  ", "-", "-");
+      ezctest_printf_colored(EZCTEST_COLOR_YELLOW,
+                             "%s:%d: %s (never executed)\n", site->file,
+                             site->line, site->expr);
+    } else if (site->failed > 0) {
+      printf("  %10lu ", site->passed);
+      ezctest_printf_colored(EZCTEST_COLOR_RED, "%10lu", site->failed);
+      printf("  %s:%d: %s\n", site->file, site->line, site->expr);
+    } else {
+      printf("  %10lu %10lu  %s:%d: %s\n", site->passed, site->failed,
+             site->file, site->line, site->expr);
+    }
+  }
+#ifndef EZCTEST_SITES_ENUMERABLE
+  printf("  (sites that never executed cannot be listed in this build)\n");
+#endif
+  free(sorted);
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 文件描述符与线程泄漏检测
+ * ========================================================================== */
+
+/*
+ * --ezctest_fd_check：在 Setup 之前和 Teardown 之后各取一次 /proc/self/fd
+ * （没有 /proc 时用 /dev/fd）和 /proc/self/task 的快照，测试结束时仍然打开的
+ * 新描述符（连同 readlink 得到的目标）和仍在运行的新线程都让测试失败。
+ * 不隔离时泄漏会在进程中累积，直到很久之后才以 EMFILE 的形式出现，
+ * 因此这个检查对 --ezctest_no_exec 尤其有用。
+ */
+
+/* 快照中记录的描述符/线程个数上限，超出的部分不参与比较 */
+#ifndef EZCTEST_FD_CHECK_MAX
+#define EZCTEST_FD_CHECK_MAX 1024
+#endif
+
+/**
+ * @brief 描述符泄漏检测是否可用（需要 /proc/self/fd 或 /dev/fd）
+ */
+EZCTEST_API int ezctest_fd_check_available(void);
+
+/**
+ * @brief 记录当前打开的描述符和正在运行的线程
+ */
+EZCTEST_API void ezctest_fd_check_begin(void);
+
+/**
+ * @brief 与 ezctest_fd_check_begin 的快照比较，报告新增的描述符和线程
+ * @return 泄漏的描述符和线程总数；有泄漏时当前测试标记为失败
+ * @note 新线程可能正在退出，报告前会短暂等待几次再确认
+ */
+EZCTEST_API int ezctest_fd_check_end(void);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+#if defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+
+static int g_ezctest_fd_before[EZCTEST_FD_CHECK_MAX];
+static int g_ezctest_fd_before_count = -1;
+static int g_ezctest_task_before[EZCTEST_FD_CHECK_MAX];
+static int g_ezctest_task_before_count = -1;
+
+/* 列出目录中的数字项（描述符或线程号），跳过读取目录本身用的描述符 */
+static int ezctest_fd_list(const char *path, int *ids, int max) {
+  DIR *dir = opendir(path);
+  struct dirent *entry;
+  int self;
+  int count = 0;
+
+  if (dir == NULL) {
+    return -1;
+  }
+  self = dirfd(dir);
+  while ((entry = readdir(dir)) != NULL && count < max) {
+    char *end;
+    long id = strtol(entry->d_name, &end, 10);
+    if (end == entry->d_name || *end != '\0' || id == self) {
+      continue;
+    }
+    ids[count++] = (int)id;
+  }
+  closedir(dir);
+  return count;
+}
+
+static int ezctest_fd_listed(const int *ids, int count, int id) {
+  int i;
+  for (i = 0; i < count; i++) {
+    if (ids[i] == id) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* 列出快照之后新增的项，返回个数 */
+static int ezctest_fd_new(const char *path, const int *before, int before_count,
+                          int *added, int max) {
+  int now[EZCTEST_FD_CHECK_MAX];
+  int count = ezctest_fd_list(path, now, EZCTEST_FD_CHECK_MAX);
+  int i;
+  int n = 0;
+
+  for (i = 0; i < count && n < max; i++) {
+    if (!ezctest_fd_listed(before, before_count, now[i])) {
+      added[n++] = now[i];
+    }
+  }
+  return n;
+}
+
+static const char *ezctest_fd_dir(void) {
+  static const char *dir = NULL;
+  if (dir == NULL) {
+    struct stat st;
+    dir = (stat("/proc/self/fd", &st) == 0) ? "/proc/self/fd" : "/dev/fd";
+  }
+  return dir;
+}
+
+int ezctest_fd_check_available(void) {
+  int probe[1];
+  return ezctest_fd_list(ezctest_fd_dir(), probe, 1) >= 0;
+}
+
+void ezctest_fd_check_begin(void) {
+  g_ezctest_fd_before_count = ezctest_fd_list(
+      ezctest_fd_dir(), g_ezctest_fd_before, EZCTEST_FD_CHECK_MAX);
+  g_ezctest_task_before_count = ezctest_fd_list(
+      "/proc/self/task", g_ezctest_task_before, EZCTEST_FD_CHECK_MAX);
+}
+
+int ezctest_fd_check_end(void) {
+  int fds[EZCTEST_FD_CHECK_MAX];
+  int tasks[EZCTEST_FD_CHECK_MAX];
+  int fd_count = 0;
+  int task_count = 0;
+  int i;
+
+  if (g_ezctest_fd_before_count >= 0) {
+    fd_count = ezctest_fd_new(ezctest_fd_dir(), g_ezctest_fd_before,
+                              g_ezctest_fd_before_count, fds,
+                              EZCTEST_FD_CHECK_MAX);
+  }
+  if (g_ezctest_task_before_count >= 0) {
+    int tries;
+    /* 刚被 join 或即将退出的线程可能还短暂留在 /proc/self/task 中 */
+    for (tries = 0; tries < 20; tries++) {
+      struct timespec pause;
+      task_count = ezctest_fd_new("/proc/self/task", g_ezctest_task_before,
+                                  g_ezctest_task_before_count, tasks,
+                                  EZCTEST_FD_CHECK_MAX);
+      if (task_count == 0) {
+        break;
+      }
+      pause.tv_sec = 0;
+      pause.tv_nsec = 5000000; /* 5ms */
+      nanosleep(&pause, NULL);
+    }
+  }
+  g_ezctest_fd_before_count = -1;
+  g_ezctest_task_before_count = -1;
+
+  if (fd_count > 0) {
+    g_ezctest_current_failed = 1;
+    printf("  FD check: %d file descriptor(s) opened by the test are still "
+           "open\n",
+           fd_count);
+    for (i = 0; i < fd_count; i++) {
+      char path[64];
+      char target[256];
+      ssize_t len;
+
+      snprintf(path, sizeof(path), "%s/%d", ezctest_fd_dir(), fds[i]);
+      len = readlink(path, target, sizeof(target) - 1);
+      if (len < 0) {
+        printf("    fd %d\n", fds[i]);
+      } else {
+        target[len] = '\0';
+        printf("    fd %d -> %s\n", fds[i], target);
+      }
+    }
+  }
+  if (task_count > 0) {
+    g_ezctest_current_failed = 1;
+    printf("  FD check: %d thread(s) started by the test are still running\n",
+           task_count);
+    for (i = 0; i < task_count; i++) {
+      char path[64];
+      char name[32];
+      FILE *comm;
+
+      name[0] = '\0';
+      snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tasks[i]);
+      comm = fopen(path, "r");
+      if (comm != NULL) {
+        if (fgets(name, sizeof(name), comm) == NULL) {
+          name[0] = '\0';
+        }
+        fclose(comm);
+        name[strcspn(name, "\n")] = '\0';
+      }
+      printf("    thread %d (%s)\n", tasks[i], name[0] ? name : "?");
+    }
+  }
+  return fd_count + task_count;
+}
+
+#else
+
+int ezctest_fd_check_available(void) { return 0; }
+
+void ezctest_fd_check_begin(void) {}
+
+int ezctest_fd_check_end(void) { return 0; }
+
+#endif
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 隔离子进程的资源限制
+ * ========================================================================== */
+
+/*
+ * --ezctest_max_rss/--ezctest_max_cpu/--ezctest_max_fds/--ezctest_max_core
+ * 在每个隔离子进程 fork 之后用 setrlimit 设置；测试体中的 TEST_LIMIT_*
+ * 只收紧当前测试的子进程。子进程因限制终止时（SIGXCPU，或 errno 为
+ * ENOMEM/EMFILE 时崩溃）经上报通道写入 "limit <名称> <值> <是否确认>"，
+ * 父进程据此报告超出了哪个限制，而不只是信号编号。errno 可能是更早一次
+ * 已被处理的失败留下的，因此只有能确认时（打开的描述符数达到上限、已用
+ * 地址空间接近上限）才报告 "exceeded ..."，否则只作为提示附在信号之后。
+ * Windows 和 STM32 上忽略。
+ */
+
+/* 可限制的资源 */
+typedef enum {
+  EZCTEST_LIMIT_RSS,  /* 地址空间（RLIMIT_AS，Linux 不执行 RLIMIT_RSS） */
+  EZCTEST_LIMIT_CPU,  /* CPU 时间（RLIMIT_CPU，秒） */
+  EZCTEST_LIMIT_FDS,  /* 文件描述符个数（RLIMIT_NOFILE） */
+  EZCTEST_LIMIT_CORE, /* core 文件大小（RLIMIT_CORE，0 禁止 core dump） */
+  EZCTEST_LIMIT_COUNT
+} ezctest_limit_t;
+
+/**
+ * @brief 解析带二进制单位的大小，如 "512M"、"2G"、"64KiB"
+ * @return 字节数，无法解析时返回 -1
+ */
+EZCTEST_API double ezctest_parse_size(const char *text);
+
+/**
+ * @brief 子进程：fork 之后应用命令行给出的限制
+ * @param report_fd 上报通道的文件描述符（-1 表示不上报）
+ */
+EZCTEST_API void ezctest_limits_apply(int report_fd);
+
+/**
+ * @brief 在当前测试的隔离子进程中收紧一项限制（由 TEST_LIMIT_* 调用）
+ * @return 已生效返回1；不隔离或平台不支持时返回0
+ */
+EZCTEST_API int ezctest_limit_test(ezctest_limit_t which, double value);
+
+/**
+ * @brief 父进程：记录子进程上报的 limit 记录（由上报通道调用）
+ */
+EZCTEST_API void ezctest_limits_note(const char *record);
+
+/**
+ * @brief 父进程：判断异常退出的子进程是否因资源限制而终止
+ * @param exit_code ezctest_exec_child 返回的退出码
+ * @param buf 接收原因，如 "exceeded RLIMIT_AS of 2 GiB"
+ * @return 是返回1
+ */
+EZCTEST_API int ezctest_limits_reason(int exit_code, char *buf, size_t size);
+
+/**
+ * @brief 限制当前测试子进程的地址空间/CPU 秒数/文件描述符个数
+ */
+#define TEST_LIMIT_RSS(bytes)                                                  \
+  ezctest_limit_test(EZCTEST_LIMIT_RSS, (double)(bytes))
+#define TEST_LIMIT_CPU(seconds)                                                \
+  ezctest_limit_test(EZCTEST_LIMIT_CPU, (double)(seconds))
+#define TEST_LIMIT_FDS(count)                                                  \
+  ezctest_limit_test(EZCTEST_LIMIT_FDS, (double)(count))
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+#if defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+#define EZCTEST_HAVE_RLIMIT 1
+#define EZCTEST_HAVE_SIGACTION 1
+#endif
+
+#ifdef EZCTEST_HAVE_SIGACTION
+/*
+ * 子进程的诊断信号处理函数（资源限制、保护页）写完记录后恢复之前的处理方式
+ * 再交还信号：内核产生的 SIGSEGV/SIGBUS 返回后由出错指令重新触发，
+ * 带着原始的 siginfo 到达之前的处理函数；其他信号重新发送。
+ * 两个处理函数无论安装顺序如何都能各自写出记录。
+ */
+static void ezctest_signal_forward(int sig, const siginfo_t *info,
+                                   const struct sigaction *prev) {
+  sigaction(sig, prev, NULL);
+  if ((sig == SIGSEGV || sig == SIGBUS) && info != NULL && info->si_code > 0) {
+    return;
+  }
+  raise(sig);
+}
+#endif
+
+static char g_ezctest_limit_hit[64] = {0}; /* 父进程：最近一条 limit 记录 */
+
+double ezctest_parse_size(const char *text) {
+  char *end;
+  double value = strtod(text, &end);
+
+  if (end == text || value < 0) {
+    return -1;
+  }
+  switch (*end) {
+  case 'k':
+  case 'K':
+    value *= 1024.0;
+    break;
+  case 'm':
+  case 'M':
+    value *= 1024.0 * 1024.0;
+    break;
+  case 'g':
+  case 'G':
+    value *= 1024.0 * 1024.0 * 1024.0;
+    break;
+  case 't':
+  case 'T':
+    value *= 1024.0 * 1024.0 * 1024.0 * 1024.0;
+    break;
+  default:
+    break;
+  }
+  return value;
+}
+
+/* 按二进制单位格式化字节数 */
+static void ezctest_format_size(double bytes, char *buf, size_t size) {
+  static const char *const units[] = {"bytes", "KiB", "MiB", "GiB", "TiB"};
+  int unit = 0;
+
+  while (bytes >= 1024.0 && unit < 4) {
+    bytes /= 1024.0;
+    unit++;
+  }
+  snprintf(buf, size, "%.4g %s", bytes, units[unit]);
+}
+
+#ifdef EZCTEST_HAVE_RLIMIT
+
+static const int g_ezctest_limit_resources[EZCTEST_LIMIT_COUNT] = {
+    RLIMIT_AS, RLIMIT_CPU, RLIMIT_NOFILE, RLIMIT_CORE};
+static const char *const g_ezctest_limit_names[EZCTEST_LIMIT_COUNT] = {
+    "RLIMIT_AS", "RLIMIT_CPU", "RLIMIT_NOFILE", "RLIMIT_CORE"};
+
+/* 子进程：崩溃时写入上报通道的记录前缀（预先格式化，信号处理函数中只 write） */
+static char g_ezctest_limit_records[EZCTEST_LIMIT_COUNT][64];
+static double g_ezctest_limit_values[EZCTEST_LIMIT_COUNT];
+static double g_ezctest_limit_page = 4096.0;
+static int g_ezctest_limit_fd = -1;
+static int g_ezctest_limit_handlers = 0;
+static const int g_ezctest_limit_signals[4] = {SIGXCPU, SIGSEGV, SIGBUS,
+                                               SIGABRT};
+static struct sigaction g_ezctest_limit_prev[4];
+
+/* 信号处理函数中：打开的描述符个数是否已达到 RLIMIT_NOFILE（只用 fcntl） */
+static int ezctest_limit_fds_full(void) {
+  double limit = g_ezctest_limit_values[EZCTEST_LIMIT_FDS];
+  int open_count = 0;
+  int fd;
+
+  if (limit <= 0 || limit > 65536.0) {
+    return 0;
+  }
+  for (fd = 0; fd < (int)limit; fd++) {
+    if (fcntl(fd, F_GETFD) != -1) {
+      open_count++;
+    }
+  }
+  return open_count >= (int)limit;
+}
+
+/* 信号处理函数中：已用地址空间（/proc/self/statm 第一项）是否接近 RLIMIT_AS。
+ * 被拒绝的那次分配大小未知，用量达到上限的 15/16 才算确认 */
+static int ezctest_limit_as_near(void) {
+  double limit = g_ezctest_limit_values[EZCTEST_LIMIT_RSS];
+  double pages = 0;
+  char text[64];
+  ssize_t len;
+  ssize_t i;
+  int fd;
+
+  if (limit <= 0) {
+    return 0;
+  }
+  fd = open("/proc/self/statm", O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  len = read(fd, text, sizeof(text));
+  close(fd);
+  for (i = 0; i < len && text[i] >= '0' && text[i] <= '9'; i++) {
+    pages = pages * 10.0 + (double)(text[i] - '0');
+  }
+  return pages * g_ezctest_limit_page >= limit / 16.0 * 15.0;
+}
+
+static void ezctest_limits_on_signal(int sig, siginfo_t *info, void *context) {
+  int err = errno;
+  const char *record = NULL;
+  int confirmed = 0;
+  int i;
+
+  if (sig == SIGXCPU) {
+    record = g_ezctest_limit_records[EZCTEST_LIMIT_CPU];
+    confirmed = 1; /* 只可能来自 CPU 限制 */
+  } else if (err == ENOMEM) {
+    record = g_ezctest_limit_records[EZCTEST_LIMIT_RSS];
+    confirmed = record[0] != '\0' && ezctest_limit_as_near();
+  } else if (err == EMFILE) {
+    record = g_ezctest_limit_records[EZCTEST_LIMIT_FDS];
+    confirmed = record[0] != '\0' && ezctest_limit_fds_full();
+  }
+  if (record != NULL && record[0] != '\0' && g_ezctest_limit_fd >= 0) {
+    const char *tail = confirmed ? " 1\n" : " 0\n";
+    if (write(g_ezctest_limit_fd, record, strlen(record)) < 0 ||
+        write(g_ezctest_limit_fd, tail, 3) < 0) {
+      /* 无法上报，照常终止 */
+    }
+  }
+  (void)context;
+  for (i = 0; i < 4; i++) {
+    if (g_ezctest_limit_signals[i] == sig) {
+      errno = err;
+      ezctest_signal_forward(sig, info, &g_ezctest_limit_prev[i]);
+      return;
+    }
+  }
+}
+
+/* 设置一项限制（只降低，不超过现有的硬限制） */
+static int ezctest_limit_set(ezctest_limit_t which, double value) {
+  struct rlimit rl;
+  int resource = g_ezctest_limit_resources[which];
+  rlim_t soft;
+
+  if (value < 0 || getrlimit(resource, &rl) != 0) {
+    return 0;
+  }
+  soft = (rlim_t)value;
+  if (rl.rlim_max != RLIM_INFINITY && soft > rl.rlim_max) {
+    soft = rl.rlim_max;
+  }
+  rl.rlim_cur = soft;
+  /* CPU 超过软限制先收到 SIGXCPU，硬限制留 1 秒余量后才是 SIGKILL */
+  if (which == EZCTEST_LIMIT_CPU &&
+      (rl.rlim_max == RLIM_INFINITY || soft + 1 <= rl.rlim_max)) {
+    rl.rlim_max = soft + 1;
+  }
+  if (setrlimit(resource, &rl) != 0) {
+    return 0;
+  }
+
+  if (which == EZCTEST_LIMIT_CORE) {
+    return 1;
+  }
+  snprintf(g_ezctest_limit_records[which],
+           sizeof(g_ezctest_limit_records[which]), "limit %s %.0f",
+           g_ezctest_limit_names[which], (double)soft);
+  g_ezctest_limit_values[which] = (double)soft;
+  {
+    long page = sysconf(_SC_PAGESIZE);
+    if (page > 0) {
+      g_ezctest_limit_page = (double)page;
+    }
+  }
+  if (!g_ezctest_limit_handlers) {
+    struct sigaction action;
+    int i;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = ezctest_limits_on_signal;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    for (i = 0; i < 4; i++) {
+      sigaction(g_ezctest_limit_signals[i], &action, &g_ezctest_limit_prev[i]);
+    }
+    g_ezctest_limit_handlers = 1;
+  }
+  return 1;
+}
+
+#endif /* EZCTEST_HAVE_RLIMIT */
+
+void ezctest_limits_apply(int report_fd) {
+#ifdef EZCTEST_HAVE_RLIMIT
+  g_ezctest_limit_fd = report_fd;
+  if (g_ezctest_config.max_rss > 0) {
+    ezctest_limit_set(EZCTEST_LIMIT_RSS, g_ezctest_config.max_rss);
+  }
+  if (g_ezctest_config.max_cpu > 0) {
+    ezctest_limit_set(EZCTEST_LIMIT_CPU, g_ezctest_config.max_cpu);
+  }
+  if (g_ezctest_config.max_fds > 0) {
+    ezctest_limit_set(EZCTEST_LIMIT_FDS, g_ezctest_config.max_fds);
+  }
+  if (g_ezctest_config.max_core >= 0) {
+    ezctest_limit_set(EZCTEST_LIMIT_CORE, g_ezctest_config.max_core);
+  }
+#else
+  (void)report_fd;
+#endif
+}
+
+int ezctest_limit_test(ezctest_limit_t which, double value) {
+  if (which < 0 || which >= EZCTEST_LIMIT_COUNT) {
+    return 0;
+  }
+#ifdef EZCTEST_HAVE_RLIMIT
+  /* 只在隔离子进程中生效，否则会限制整个测试进程 */
+  if (g_ezctest_worker_index >= 0) {
+    return ezctest_limit_set(which, value);
+  }
+  printf("  Note: per-test resource limits need process isolation; "
+         "ignored\n");
+#else
+  (void)value;
+  printf("  Note: resource limits are not supported on this platform; "
+         "ignored\n");
+#endif
+  return 0;
+}
+
+void ezctest_limits_note(const char *record) {
+  strncpy(g_ezctest_limit_hit, record, sizeof(g_ezctest_limit_hit) - 1);
+  g_ezctest_limit_hit[sizeof(g_ezctest_limit_hit) - 1] = '\0';
+}
+
+int ezctest_limits_reason(int exit_code, char *buf, size_t size) {
+  char name[32];
+  char amount[32];
+  char signal_name[32];
+  double value = 0;
+  int confirmed = 1;
+
+  if (g_ezctest_limit_hit[0] != '\0') {
+    if (sscanf(g_ezctest_limit_hit, "%31s %lf %d", name, &value, &confirmed) <
+        2) {
+      g_ezctest_limit_hit[0] = '\0';
+      return 0;
+    }
+    g_ezctest_limit_hit[0] = '\0';
+  } else {
+#if defined(EZCTEST_HAVE_RLIMIT)
+    /* 没有记录（如处理函数被替换）：SIGXCPU 只可能来自 CPU 限制 */
+    if (exit_code != 128 + SIGXCPU) {
+      return 0;
+    }
+    strcpy(name, "RLIMIT_CPU");
+    value = g_ezctest_config.max_cpu;
+#else
+    (void)exit_code;
+    return 0;
+#endif
+  }
+
+  if (strcmp(name, "RLIMIT_CPU") == 0) {
+    snprintf(amount, sizeof(amount), "%.0f s", value);
+  } else if (strcmp(name, "RLIMIT_NOFILE") == 0) {
+    snprintf(amount, sizeof(amount), "%.0f descriptors", value);
+  } else {
+    ezctest_format_size(value, amount, sizeof(amount));
+  }
+  if (!confirmed) {
+    /* errno 可能早已过时：报告信号本身，限制只作为提示 */
+#if defined(EZCTEST_HAVE_RLIMIT)
+    int sig = exit_code - 128;
+    if (sig == SIGSEGV) {
+      strcpy(signal_name, "SIGSEGV");
+    } else if (sig == SIGBUS) {
+      strcpy(signal_name, "SIGBUS");
+    } else if (sig == SIGABRT) {
+      strcpy(signal_name, "SIGABRT");
+    } else {
+      snprintf(signal_name, sizeof(signal_name), "exit code %d", exit_code);
+    }
+#else
+    snprintf(signal_name, sizeof(signal_name), "exit code %d", exit_code);
+#endif
+    snprintf(buf, size, "%s; errno=%s, possibly %s of %s", signal_name,
+             strcmp(name, "RLIMIT_NOFILE") == 0 ? "EMFILE" : "ENOMEM", name,
+             amount);
+  } else if (value > 0) {
+    snprintf(buf, size, "exceeded %s of %s", name, amount);
+  } else {
+    snprintf(buf, size, "exceeded %s", name);
+  }
+  return 1;
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 保护页分配
+ * ========================================================================== */
+
+/*
+ * 不用 ASan 也能在进程内抓住越界：每次分配单独映射，数据紧贴一个不可访问的
+ * 保护页（PROT_NONE / PAGE_NOACCESS），越过边界的第一个字节就会崩溃。
+ * 隔离子进程中崩溃地址落在保护页上时，经上报通道写入 "guard <大小> <偏移>"，
+ * 父进程报告 "overrun of guarded allocation 16 bytes at offset 16"；
+ * 不隔离时同样的说明直接写到 stderr。测试结束（Teardown 之后）统一释放。
+ * 没有虚拟内存的平台（STM32）退化为普通的测试内存池分配。
+ */
+
+/**
+ * @brief 分配 size 字节，末尾紧贴保护页（检查向后越界）
+ * @return 内存指针；失败返回NULL并让测试失败
+ * @note 为了让越界的第一个字节就落在保护页上，只有 size 是对齐值的倍数时
+ *       返回地址才按该值对齐；不需要也不能 free
+ */
+EZCTEST_API void *ezctest_guarded_alloc(size_t size);
+
+/**
+ * @brief 分配 size 字节，开头紧贴保护页（检查向前越界）
+ * @return 按页对齐的内存指针；失败返回NULL并让测试失败
+ */
+EZCTEST_API void *ezctest_guarded_alloc_underflow(size_t size);
+
+/**
+ * @brief 释放当前测试的全部保护页分配（由 ezctest_run_test 在测试结束时调用）
+ */
+EZCTEST_API void ezctest_guarded_free_all(void);
+
+/**
+ * @brief 子进程：设置崩溃记录写入的上报通道（-1 表示写到 stderr）
+ */
+EZCTEST_API void ezctest_guarded_attach(int report_fd);
+
+/**
+ * @brief 父进程：记录子进程上报的 guard 记录（由上报通道调用）
+ */
+EZCTEST_API void ezctest_guarded_note(const char *record);
+
+/**
+ * @brief 父进程：子进程是否因访问保护页而崩溃
+ * @param buf 接收原因，如 "overrun of guarded allocation 16 bytes at offset 16"
+ * @return 是返回1
+ */
+EZCTEST_API int ezctest_guarded_reason(char *buf, size_t size);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+/* 一次保护页分配：映射 [base, base+len)，其中 [guard, guard+页) 不可访问 */
+typedef struct {
+  unsigned char *base;
+  size_t len;
+  unsigned char *guard;
+  unsigned char *data;
+  size_t size;
+} ezctest_guarded_t;
+
+static ezctest_guarded_t g_ezctest_guarded[EZCTEST_GUARDED_MAX];
+static int g_ezctest_guarded_count = 0;
+static int g_ezctest_guarded_fd = -1;
+static char g_ezctest_guarded_hit[64] = {0}; /* 父进程：最近一条 guard 记录 */
+
+#if defined(EZCTEST_HAVE_SIGACTION) && defined(EZCTEST_ARENA_MAPPED)
+#define EZCTEST_GUARDED_CLASSIFY 1
+
+static struct sigaction g_ezctest_guarded_prev[2]; /* SIGSEGV, SIGBUS */
+static int g_ezctest_guarded_handlers = 0;
+
+/* 信号处理函数中不能用 printf，手工拼接十进制数 */
+static char *ezctest_guarded_put(char *out, const char *text) {
+  while (*text != '\0') {
+    *out++ = *text++;
+  }
+  return out;
+}
+
+static char *ezctest_guarded_put_long(char *out, long value) {
+  char digits[24];
+  int n = 0;
+  unsigned long magnitude;
+
+  if (value < 0) {
+    *out++ = '-';
+    magnitude = 0UL - (unsigned long)value;
+  } else {
+    magnitude = (unsigned long)value;
+  }
+  do {
+    digits[n++] = (char)('0' + (int)(magnitude % 10));
+    magnitude /= 10;
+  } while (magnitude != 0);
+  while (n > 0) {
+    *out++ = digits[--n];
+  }
+  return out;
+}
+
+static void ezctest_guarded_on_signal(int sig, siginfo_t *info,
+                                      void *context) {
+  const unsigned char *addr =
+      (info != NULL) ? (const unsigned char *)info->si_addr : NULL;
+  size_t page = ezctest_arena_page_size();
+  int i;
+
+  (void)context;
+  for (i = 0; i < g_ezctest_guarded_count && addr != NULL; i++) {
+    const ezctest_guarded_t *g = &g_ezctest_guarded[i];
+    if (addr >= g->guard && addr < g->guard + page) {
+      char line[128];
+      char *out = line;
+      long offset = (long)(addr - g->data);
+
+      if (g_ezctest_guarded_fd >= 0) {
+        out = ezctest_guarded_put(out, "guard ");
+        out = ezctest_guarded_put_long(out, (long)g->size);
+        out = ezctest_guarded_put(out, " ");
+        out = ezctest_guarded_put_long(out, offset);
+        out = ezctest_guarded_put(out, "\n");
+      } else {
+        out = ezctest_guarded_put(out, offset < 0 ? "  Reason: underrun"
+                                                  : "  Reason: overrun");
+        out = ezctest_guarded_put(out, " of guarded allocation ");
+        out = ezctest_guarded_put_long(out, (long)g->size);
+        out = ezctest_guarded_put(out, " bytes at offset ");
+        out = ezctest_guarded_put_long(out, offset);
+        out = ezctest_guarded_put(out, "\n");
+      }
+      if (write(g_ezctest_guarded_fd >= 0 ? g_ezctest_guarded_fd : 2, line,
+                (size_t)(out - line)) < 0) {
+        /* 无法上报，照常终止 */
+      }
+      break;
+    }
+  }
+  ezctest_signal_forward(sig, info,
+                         &g_ezctest_guarded_prev[sig == SIGBUS ? 1 : 0]);
+}
+
+static void ezctest_guarded_install(void) {
+  struct sigaction action;
+
+  if (g_ezctest_guarded_handlers) {
+    return;
+  }
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = ezctest_guarded_on_signal;
+  action.sa_flags = SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGSEGV, &action, &g_ezctest_guarded_prev[0]);
+  sigaction(SIGBUS, &action, &g_ezctest_guarded_prev[1]);
+  g_ezctest_guarded_handlers = 1;
+}
+#endif
+
+#if defined(EZCTEST_ARENA_MAPPED)
+static void *ezctest_guarded_map(size_t size, int underflow) {
+  size_t page = ezctest_arena_page_size();
+  size_t data = ezctest_arena_round_up(size, page);
+  ezctest_guarded_t *g;
+
+  if (data < size || data + page < data) {
+    return NULL;
+  }
+  if (g_ezctest_guarded_count >= EZCTEST_GUARDED_MAX) {
+    fprintf(stderr, "Error: more than %d guarded allocations in one test "
+                    "(increase EZCTEST_GUARDED_MAX)\n",
+            EZCTEST_GUARDED_MAX);
+    return NULL;
+  }
+  g = &g_ezctest_guarded[g_ezctest_guarded_count];
+  g->base = (unsigned char *)ezctest_arena_map(data + page);
+  if (g->base == NULL) {
+    return NULL;
+  }
+  g->len = data + page;
+  g->size = size;
+  if (underflow) {
+    g->guard = g->base;
+    g->data = g->base + page;
+  } else {
+    g->guard = g->base + data;
+    g->data = g->guard - size;
+  }
+#if defined(EZCTEST_ARENA_VIRTUALALLOC)
+  {
+    DWORD old;
+    VirtualProtect(g->guard, page, PAGE_NOACCESS, &old);
+  }
+#else
+  mprotect(g->guard, page, PROT_NONE);
+#endif
+#ifdef EZCTEST_GUARDED_CLASSIFY
+  ezctest_guarded_install();
+#endif
+  g_ezctest_guarded_count++;
+  return g->data;
+}
+#endif
+
+static void *ezctest_guarded_alloc_impl(size_t size, int underflow) {
+  if (size == 0) {
+    size = 1;
+  }
+#if defined(EZCTEST_ARENA_MAPPED)
+  {
+    void *p = ezctest_guarded_map(size, underflow);
+    if (p == NULL) {
+      fprintf(stderr, "Error: cannot allocate %lu guarded bytes\n",
+              (unsigned long)size);
+      g_ezctest_current_failed = 1;
+    }
+    return p;
+  }
+#else
+  /* 没有虚拟内存：不做保护，仍在测试结束时回收 */
+  (void)underflow;
+  return ezctest_arena_alloc(size);
+#endif
+}
+
+void *ezctest_guarded_alloc(size_t size) {
+  return ezctest_guarded_alloc_impl(size, 0);
+}
+
+void *ezctest_guarded_alloc_underflow(size_t size) {
+  return ezctest_guarded_alloc_impl(size, 1);
+}
+
+void ezctest_guarded_free_all(void) {
+#if defined(EZCTEST_ARENA_MAPPED)
+  while (g_ezctest_guarded_count > 0) {
+    ezctest_guarded_t *g = &g_ezctest_guarded[--g_ezctest_guarded_count];
+    ezctest_arena_unmap(g->base, g->len);
+  }
+#endif
+}
+
+void ezctest_guarded_attach(int report_fd) { g_ezctest_guarded_fd = report_fd; }
+
+void ezctest_guarded_note(const char *record) {
+  strncpy(g_ezctest_guarded_hit, record, sizeof(g_ezctest_guarded_hit) - 1);
+  g_ezctest_guarded_hit[sizeof(g_ezctest_guarded_hit) - 1] = '\0';
+}
+
+int ezctest_guarded_reason(char *buf, size_t size) {
+  unsigned long bytes;
+  long offset;
+  int parsed;
+
+  if (g_ezctest_guarded_hit[0] == '\0') {
+    return 0;
+  }
+  parsed = sscanf(g_ezctest_guarded_hit, "%lu %ld", &bytes, &offset);
+  g_ezctest_guarded_hit[0] = '\0';
+  if (parsed != 2) {
+    return 0;
+  }
+  snprintf(buf, size, "%s of guarded allocation %lu bytes at offset %ld",
+           offset < 0 ? "underrun" : "overrun", bytes, offset);
+  return 1;
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 子进程结果上报通道
+ * ========================================================================== */
+
+/*
+ * 进程隔离时，子进程把断言计数等统计以文本行写入一个临时文件，
+ * 父进程在子进程退出后读取，并按行首关键字分发：
+ *   assertions <total> <failed>
+ *   site <passed> <failed> <line> <file>\t<expr>
+ *   time <wall_ns>
+ *   bench <suite.name> <ns/op> ...
+ *   alloc <suite.name> <allocs/op> <bytes/op> <peak bytes>
+ *   limit <RLIMIT_名称> <值>（子进程因资源限制崩溃时）
+ *   guard <大小> <偏移>（子进程访问保护页崩溃时）
+ * Linux/Unix 下临时文件由 tmpfile() 创建并经 fork 继承；Windows 下
+ * 文件路径通过 --ezctest_report_file 传给 worker 进程。
+ * 套件模板进程（--ezctest_fork_template）的测试子进程把同样的记录写入
+ * 与父进程相连的管道，模板随后追加一行 status 作为该测试的结束标记。
+ */
+
+/**
+ * @brief 父进程：为即将启动的子进程创建上报通道
+ * @return 成功返回1
+ */
+EZCTEST_API int ezctest_channel_open(void);
+
+/**
+ * @brief 父进程：通道文件路径（仅 Windows，需传给 worker 进程）
+ * @return 路径，没有时返回NULL
+ */
+EZCTEST_API const char *ezctest_channel_path(void);
+
+/**
+ * @brief 子进程：通道的文件描述符（供信号处理函数直接 write）
+ * @return 没有通道时返回 -1
+ */
+EZCTEST_API int ezctest_channel_fd(void);
+
+/**
+ * @brief 父进程：读取并分发子进程写入的全部记录，然后关闭通道
+ */
+EZCTEST_API void ezctest_channel_collect(void);
+
+/**
+ * @brief fork 出的子进程：开始使用继承的通道
+ */
+EZCTEST_API void ezctest_channel_begin_child(void);
+
+/**
+ * @brief Windows worker 进程：打开父进程指定的通道文件
+ */
+EZCTEST_API void ezctest_channel_attach(const char *path);
+
+/**
+ * @brief fork 出的子进程：把记录写入已打开的流（如管道）
+ */
+EZCTEST_API void ezctest_channel_attach_stream(FILE *fp);
+
+/**
+ * @brief 父进程：从流中读取并分发记录，直到遇到以 stop 开头的行或流结束
+ * @param fp 输入流
+ * @param stop 结束标记的关键字（NULL 表示读到流结束）
+ * @param stop_line 接收结束标记行（可为NULL）
+ * @param size stop_line 的大小
+ * @return 遇到结束标记返回1，流结束返回0
+ */
+EZCTEST_API int ezctest_channel_read(FILE *fp, const char *stop,
+                                     char *stop_line, size_t size);
+
+/**
+ * @brief 子进程：写入一条记录（不在隔离子进程中时忽略）
+ */
+EZCTEST_API void ezctest_channel_printf(const char *format, ...);
+
+/**
+ * @brief 子进程：测试结束后写入本进程的统计并刷新
+ */
+EZCTEST_API void ezctest_channel_finish_child(void);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+static FILE *g_ezctest_channel = NULL;
+static int g_ezctest_channel_child = 0;
+#ifdef EZCTEST_PLATFORM_WINDOWS
+static char g_ezctest_channel_file[MAX_PATH] = {0};
+#endif
+
+int ezctest_channel_open(void) {
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  char dir[MAX_PATH];
+
+  /* GetTempFileName 同时创建一个空文件 */
+  if (!GetTempPathA(MAX_PATH, dir) ||
+      !GetTempFileNameA(dir, "ezc", 0, g_ezctest_channel_file)) {
+    g_ezctest_channel_file[0] = '\0';
+    return 0;
+  }
+  return 1;
+#elif defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  g_ezctest_channel = tmpfile();
+  return g_ezctest_channel != NULL;
+#else
+  return 0;
+#endif
+}
+
+int ezctest_channel_fd(void) {
+#if defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  return (g_ezctest_channel != NULL) ? fileno(g_ezctest_channel) : -1;
+#else
+  return -1;
+#endif
+}
+
+const char *ezctest_channel_path(void) {
+#ifdef EZCTEST_PLATFORM_WINDOWS
+  return g_ezctest_channel_file[0] ? g_ezctest_channel_file : NULL;
+#else
+  return NULL;
+#endif
+}
+
+/**
+ * @brief 分发一条子进程记录
+ */
+static void ezctest_channel_dispatch(char *line) {
+  if (strncmp(line, "assertions ", 11) == 0) {
+    char *end;
+    g_ezctest_result.total_assertions += (int)strtol(line + 11, &end, 10);
+    g_ezctest_result.failed_assertions += (int)strtol(end, NULL, 10);
+  } else if (strncmp(line, "site ", 5) == 0) {
+    ezctest_sites_merge(line + 5);
+  } else if (strncmp(line, "time ", 5) == 0) {
+    ezctest_test_time_set(strtod(line + 5, NULL));
+  } else if (strncmp(line, "allocs ", 7) == 0) {
+    char *end;
+    unsigned long allocs = strtoul(line + 7, &end, 10);
+    double bytes = strtod(end, &end);
+    ezctest_test_allocs_set(allocs, bytes, strtod(end, NULL));
+  } else if (strncmp(line, "bench ", 6) == 0 ||
+             strncmp(line, "alloc ", 6) == 0) {
+    ezctest_bench_results_parse(line);
+  } else if (strncmp(line, "limit ", 6) == 0) {
+    ezctest_limits_note(line + 6);
+  } else if (strncmp(line, "guard ", 6) == 0) {
+    ezctest_guarded_note(line + 6);
+  }
+}
+
+int ezctest_channel_read(FILE *fp, const char *stop, char *stop_line,
+                         size_t size) {
+  char line[EZCTEST_CHANNEL_LINE_MAX];
+  size_t stop_len = (stop != NULL) ? strlen(stop) : 0;
+
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    size_t len = strlen(line);
+
+    if (len > 0 && line[len - 1] != '\n' && !feof(fp)) {
+      /* 超长记录：丢弃剩余部分 */
+      int c;
+      while ((c = fgetc(fp)) != EOF && c != '\n') {
+      }
+      continue;
+    }
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+      line[--len] = '\0';
+    }
+    if (stop != NULL && strncmp(line, stop, stop_len) == 0) {
+      if (stop_line != NULL && size > 0) {
+        strncpy(stop_line, line, size - 1);
+        stop_line[size - 1] = '\0';
+      }
+      return 1;
+    }
+    ezctest_channel_dispatch(line);
+  }
+  return 0;
+}
+
+void ezctest_channel_collect(void) {
+  FILE *fp;
+
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  if (g_ezctest_channel_file[0] == '\0') {
+    return;
+  }
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+  if (fopen_s(&fp, g_ezctest_channel_file, "r") != 0) {
+    fp = NULL;
+  }
+#else
+  fp = fopen(g_ezctest_channel_file, "r");
+#endif
+#else
+  fp = g_ezctest_channel;
+  if (fp != NULL) {
+    rewind(fp); /* 子进程写入后文件位置在末尾 */
+  }
+#endif
+
+  if (fp != NULL) {
+    ezctest_channel_read(fp, NULL, NULL, 0);
+    fclose(fp);
+  }
+
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  remove(g_ezctest_channel_file);
+  g_ezctest_channel_file[0] = '\0';
+#endif
+  g_ezctest_channel = NULL;
+}
+
+void ezctest_channel_begin_child(void) {
+  g_ezctest_channel_child = (g_ezctest_channel != NULL);
+  ezctest_sites_reset();
+  ezctest_bench_results_reset(); /* fork 继承了父进程已汇总的结果 */
+}
+
+void ezctest_channel_attach_stream(FILE *fp) {
+  g_ezctest_channel = fp;
+  ezctest_channel_begin_child();
+}
+
+void ezctest_channel_attach(const char *path) {
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+  if (fopen_s(&g_ezctest_channel, path, "w") != 0) {
+    g_ezctest_channel = NULL;
+  }
+#else
+  g_ezctest_channel = fopen(path, "w");
+#endif
+  g_ezctest_channel_child = (g_ezctest_channel != NULL);
+}
+
+void ezctest_channel_printf(const char *format, ...) {
+  va_list args;
+
+  if (!g_ezctest_channel_child) {
+    return;
+  }
+  va_start(args, format);
+  vfprintf(g_ezctest_channel, format, args);
+  va_end(args);
+}
+
+void ezctest_channel_finish_child(void) {
+  ezctest_site_t *site;
+
+  if (!g_ezctest_channel_child) {
+    return;
+  }
+  ezctest_channel_printf("assertions %d %d\n",
+                         g_ezctest_result.total_assertions,
+                         g_ezctest_result.failed_assertions);
+  if (g_ezctest_test_time_valid) {
+    ezctest_channel_printf("time %.0f\n", g_ezctest_test_time_ns);
+  }
+  if (g_ezctest_test_allocs_valid) {
+    ezctest_channel_printf("allocs %lu %.0f %.0f\n", g_ezctest_test_allocs,
+                           g_ezctest_test_alloc_bytes,
+                           g_ezctest_test_alloc_peak);
+  }
+  {
+    const ezctest_bench_result_t *r;
+    for (r = g_ezctest_bench_results; r != NULL; r = r->next) {
+      ezctest_bench_result_write(g_ezctest_channel, r);
+    }
+  }
+  for (site = g_ezctest_sites; site != NULL; site = site->next) {
+    if (site->passed != 0 || site->failed != 0) {
+      ezctest_channel_printf("site %lu %lu %d %s\t%s\n", site->passed,
+                             site->failed, site->line, site->file,
+                             site->expr);
+    }
+  }
+  fflush(g_ezctest_channel);
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 隔离子进程的资源占用
+ * ========================================================================== */
+
+/**
+ * @brief 一个隔离子进程的资源占用
+ * @note Windows 没有上下文切换计数，缺页只有总数（计入 minor_faults）
+ */
+typedef struct {
+  unsigned long max_rss_kb;           /* 常驻内存峰值（KB，含 fork 继承的页） */
+  unsigned long minor_faults;         /* 次缺页（不需要读盘） */
+  unsigned long major_faults;         /* 主缺页（需要读盘） */
+  unsigned long voluntary_switches;   /* 主动让出 CPU（等待 I/O、锁等） */
+  unsigned long involuntary_switches; /* 被抢占 */
+  double user_us;                     /* 用户态 CPU 时间（微秒） */
+  double sys_us;                      /* 内核态 CPU 时间（微秒） */
+} ezctest_rusage_t;
+
+/**
+ * @brief 记录刚结束的子进程的资源占用（由隔离机制调用）
+ */
+EZCTEST_API void ezctest_rusage_set(const ezctest_rusage_t *usage);
+
+/**
+ * @brief 取出最近记录的资源占用（取出后清除）
+ * @return 有记录返回1
+ */
+EZCTEST_API int ezctest_rusage_take(ezctest_rusage_t *usage);
+
+/**
+ * @brief 按 --ezctest_rusage 输出，并按 --ezctest_rusage_report 写入报告
+ * @note 报告同时带上子进程上报的分配统计（没有记录时这三列为 "-"）
+ */
+EZCTEST_API void ezctest_rusage_emit(const ezctest_info_t *test,
+                                     const ezctest_rusage_t *usage);
+
+/**
+ * @brief 关闭资源占用报告文件（运行结束时调用）
+ */
+EZCTEST_API void ezctest_rusage_report_close(void);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+static ezctest_rusage_t g_ezctest_rusage;
+static int g_ezctest_rusage_valid = 0;
+static FILE *g_ezctest_rusage_fp = NULL;
+static int g_ezctest_rusage_failed = 0; /* 报告文件无法打开，不再重试 */
+
+void ezctest_rusage_set(const ezctest_rusage_t *usage) {
+  g_ezctest_rusage = *usage;
+  g_ezctest_rusage_valid = 1;
+}
+
+int ezctest_rusage_take(ezctest_rusage_t *usage) {
+  if (!g_ezctest_rusage_valid) {
+    return 0;
+  }
+  *usage = g_ezctest_rusage;
+  g_ezctest_rusage_valid = 0;
+  return 1;
+}
+
+void ezctest_rusage_emit(const ezctest_info_t *test,
+                         const ezctest_rusage_t *usage) {
+  unsigned long allocs;
+  double bytes;
+  double peak;
+  int have_allocs = ezctest_test_allocs_take(&allocs, &bytes, &peak);
+
+  if (g_ezctest_config.rusage) {
+    printf("  rusage: maxrss %lu KB, faults %lu minor / %lu major, "
+           "switches %lu voluntary / %lu involuntary, "
+           "user %.0f us, sys %.0f us\n",
+           usage->max_rss_kb, usage->minor_faults, usage->major_faults,
+           usage->voluntary_switches, usage->involuntary_switches,
+           usage->user_us, usage->sys_us);
+  }
+  if (g_ezctest_config.rusage_report == NULL || g_ezctest_rusage_failed) {
+    return;
+  }
+  if (g_ezctest_rusage_fp == NULL) {
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+    if (fopen_s(&g_ezctest_rusage_fp, g_ezctest_config.rusage_report, "w") !=
+        0) {
+      g_ezctest_rusage_fp = NULL;
+    }
+#else
+    g_ezctest_rusage_fp = fopen(g_ezctest_config.rusage_report, "w");
+#endif
+    if (g_ezctest_rusage_fp == NULL) {
+      ezctest_printf_colored(EZCTEST_COLOR_RED, "Error: ");
+      printf("cannot write resource usage report '%s'\n",
+             g_ezctest_config.rusage_report);
+      g_ezctest_rusage_failed = 1;
+      return;
+    }
+    fprintf(g_ezctest_rusage_fp,
+            "# ezctest resource usage: rusage NAME maxrss_kb minflt majflt "
+            "nvcsw nivcsw user_us sys_us allocs alloc_bytes peak_bytes\n");
+  }
+  fprintf(g_ezctest_rusage_fp,
+          "rusage %s.%s %lu %lu %lu %lu %lu %.0f %.0f", test->suite_name,
+          test->test_name, usage->max_rss_kb, usage->minor_faults,
+          usage->major_faults, usage->voluntary_switches,
+          usage->involuntary_switches, usage->user_us, usage->sys_us);
+  if (have_allocs) {
+    fprintf(g_ezctest_rusage_fp, " %lu %.0f %.0f\n", allocs, bytes, peak);
+  } else {
+    fprintf(g_ezctest_rusage_fp, " - - -\n");
+  }
+  /* 立即写出：否则缓冲区会被之后 fork 的子进程继承并在退出时重复写入 */
+  fflush(g_ezctest_rusage_fp);
+}
+
+void ezctest_rusage_report_close(void) {
+  if (g_ezctest_rusage_fp != NULL) {
+    fclose(g_ezctest_rusage_fp);
+    g_ezctest_rusage_fp = NULL;
+    ezctest_printf_colored(EZCTEST_COLOR_CYAN, "[----------] ");
+    printf("Resource usage report saved to %s\n",
+           g_ezctest_config.rusage_report);
+  }
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 多进程隔离机制
+ * ========================================================================== */
+
+#ifndef EZCTEST_STM32_MODE
+
+#ifdef EZCTEST_PLATFORM_LINUX
+#include <sys/types.h>
+#include <sys/wait.h>
+/* wait4 需要 glibc 默认扩展；没有时用 RUSAGE_CHILDREN 前后的差值 */
+#if defined(__USE_MISC) ||                                                     \
+    (!defined(__GLIBC__) && (defined(_BSD_SOURCE) || defined(_GNU_SOURCE)))
+#define EZCTEST_HAVE_WAIT4 1
+#endif
+
+/* 把子进程的 rusage 换算后记录下来 */
+static void ezctest_rusage_from(const struct rusage *ru) {
+  ezctest_rusage_t usage;
+
+#if defined(__APPLE__)
+  usage.max_rss_kb = (unsigned long)ru->ru_maxrss / 1024; /* macOS 为字节 */
+#else
+  usage.max_rss_kb = (unsigned long)ru->ru_maxrss;
+#endif
+  usage.minor_faults = (unsigned long)ru->ru_minflt;
+  usage.major_faults = (unsigned long)ru->ru_majflt;
+  usage.voluntary_switches = (unsigned long)ru->ru_nvcsw;
+  usage.involuntary_switches = (unsigned long)ru->ru_nivcsw;
+  usage.user_us = (double)ru->ru_utime.tv_sec * 1000000.0 +
+                  (double)ru->ru_utime.tv_usec;
+  usage.sys_us = (double)ru->ru_stime.tv_sec * 1000000.0 +
+                 (double)ru->ru_stime.tv_usec;
+  ezctest_rusage_set(&usage);
+}
+#elif defined(EZCTEST_PLATFORM_WINDOWS)
+/* 与 <psapi.h> 的 PROCESS_MEMORY_COUNTERS 布局相同；运行时从 psapi.dll
+ * 取 GetProcessMemoryInfo，免去链接 psapi.lib（旧 SDK 也没有该头文件） */
+typedef struct {
+  DWORD cb;
+  DWORD PageFaultCount;
+  size_t PeakWorkingSetSize;
+  size_t WorkingSetSize;
+  size_t QuotaPeakPagedPoolUsage;
+  size_t QuotaPagedPoolUsage;
+  size_t QuotaPeakNonPagedPoolUsage;
+  size_t QuotaNonPagedPoolUsage;
+  size_t PagefileUsage;
+  size_t PeakPagefileUsage;
+} ezctest_process_memory_t;
+
+typedef BOOL(WINAPI *ezctest_get_process_memory_info_t)(
+    HANDLE, ezctest_process_memory_t *, DWORD);
+
+static int ezctest_process_memory(HANDLE process,
+                                  ezctest_process_memory_t *pmc) {
+  static ezctest_get_process_memory_info_t query = NULL;
+  static int loaded = 0;
+
+  if (!loaded) {
+    HMODULE psapi = LoadLibraryA("psapi.dll");
+    if (psapi != NULL) {
+      query = (ezctest_get_process_memory_info_t)GetProcAddress(
+          psapi, "GetProcessMemoryInfo");
+    }
+    loaded = 1;
+  }
+  pmc->cb = sizeof(*pmc);
+  return query != NULL && query(process, pmc, sizeof(*pmc));
+}
+#endif
+
+/**
+ * @brief 在子进程中执行测试（仅非STM32平台）
+ * @param test 测试信息
+ * @param test_index 测试索引
+ * @return 子进程退出码
+ */
+static int ezctest_exec_child(const ezctest_info_t *test, int test_index) {
+#ifdef EZCTEST_PLATFORM_LINUX
+  /* Unix/Linux: 使用fork */
+  /* 在fork前刷新所有缓冲区，避免子进程继承未刷新的内容 */
+  fflush(stdout);
+  fflush(stderr);
+
+  /* 子进程统计的上报通道（创建失败时只是不汇总统计） */
+  ezctest_channel_open();
+
+  pid_t pid = fork();
+
+  if (pid < 0) {
+    /* fork失败 */
+    fprintf(stderr, "Error: fork() failed\n");
+    ezctest_channel_collect();
+    return -1;
+  }
+
+  if (pid == 0) {
+    /* 子进程：运行单个测试 */
+    int exit_code = 0;
+
+    /* 标记为worker进程（避免重复输出） */
+    g_ezctest_worker_index = test_index;
+
+    /* 重置统计 */
+    g_ezctest_result.total_tests = 0;
+    g_ezctest_result.passed_tests = 0;
+    g_ezctest_result.failed_tests = 0;
+    g_ezctest_result.total_assertions = 0;
+    g_ezctest_result.failed_assertions = 0;
+    ezctest_channel_begin_child();
+    ezctest_limits_apply(ezctest_channel_fd());
+    ezctest_guarded_attach(ezctest_channel_fd());
+
+    /* 执行测试 */
+    ezctest_run_test(test);
+    ezctest_channel_finish_child();
+
+    /* 子进程退出码：0=成功，1=失败 */
+    if (g_ezctest_current_failed || g_ezctest_current_assertion_failed) {
+      exit_code = 1;
+    } else {
+      exit_code = 0;
+    }
+
+    exit(exit_code);
+  } else {
+    /* 父进程：等待子进程，同时取得它的资源占用 */
+    int status;
+    struct rusage ru;
+#ifdef EZCTEST_HAVE_WAIT4
+    if (wait4(pid, &status, 0, &ru) == pid) {
+      ezctest_rusage_from(&ru);
+    }
+#else
+    struct rusage before;
+    int have_before = (getrusage(RUSAGE_CHILDREN, &before) == 0);
+
+    if (waitpid(pid, &status, 0) == pid && have_before &&
+        getrusage(RUSAGE_CHILDREN, &ru) == 0) {
+      /* 累计值相减；maxrss 只有所有子进程中的最大值 */
+      ru.ru_minflt -= before.ru_minflt;
+      ru.ru_majflt -= before.ru_majflt;
+      ru.ru_nvcsw -= before.ru_nvcsw;
+      ru.ru_nivcsw -= before.ru_nivcsw;
+      ru.ru_utime.tv_sec -= before.ru_utime.tv_sec;
+      ru.ru_utime.tv_usec -= before.ru_utime.tv_usec;
+      ru.ru_stime.tv_sec -= before.ru_stime.tv_sec;
+      ru.ru_stime.tv_usec -= before.ru_stime.tv_usec;
+      ezctest_rusage_from(&ru);
+    }
+#endif
+    ezctest_channel_collect();
+
+    if (WIFEXITED(status)) {
+      return WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+      /* 信号终止（如段错误） - 返回特殊退出码 */
+      int sig = WTERMSIG(status);
+      /* 返回128+信号值，模拟shell的信号退出码约定 */
+      /* 这样父进程可以识别为异常退出并输出详细信息 */
+      return 128 + sig;
+    }
+    return 2; /* 其他异常情况 */
+  }
+
+#elif defined(EZCTEST_PLATFORM_WINDOWS)
+  /* Windows: 使用CreateProcess创建子进程 */
+  /* 注意：test参数在Windows下未直接使用，通过test_index在子进程中重新查找 */
+  (void)test;
+  {
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    char cmd_line[2048];
+    DWORD exit_code;
+    char exe_path[MAX_PATH];
+    int cmd_len;
+
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+    si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    ZeroMemory(&pi, sizeof(pi));
+
+    /* 获取当前程序路径 */
+    if (!GetModuleFileNameA(NULL, exe_path, MAX_PATH)) {
+      fprintf(stderr, "Error: GetModuleFileName failed (%lu)\n",
+              GetLastError());
+      return -1;
+    }
 
     /* 构建命令行：程序路径 + worker参数 + 原有参数 */
     cmd_len = snprintf(cmd_line, sizeof(cmd_line), "\"%s\" --ezctest_worker=%d",
                        exe_path, test_index);
 
-    /* 添加过滤器参数（如果有） */
-    if (g_ezctest_config.filter && cmd_len < (int)sizeof(cmd_line) - 50) {
-      cmd_len += snprintf(cmd_line + cmd_len, sizeof(cmd_line) - cmd_len,
-                          " --ezctest_filter=%s", g_ezctest_config.filter);
-    }
+    /* 添加过滤器参数（如果有） */
+    if (g_ezctest_config.filter && cmd_len < (int)sizeof(cmd_line) - 50) {
+      cmd_len += snprintf(cmd_line + cmd_len, sizeof(cmd_line) - cmd_len,
+                          " --ezctest_filter=%s", g_ezctest_config.filter);
+    }
+
+    /* 添加颜色参数 */
+    if (g_ezctest_config.color >= 0 && cmd_len < (int)sizeof(cmd_line) - 30) {
+      cmd_len += snprintf(cmd_line + cmd_len, sizeof(cmd_line) - cmd_len,
+                          " --ezctest_color=%s",
+                          g_ezctest_config.color ? "yes" : "no");
+    }
+
+    /* 添加统计上报通道参数 */
+    if (ezctest_channel_open() &&
+        cmd_len < (int)sizeof(cmd_line) - MAX_PATH - 30) {
+      cmd_len += snprintf(cmd_line + cmd_len, sizeof(cmd_line) - cmd_len,
+                          " \"--ezctest_report_file=%s\"",
+                          ezctest_channel_path());
+    }
+
+    /* 添加黄金文件更新参数 */
+    if (g_ezctest_config.update_golden &&
+        cmd_len < (int)sizeof(cmd_line) - 30) {
+      cmd_len += snprintf(cmd_line + cmd_len, sizeof(cmd_line) - cmd_len,
+                          " --ezctest_update_golden");
+    }
+
+    /* 添加泄漏检测参数 */
+    if (g_ezctest_config.leak_check && cmd_len < (int)sizeof(cmd_line) - 30) {
+      cmd_len += snprintf(cmd_line + cmd_len, sizeof(cmd_line) - cmd_len,
+                          " --ezctest_leak_check");
+    }
+
+    /* 添加基准测试参数（worker 索引按同一类测试计数） */
+    if (g_ezctest_config.benchmarks && cmd_len < (int)sizeof(cmd_line) - 90) {
+      cmd_len += snprintf(cmd_line + cmd_len, sizeof(cmd_line) - cmd_len,
+                          " --ezctest_benchmarks --ezctest_benchmark_warmup=%d"
+                          " --ezctest_benchmark_repetitions=%d",
+                          g_ezctest_config.bench_warmup,
+                          g_ezctest_config.bench_repetitions);
+    }
+
+    /* 添加 CPU 绑定参数 */
+    if (g_ezctest_config.cpu_list != NULL &&
+        cmd_len < (int)sizeof(cmd_line) - 150) {
+      cmd_len += snprintf(cmd_line + cmd_len, sizeof(cmd_line) - cmd_len,
+                          " --ezctest_cpu=%.120s", g_ezctest_config.cpu_list);
+    }
+
+    /* 创建子进程，继承stdout/stderr */
+    if (!CreateProcessA(NULL,     /* 应用程序名 */
+                        cmd_line, /* 命令行 */
+                        NULL,     /* 进程安全属性 */
+                        NULL,     /* 线程安全属性 */
+                        TRUE,     /* 继承句柄（允许子进程输出到父进程控制台） */
+                        0,        /* 创建标志 */
+                        NULL,     /* 环境变量 */
+                        NULL,     /* 当前目录 */
+                        &si,      /* 启动信息 */
+                        &pi       /* 进程信息 */
+                        )) {
+      fprintf(stderr, "Error: CreateProcess failed (%lu)\n", GetLastError());
+      fprintf(stderr, "Command: %s\n", cmd_line);
+      ezctest_channel_collect();
+      return -1;
+    }
+
+    /* 等待子进程完成，然后汇总其上报的统计、CPU时间和内存占用 */
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    ezctest_channel_collect();
+    {
+      FILETIME created, exited, kernel, user;
+      ezctest_process_memory_t pmc;
+      ezctest_rusage_t usage;
+
+      memset(&usage, 0, sizeof(usage));
+      if (GetProcessTimes(pi.hProcess, &created, &exited, &kernel, &user)) {
+        ezctest_u64 k =
+            ((ezctest_u64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+        ezctest_u64 u =
+            ((ezctest_u64)user.dwHighDateTime << 32) | user.dwLowDateTime;
+        ezctest_children_cpu_add((k + u) * 100u); /* 100纳秒 -> 纳秒 */
+        usage.user_us = (double)u / 10.0;
+        usage.sys_us = (double)k / 10.0;
+      }
+      if (ezctest_process_memory(pi.hProcess, &pmc)) {
+        usage.max_rss_kb = (unsigned long)(pmc.PeakWorkingSetSize / 1024);
+        usage.minor_faults = (unsigned long)pmc.PageFaultCount;
+      }
+      ezctest_rusage_set(&usage);
+    }
+
+    /* 获取退出码 */
+    if (!GetExitCodeProcess(pi.hProcess, &exit_code)) {
+      fprintf(stderr, "Error: GetExitCodeProcess failed (%lu)\n",
+              GetLastError());
+      CloseHandle(pi.hProcess);
+      CloseHandle(pi.hThread);
+      return -1;
+    }
+
+    /* 清理句柄 */
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+
+    /* 检查退出码 */
+    if (exit_code == 0) {
+      return 0; /* 成功 */
+    } else if (exit_code == 1) {
+      return 1; /* 测试失败 */
+    } else {
+      /* 异常退出（崩溃等） - 返回特殊值让父进程处理输出 */
+      return (int)exit_code; /* 返回实际的退出码 */
+    }
+  }
+
+#else
+  (void)test;
+  (void)test_index;
+  return -1; /* 不支持的平台 */
+#endif
+}
+
+#endif /* !EZCTEST_STM32_MODE */
+
+/* ============================================================================
+ * 浮点数比较辅助函数
+ * ========================================================================== */
+
+/**
+ * @brief 比较两个 float 是否近似相等
+ * @param a 第一个浮点数
+ * @param b 第二个浮点数
+ * @param epsilon 容差（默认 1e-6f）
+ * @return 相等返回1，不等返回0
+ */
+static int ezctest_float_eq(float a, float b, float epsilon) {
+  float diff;
+  float abs_a;
+  float abs_b;
+  float largest;
+
+  diff = a - b;
+  if (diff < 0)
+    diff = -diff;
+
+  /* 处理特殊值 */
+  if (a == b)
+    return 1; /* 处理无穷大、零等 */
+
+  /* 使用相对误差和绝对误差的混合方式 */
+  abs_a = a < 0 ? -a : a;
+  abs_b = b < 0 ? -b : b;
+  largest = abs_a > abs_b ? abs_a : abs_b;
+
+  return diff <= epsilon * largest || diff < epsilon;
+}
+
+/**
+ * @brief 比较两个 double 是否近似相等
+ * @param a 第一个双精度浮点数
+ * @param b 第二个双精度浮点数
+ * @param epsilon 容差（默认 1e-10）
+ * @return 相等返回1，不等返回0
+ */
+static int ezctest_double_eq(double a, double b, double epsilon) {
+  double diff;
+  double abs_a;
+  double abs_b;
+  double largest;
+
+  diff = a - b;
+  if (diff < 0)
+    diff = -diff;
+
+  /* 处理特殊值 */
+  if (a == b)
+    return 1; /* 处理无穷大、零等 */
+
+  /* 使用相对误差和绝对误差的混合方式 */
+  abs_a = a < 0 ? -a : a;
+  abs_b = b < 0 ? -b : b;
+  largest = abs_a > abs_b ? abs_a : abs_b;
+
+  return diff <= epsilon * largest || diff < epsilon;
+}
+
+/* ============================================================================
+ * 断言实现
+ * ========================================================================== */
+
+/**
+ * @brief 断言失败处理
+ * @param file 源文件名
+ * @param line 行号
+ * @param is_fatal 是否为致命错误（ASSERT vs EXPECT）
+ * @param format 格式化字符串
+ *
+ * @note
+ * - 所有使用 EXPECT_/ASSERT_ 宏的编译单元都需要看到函数声明
+ * - 实现仅在定义了 EZCTEST_IMPLEMENTATION 的编译单元中提供
+ */
+EZCTEST_API void ezctest_assertion_failed(const char *file, int line,
+                                          int is_fatal, const char *format,
+                                          ...);
+
+/**
+ * @brief 断言成功处理
+ *
+ * @note 同上，声明对所有编译单元可见，实现仅在 EZCTEST_IMPLEMENTATION 下提供
+ */
+EZCTEST_API void ezctest_assertion_passed(void);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+void ezctest_assertion_failed(const char *file, int line, int is_fatal,
+                              const char *format, ...) {
+  va_list args;
+
+  /* 多线程基准测试中计数和输出都要串行 */
+  ezctest_stats_lock();
+  g_ezctest_result.total_assertions++;
+  g_ezctest_result.failed_assertions++;
+  g_ezctest_current_assertion_failed = 1;
+
+  ezctest_printf_colored(EZCTEST_COLOR_RED, "%s:%d: Failure\n", file, line);
+
+  va_start(args, format);
+  printf("  ");
+  vprintf(format, args);
+  printf("\n");
+  va_end(args);
+
+  if (is_fatal) {
+    g_ezctest_current_failed = 1;
+    if (!ezctest_on_runner_thread()) {
+      printf("  (ASSERT in a benchmark thread: the thread's function "
+             "returns)\n");
+    }
+  }
+  ezctest_stats_unlock();
+}
+
+void ezctest_assertion_passed(void) {
+#if defined(EZCTEST_SITE_INC)
+  EZCTEST_SITE_INC(g_ezctest_result.total_assertions);
+#else
+  ezctest_stats_lock();
+  g_ezctest_result.total_assertions++;
+  ezctest_stats_unlock();
+#endif
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 文本差异比较（EXPECT_STREQ / EXPECT_TEXT_EQ 的失败报告）
+ * ========================================================================== */
+
+/**
+ * @brief 文本断言失败处理：输出带上下文的 unified diff
+ * @param file 源文件名
+ * @param line 行号
+ * @param is_fatal 是否为致命错误（ASSERT vs EXPECT）
+ * @param expr1 第一个表达式文本
+ * @param expr2 第二个表达式文本
+ * @param text1 第一个字符串
+ * @param text2 第二个字符串
+ * @param always_diff 为0时，短的单行字符串仍按原格式打印
+ *
+ * @details
+ * 先用 memcmp 跳过公共前缀和公共后缀，再在剩余区间上做行级 Myers diff。
+ * 所有临时内存受 EZCTEST_DIFF_MEMORY_BUDGET 限制：区间行数超出预算时按窗口
+ * 逐段比较，每个窗口在公共行处重新同步后前移，直到输出
+ * EZCTEST_DIFF_MAX_OUTPUT_LINES 行，因此即使比较上百MB的文本也能在有限内存内
+ * 报告全部差异。
+ */
+EZCTEST_API void ezctest_text_assertion_failed(const char *file, int line,
+                                               int is_fatal, const char *expr1,
+                                               const char *expr2,
+                                               const char *text1,
+                                               const char *text2,
+                                               int always_diff);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+/* diff 中的一行（包含结尾的换行符） */
+typedef struct {
+  const char *ptr;
+  size_t len;
+  unsigned int hash;
+} ezctest_diff_line_t;
+
+/* 编辑脚本操作 */
+#define EZCTEST_DIFF_EQUAL 0
+#define EZCTEST_DIFF_DELETE 1
+#define EZCTEST_DIFF_INSERT 2
+
+/* memcmp 分块大小：先整块比较，失配后再逐字节定位 */
+#define EZCTEST_DIFF_CHUNK 4096
+
+/**
+ * @brief 计算公共前缀长度
+ */
+static size_t ezctest_diff_common_prefix(const char *a, const char *b,
+                                         size_t n) {
+  size_t pos = 0;
+
+  while (n - pos >= EZCTEST_DIFF_CHUNK &&
+         memcmp(a + pos, b + pos, EZCTEST_DIFF_CHUNK) == 0) {
+    pos += EZCTEST_DIFF_CHUNK;
+  }
+  while (pos < n && a[pos] == b[pos]) {
+    pos++;
+  }
+  return pos;
+}
+
+/**
+ * @brief 计算公共后缀长度（a、b 指向各自末尾之后）
+ */
+static size_t ezctest_diff_common_suffix(const char *a_end, const char *b_end,
+                                         size_t n) {
+  size_t len = 0;
+
+  while (n - len >= EZCTEST_DIFF_CHUNK &&
+         memcmp(a_end - len - EZCTEST_DIFF_CHUNK,
+                b_end - len - EZCTEST_DIFF_CHUNK, EZCTEST_DIFF_CHUNK) == 0) {
+    len += EZCTEST_DIFF_CHUNK;
+  }
+  while (len < n && a_end[-(long)len - 1] == b_end[-(long)len - 1]) {
+    len++;
+  }
+  return len;
+}
+
+/**
+ * @brief 将区间切分为行（最多 max_lines 行）
+ * @return 实际行数；*consumed 返回已切分的字节数
+ */
+static size_t ezctest_diff_split_lines(const char *p, size_t len,
+                                       ezctest_diff_line_t *lines,
+                                       size_t max_lines, size_t *consumed) {
+  size_t count = 0;
+  size_t pos = 0;
+
+  while (pos < len && count < max_lines) {
+    const char *nl = (const char *)memchr(p + pos, '\n', len - pos);
+    size_t line_len = nl ? (size_t)(nl - (p + pos)) + 1 : len - pos;
+    unsigned int h = 2166136261u; /* FNV-1a */
+    size_t i;
+
+    for (i = 0; i < line_len; i++) {
+      h = (h ^ (unsigned char)p[pos + i]) * 16777619u;
+    }
+    lines[count].ptr = p + pos;
+    lines[count].len = line_len;
+    lines[count].hash = h;
+    count++;
+    pos += line_len;
+  }
+  *consumed = pos;
+  return count;
+}
+
+static int ezctest_diff_line_eq(const ezctest_diff_line_t *a,
+                                const ezctest_diff_line_t *b) {
+  return a->hash == b->hash && a->len == b->len &&
+         memcmp(a->ptr, b->ptr, a->len) == 0;
+}
+
+/**
+ * @brief 贪心 Myers 算法，trace 中保存每一步的 V 数组用于回溯
+ * @return 编辑距离 D；超过 dmax 时返回 -1
+ *
+ * @note 第 d 步的 V[-d..d] 保存在 trace[d*d] 起的 2d+1 个元素中，
+ *       因此 trace 需要 (dmax+1)^2 个元素。
+ */
+static long ezctest_diff_myers(const ezctest_diff_line_t *a, long n,
+                               const ezctest_diff_line_t *b, long m,
+                               long dmax, long *v, long *trace) {
+  long d, k;
+  long off = dmax + 1;
+
+  v[off + 1] = 0;
+  for (d = 0; d <= dmax; d++) {
+    for (k = -d; k <= d; k += 2) {
+      long x, y;
+      if (k == -d || (k != d && v[off + k - 1] < v[off + k + 1])) {
+        x = v[off + k + 1];
+      } else {
+        x = v[off + k - 1] + 1;
+      }
+      y = x - k;
+      while (x < n && y < m && ezctest_diff_line_eq(&a[x], &b[y])) {
+        x++;
+        y++;
+      }
+      v[off + k] = x;
+    }
+    memcpy(trace + d * d, v + off - d, sizeof(long) * (size_t)(2 * d + 1));
+    for (k = -d; k <= d; k += 2) {
+      if (v[off + k] >= n && v[off + k] - k >= m) {
+        return d;
+      }
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief 由 trace 回溯出编辑脚本（ops 长度为 n+m，返回实际操作数）
+ */
+static long ezctest_diff_backtrack(long n, long m, long d_total,
+                                   const long *trace, unsigned char *ops) {
+  long x = n;
+  long y = m;
+  long pos = n + m;
+  long d;
+
+  for (d = d_total; d > 0; d--) {
+    const long *vp = trace + (d - 1) * (d - 1) + (d - 1); /* vp[k], |k|<d */
+    long k = x - y;
+    long prev_k, prev_x, prev_y;
+
+    if (k == -d || (k != d && vp[k - 1] < vp[k + 1])) {
+      prev_k = k + 1;
+    } else {
+      prev_k = k - 1;
+    }
+    prev_x = vp[prev_k];
+    prev_y = prev_x - prev_k;
+
+    while (x > prev_x && y > prev_y) {
+      ops[--pos] = EZCTEST_DIFF_EQUAL;
+      x--;
+      y--;
+    }
+    if (prev_k == k + 1) {
+      ops[--pos] = EZCTEST_DIFF_INSERT;
+      y--;
+    } else {
+      ops[--pos] = EZCTEST_DIFF_DELETE;
+      x--;
+    }
+  }
+  while (x > 0 && y > 0) {
+    ops[--pos] = EZCTEST_DIFF_EQUAL;
+    x--;
+    y--;
+  }
+
+  /* 操作序列写在 ops 尾部，移到开头 */
+  memmove(ops, ops + pos, (size_t)(n + m - pos));
+  return n + m - pos;
+}
+
+/**
+ * @brief 打印一行 diff 内容（过长时截断，focus 为需要居中显示的列）
+ */
+static void ezctest_diff_print_line(char tag, const char *p, size_t len,
+                                    size_t focus) {
+  size_t begin = 0;
+  size_t end;
+  size_t i;
+  int has_newline = (len > 0 && p[len - 1] == '\n');
+
+  if (has_newline) {
+    len--;
+  }
+  end = len;
+  if (len > EZCTEST_DIFF_LINE_WIDTH) {
+    if (focus != (size_t)-1 && focus > EZCTEST_DIFF_LINE_WIDTH / 2) {
+      begin = focus - EZCTEST_DIFF_LINE_WIDTH / 2;
+    }
+    if (begin + EZCTEST_DIFF_LINE_WIDTH > len) {
+      begin = len - EZCTEST_DIFF_LINE_WIDTH;
+    }
+    end = begin + EZCTEST_DIFF_LINE_WIDTH;
+  }
+
+  printf("  %c%s", tag, begin > 0 ? "..." : "");
+  for (i = begin; i < end; i++) {
+    unsigned char c = (unsigned char)p[i];
+    putchar((c < 0x20 && c != '\t') || c == 0x7f ? '.' : (int)c);
+  }
+  printf("%s\n", end < len ? "..." : "");
+  if (!has_newline) {
+    printf("  \\ No newline at end of text\n");
+  }
+}
+
+/**
+ * @brief 输出一个窗口的编辑脚本中的各个 hunk
+ * @param a_line 窗口首行在 text1 中的行号（b_line 同理）
+ * @param focus1 首个差异所在行（focus2 同理），该行按 column 居中显示
+ * @param printed 累计输出行数，达到 EZCTEST_DIFF_MAX_OUTPUT_LINES 时停止
+ * @return 已输出到的操作下标（小于 nops 表示输出被截断）
+ */
+static long ezctest_diff_print_hunks(const unsigned char *ops, long nops,
+                                     const ezctest_diff_line_t *lines1,
+                                     const ezctest_diff_line_t *lines2,
+                                     size_t a_line, size_t b_line,
+                                     const char *focus1, const char *focus2,
+                                     size_t column, long *printed) {
+  long i = 0;
+  long ai = 0;
+  long bi = 0;
+
+  /* 逐个输出 hunk：变更前后各保留 EZCTEST_DIFF_CONTEXT_LINES 行上下文 */
+  while (i < nops) {
+    long start, end, j, eq_run;
+    long a0, b0, a_len, b_len;
+
+    if (ops[i] == EZCTEST_DIFF_EQUAL) {
+      i++;
+      ai++;
+      bi++;
+      continue;
+    }
+    if (*printed >= EZCTEST_DIFF_MAX_OUTPUT_LINES) {
+      return i;
+    }
+
+    /* 回退上下文（均为相等行） */
+    start = i;
+    a0 = ai;
+    b0 = bi;
+    while (start > 0 && i - start < EZCTEST_DIFF_CONTEXT_LINES &&
+           ops[start - 1] == EZCTEST_DIFF_EQUAL) {
+      start--;
+      a0--;
+      b0--;
+    }
+
+    /* 向后合并：相等行间隔不超过 2*context 的变更归入同一 hunk */
+    end = i;
+    for (;;) {
+      while (end < nops && ops[end] != EZCTEST_DIFF_EQUAL) {
+        end++;
+      }
+      eq_run = 0;
+      while (end + eq_run < nops && ops[end + eq_run] == EZCTEST_DIFF_EQUAL) {
+        eq_run++;
+      }
+      if (end + eq_run < nops && eq_run <= 2 * EZCTEST_DIFF_CONTEXT_LINES) {
+        end += eq_run;
+        continue;
+      }
+      end += eq_run < EZCTEST_DIFF_CONTEXT_LINES ? eq_run
+                                                 : EZCTEST_DIFF_CONTEXT_LINES;
+      break;
+    }
+
+    a_len = 0;
+    b_len = 0;
+    for (j = start; j < end; j++) {
+      if (ops[j] != EZCTEST_DIFF_INSERT) {
+        a_len++;
+      }
+      if (ops[j] != EZCTEST_DIFF_DELETE) {
+        b_len++;
+      }
+    }
+    /* 与 unified diff 一致：空区间的起始行号是它前面那一行（可为 0） */
+    printf("  @@ -%lu,%lu +%lu,%lu @@\n",
+           (unsigned long)(a_line + a0 - (a_len == 0 ? 1 : 0)),
+           (unsigned long)a_len,
+           (unsigned long)(b_line + b0 - (b_len == 0 ? 1 : 0)),
+           (unsigned long)b_len);
+
+    ai = a0;
+    bi = b0;
+    for (j = start; j < end; j++) {
+      if (*printed >= EZCTEST_DIFF_MAX_OUTPUT_LINES) {
+        return j;
+      }
+      if (ops[j] == EZCTEST_DIFF_EQUAL) {
+        ezctest_diff_print_line(' ', lines1[ai].ptr, lines1[ai].len,
+                                (size_t)-1);
+        ai++;
+        bi++;
+      } else if (ops[j] == EZCTEST_DIFF_DELETE) {
+        ezctest_diff_print_line('-', lines1[ai].ptr, lines1[ai].len,
+                                lines1[ai].ptr == focus1 ? column
+                                                         : (size_t)-1);
+        ai++;
+      } else {
+        ezctest_diff_print_line('+', lines2[bi].ptr, lines2[bi].len,
+                                lines2[bi].ptr == focus2 ? column
+                                                         : (size_t)-1);
+        bi++;
+      }
+      (*printed)++;
+    }
+    i = end;
+  }
+  return nops;
+}
+
+void ezctest_text_assertion_failed(const char *file, int line, int is_fatal,
+                                   const char *expr1, const char *expr2,
+                                   const char *text1, const char *text2,
+                                   int always_diff) {
+  size_t len1 = strlen(text1);
+  size_t len2 = strlen(text2);
+  size_t min_len = len1 < len2 ? len1 : len2;
+  size_t prefix, suffix, line_start, column;
+  size_t first_line = 1; /* 首个差异所在行（从1开始） */
+  size_t win_start, win_end1, win_end2, win_line;
+  size_t pos1, pos2, a_line, b_line;
+  size_t budget = EZCTEST_DIFF_MEMORY_BUDGET;
+  size_t max_lines, cap1, cap2, used1, used2;
+  long n, m, dmax, d, nops;
+  long printed = 0;
+  int context;
+  const char *p;
+  ezctest_diff_line_t *lines1 = NULL;
+  ezctest_diff_line_t *lines2 = NULL;
+  long *trace = NULL;
+  long *v = NULL;
+  unsigned char *ops = NULL;
+  int truncated = 0;
+  int over_budget;
+
+  prefix = ezctest_diff_common_prefix(text1, text2, min_len);
+
+  /* 短的单行字符串：保持原有的输出格式 */
+  if (!always_diff && len1 <= EZCTEST_STREQ_INLINE_LIMIT &&
+      len2 <= EZCTEST_STREQ_INLINE_LIMIT && !strchr(text1, '\n') &&
+      !strchr(text2, '\n')) {
+    ezctest_assertion_failed(file, line, is_fatal,
+                             "Expected: %s == %s\n  Actual: \"%s\" != \"%s\"",
+                             expr1, expr2, text1, text2);
+    return;
+  }
+
+  /* 首个差异的行号和列号 */
+  line_start = 0;
+  p = text1;
+  while ((p = (const char *)memchr(p, '\n', prefix - (size_t)(p - text1))) !=
+         NULL) {
+    p++;
+    first_line++;
+    line_start = (size_t)(p - text1);
+  }
+  column = prefix - line_start;
+
+  ezctest_assertion_failed(
+      file, line, is_fatal,
+      "Expected: %s == %s\n  Actual: texts differ (%lu vs %lu bytes), first "
+      "difference at line %lu, column %lu (offset %lu)",
+      expr1, expr2, (unsigned long)len1, (unsigned long)len2,
+      (unsigned long)first_line, (unsigned long)(column + 1),
+      (unsigned long)prefix);
+
+  /* 公共后缀（不与前缀重叠，并对齐到行首） */
+  suffix = ezctest_diff_common_suffix(text1 + len1, text2 + len2,
+                                      min_len - prefix);
+  while (suffix > 0 &&
+         !((suffix == len1 || text1[len1 - suffix - 1] == '\n') &&
+           (suffix == len2 || text2[len2 - suffix - 1] == '\n'))) {
+    suffix--;
+  }
+
+  /* 窗口向前、向后各扩展若干上下文行 */
+  win_start = line_start;
+  win_line = first_line;
+  for (context = 0; context < EZCTEST_DIFF_CONTEXT_LINES && win_start > 0;
+       context++) {
+    win_start--;
+    while (win_start > 0 && text1[win_start - 1] != '\n') {
+      win_start--;
+    }
+    win_line--;
+  }
+  win_end1 = len1 - suffix;
+  win_end2 = len2 - suffix;
+  for (context = 0; context < EZCTEST_DIFF_CONTEXT_LINES && win_end1 < len1;
+       context++) {
+    const char *nl =
+        (const char *)memchr(text1 + win_end1, '\n', len1 - win_end1);
+    size_t step = nl ? (size_t)(nl - (text1 + win_end1)) + 1 : len1 - win_end1;
+    win_end1 += step;
+    win_end2 += step;
+  }
+
+  /* 按内存预算分配：1/4 用于行表，其余用于编辑脚本和 Myers trace；
+   * 行数不会超过区间字节数 + 1，小文本只分配实际需要的行表 */
+  max_lines = budget / 4 / (2 * sizeof(ezctest_diff_line_t));
+  if (max_lines == 0) {
+    max_lines = 1;
+  }
+  cap1 = win_end1 - win_start + 1;
+  cap2 = win_end2 - win_start + 1;
+  if (cap1 > max_lines) {
+    cap1 = max_lines;
+  }
+  if (cap2 > max_lines) {
+    cap2 = max_lines;
+  }
+  lines1 = (ezctest_diff_line_t *)malloc(sizeof(ezctest_diff_line_t) * cap1);
+  lines2 = (ezctest_diff_line_t *)malloc(sizeof(ezctest_diff_line_t) * cap2);
+  if (lines1 == NULL || lines2 == NULL) {
+    printf("  (diff unavailable: out of memory)\n");
+    free(lines1);
+    free(lines2);
+    return;
+  }
+
+  {
+    size_t rest = budget - budget / 4 - (cap1 + cap2);
+    size_t cells = rest / sizeof(long);
+    long root = 0;
+
+    /* trace 需要 (dmax+1)^2 个元素，V 需要 2*dmax+3 个元素 */
+    while ((size_t)(root + 1) * (size_t)(root + 1) + 2 * (size_t)root + 4 <=
+           cells) {
+      root++;
+    }
+    dmax = root - 1;
+    if (dmax > (long)(cap1 + cap2)) {
+      dmax = (long)(cap1 + cap2);
+    }
+  }
+
+  if (dmax >= 0) {
+    ops = (unsigned char *)malloc(cap1 + cap2 + 1);
+    trace = (long *)malloc(sizeof(long) * (size_t)((dmax + 1) * (dmax + 1)));
+    v = (long *)malloc(sizeof(long) * (size_t)(2 * dmax + 3));
+  }
+  over_budget = (ops == NULL || trace == NULL || v == NULL);
+
+  printf("  --- %s\n  +++ %s\n", expr1, expr2);
+
+  /* 差异区间按窗口推进：每个窗口最多 cap1/cap2 行，输出其中的 hunk 后
+   * 在最后一段公共行处重新同步，下一个窗口从那里开始 */
+  pos1 = win_start;
+  pos2 = win_start;
+  a_line = win_line;
+  b_line = win_line;
+  while (!over_budget && (pos1 < win_end1 || pos2 < win_end2)) {
+    size_t lim = max_lines;
+    long cut, done, k, a_used, b_used;
+
+    for (;;) {
+      n = (long)ezctest_diff_split_lines(text1 + pos1, win_end1 - pos1, lines1,
+                                         lim < cap1 ? lim : cap1, &used1);
+      m = (long)ezctest_diff_split_lines(text2 + pos2, win_end2 - pos2, lines2,
+                                         lim < cap2 ? lim : cap2, &used2);
+      d = ezctest_diff_myers(lines1, n, lines2, m, dmax < n + m ? dmax : n + m,
+                             v, trace);
+      if (d >= 0 || lim == 1) {
+        break;
+      }
+      /* 编辑距离超出预算：缩小窗口重试（n + m 不超过 dmax 时一定成功） */
+      lim = (size_t)(n > m ? n : m) / 2;
+      if (lim == 0) {
+        lim = 1;
+      }
+    }
+    if (d < 0) {
+      over_budget = 1;
+      break;
+    }
+
+    nops = ezctest_diff_backtrack(n, m, d, trace, ops);
+    cut = nops;
+    if (used1 < win_end1 - pos1 || used2 < win_end2 - pos2) {
+      /* 窗口末尾的对齐还不确定：在最后一段能分开 hunk 的公共行处重新
+       * 同步，本窗口只输出已结束的 hunk（含下文），下一个窗口从这段
+       * 公共行的最后 context 行开始，未结束的 hunk 整个留给它 */
+      long run_end = nops;
+      long run_start = nops;
+      long last_start = -1;
+      long lead = 0;
+
+      while (run_end > 0) {
+        while (run_end > 0 && ops[run_end - 1] != EZCTEST_DIFF_EQUAL) {
+          run_end--;
+        }
+        run_start = run_end;
+        while (run_start > 0 && ops[run_start - 1] == EZCTEST_DIFF_EQUAL) {
+          run_start--;
+        }
+        if (last_start < 0 && run_end > 0) {
+          last_start = run_start;
+        }
+        if (run_end - run_start > 2 * EZCTEST_DIFF_CONTEXT_LINES) {
+          break;
+        }
+        run_end = run_start;
+      }
+      while (lead < nops && ops[lead] == EZCTEST_DIFF_EQUAL) {
+        lead++;
+      }
+      if (run_end > 0) {
+        cut = run_end - EZCTEST_DIFF_CONTEXT_LINES;
+      } else if (lead > EZCTEST_DIFF_CONTEXT_LINES) {
+        cut = lead - EZCTEST_DIFF_CONTEXT_LINES; /* 跳过 hunk 之前的公共行 */
+      } else if (last_start > 0) {
+        cut = last_start; /* hunk 比窗口还长：只能在公共行处拆开 */
+      }
+      if (cut == 0) {
+        cut = nops;
+      }
+    }
+
+    done = ezctest_diff_print_hunks(ops, cut, lines1, lines2, a_line, b_line,
+                                    text1 + line_start, text2 + line_start,
+                                    column, &printed);
+    if (done < cut) {
+      truncated = 1;
+      break;
+    }
+
+    a_used = 0;
+    b_used = 0;
+    for (k = 0; k < cut; k++) {
+      if (ops[k] != EZCTEST_DIFF_INSERT) {
+        a_used++;
+      }
+      if (ops[k] != EZCTEST_DIFF_DELETE) {
+        b_used++;
+      }
+    }
+    pos1 = a_used < n ? (size_t)(lines1[a_used].ptr - text1) : pos1 + used1;
+    pos2 = b_used < m ? (size_t)(lines2[b_used].ptr - text2) : pos2 + used2;
+    a_line += (size_t)a_used;
+    b_line += (size_t)b_used;
+    if (printed >= EZCTEST_DIFF_MAX_OUTPUT_LINES &&
+        (pos1 < win_end1 || pos2 < win_end2)) {
+      truncated = 1;
+      break;
+    }
+  }
+
+  if (over_budget && printed == 0) {
+    /* 超出内存预算：只显示首个差异行 */
+    printf("  @@ -%lu +%lu @@ (diff exceeds memory budget, showing first "
+           "difference only)\n",
+           (unsigned long)first_line, (unsigned long)first_line);
+    {
+      const char *nl1 = (const char *)memchr(text1 + line_start, '\n',
+                                             len1 - line_start);
+      const char *nl2 = (const char *)memchr(text2 + line_start, '\n',
+                                             len2 - line_start);
+      if (line_start < len1) {
+        ezctest_diff_print_line(
+            '-', text1 + line_start,
+            nl1 ? (size_t)(nl1 - (text1 + line_start)) + 1 : len1 - line_start,
+            column);
+      }
+      if (line_start < len2) {
+        ezctest_diff_print_line(
+            '+', text2 + line_start,
+            nl2 ? (size_t)(nl2 - (text2 + line_start)) + 1 : len2 - line_start,
+            column);
+      }
+    }
+  } else if (over_budget) {
+    printf("  ... (remaining differences exceed memory budget)\n");
+  } else if (truncated) {
+    printf("  ... (diff output truncated after %d lines)\n",
+           EZCTEST_DIFF_MAX_OUTPUT_LINES);
+  }
+
+  free(ops);
+  free(trace);
+  free(v);
+  free(lines1);
+  free(lines2);
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 文件分窗口读取
+ * ========================================================================== */
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+/**
+ * @brief 分窗口的只读文件读取器
+ *
+ * @details
+ * Windows 使用 MapViewOfFile、Linux/Unix 使用 mmap，每次只映射一个
+ * EZCTEST_MAP_WINDOW_SIZE 大小的窗口，取下一个窗口前先解除上一个映射，
+ * 因此处理 GB 级文件时常驻内存不随文件大小增长，也不会把文件复制到堆上。
+ * 无法映射（管道、特殊文件、映射失败）时退化为固定缓冲区读取；
+ * STM32 等其他平台只使用 fread。
+ */
+typedef struct {
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  HANDLE file;           /* 文件句柄 */
+  HANDLE mapping;        /* 映射对象（空文件或无法映射时为NULL） */
+#elif defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  int fd;                /* 文件描述符 */
+  int use_mmap;          /* 是否使用mmap */
+#else
+  FILE *fp;              /* 文件流 */
+#endif
+  ezctest_u64 size;      /* 打开时的文件大小 */
+  ezctest_u64 offset;    /* 已读取的字节数（下一个窗口的起始偏移） */
+  void *view;            /* 当前映射窗口 */
+  size_t view_len;       /* 当前映射窗口长度 */
+  unsigned char *buffer; /* 退化读取使用的缓冲区 */
+  int error;             /* 是否发生读取错误 */
+} ezctest_file_reader_t;
+
+/**
+ * @brief 打开文件
+ * @return 成功返回1，无法打开返回0
+ */
+static int ezctest_file_reader_open(ezctest_file_reader_t *r,
+                                    const char *path) {
+  memset(r, 0, sizeof(*r));
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  {
+    DWORD low;
+    DWORD high = 0;
+
+    r->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                          OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (r->file == INVALID_HANDLE_VALUE) {
+      return 0;
+    }
+    low = GetFileSize(r->file, &high);
+    if (low == 0xFFFFFFFF && GetLastError() != NO_ERROR) {
+      CloseHandle(r->file);
+      return 0;
+    }
+    r->size = ((ezctest_u64)high << 32) | (ezctest_u64)low;
+    /* 空文件无法创建映射对象；映射失败时退化为ReadFile */
+    if (r->size > 0) {
+      r->mapping =
+          CreateFileMappingA(r->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+  }
+#elif defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  {
+    struct stat st;
+
+    r->fd = open(path, O_RDONLY);
+    if (r->fd < 0) {
+      return 0;
+    }
+    if (fstat(r->fd, &st) != 0) {
+      close(r->fd);
+      return 0;
+    }
+    r->size = (ezctest_u64)st.st_size;
+    r->use_mmap = S_ISREG(st.st_mode) && st.st_size > 0;
+  }
+#else
+  r->fp = fopen(path, "rb");
+  if (r->fp == NULL) {
+    return 0;
+  }
+  if (fseek(r->fp, 0, SEEK_END) == 0) {
+    long end = ftell(r->fp);
+    r->size = end > 0 ? (ezctest_u64)end : 0;
+  }
+  rewind(r->fp);
+#endif
+  return 1;
+}
+
+/**
+ * @brief 解除当前窗口的映射
+ */
+static void ezctest_file_reader_unmap(ezctest_file_reader_t *r) {
+  if (r->view == NULL) {
+    return;
+  }
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  UnmapViewOfFile(r->view);
+#elif defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  munmap(r->view, r->view_len);
+#endif
+  r->view = NULL;
+  r->view_len = 0;
+}
+
+/**
+ * @brief 读取下一个窗口
+ * @param data 输出：窗口数据，在下一次调用或关闭前有效
+ * @return 窗口字节数；文件结束或出错时返回0（出错时 r->error 置1）
+ */
+static size_t ezctest_file_reader_next(ezctest_file_reader_t *r,
+                                       const unsigned char **data) {
+  size_t len;
+
+  ezctest_file_reader_unmap(r);
+  *data = NULL;
+
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  if (r->mapping != NULL) {
+    if (r->offset >= r->size) {
+      return 0;
+    }
+    len = (r->size - r->offset > (ezctest_u64)EZCTEST_MAP_WINDOW_SIZE)
+              ? (size_t)EZCTEST_MAP_WINDOW_SIZE
+              : (size_t)(r->size - r->offset);
+    r->view = MapViewOfFile(r->mapping, FILE_MAP_READ,
+                            (DWORD)(r->offset >> 32),
+                            (DWORD)(r->offset & 0xFFFFFFFFu), len);
+    if (r->view != NULL) {
+      r->view_len = len;
+      r->offset += len;
+      *data = (const unsigned char *)r->view;
+      return len;
+    }
+    /* 映射失败：从当前位置改为ReadFile */
+    CloseHandle(r->mapping);
+    r->mapping = NULL;
+    {
+      LONG high = (LONG)(r->offset >> 32);
+      SetFilePointer(r->file, (LONG)(r->offset & 0xFFFFFFFFu), &high,
+                     FILE_BEGIN);
+    }
+  }
+#elif defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  if (r->use_mmap) {
+    if (r->offset >= r->size) {
+      return 0;
+    }
+    len = (r->size - r->offset > (ezctest_u64)EZCTEST_MAP_WINDOW_SIZE)
+              ? (size_t)EZCTEST_MAP_WINDOW_SIZE
+              : (size_t)(r->size - r->offset);
+    r->view = mmap(NULL, len, PROT_READ, MAP_PRIVATE, r->fd, (off_t)r->offset);
+    if (r->view != MAP_FAILED) {
+      /* 顺序访问提示：内核加大预读并尽早回收已读页面 */
+      posix_madvise(r->view, len, POSIX_MADV_SEQUENTIAL);
+      r->view_len = len;
+      r->offset += len;
+      *data = (const unsigned char *)r->view;
+      return len;
+    }
+    /* 映射失败：从当前位置改为read */
+    r->view = NULL;
+    r->use_mmap = 0;
+    if (lseek(r->fd, (off_t)r->offset, SEEK_SET) == (off_t)-1) {
+      r->error = 1;
+      return 0;
+    }
+  }
+#endif
+
+  if (r->buffer == NULL) {
+    r->buffer = (unsigned char *)malloc(EZCTEST_IO_BUFFER_SIZE);
+    if (r->buffer == NULL) {
+      r->error = 1;
+      return 0;
+    }
+  }
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  {
+    DWORD got = 0;
+    if (!ReadFile(r->file, r->buffer, EZCTEST_IO_BUFFER_SIZE, &got, NULL)) {
+      r->error = 1;
+      return 0;
+    }
+    len = (size_t)got;
+  }
+#elif defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  {
+    ssize_t got = read(r->fd, r->buffer, EZCTEST_IO_BUFFER_SIZE);
+    if (got < 0) {
+      r->error = 1;
+      return 0;
+    }
+    len = (size_t)got;
+  }
+#else
+  len = fread(r->buffer, 1, EZCTEST_IO_BUFFER_SIZE, r->fp);
+  if (len == 0 && ferror(r->fp)) {
+    r->error = 1;
+    return 0;
+  }
+#endif
+  r->offset += len;
+  *data = r->buffer;
+  return len;
+}
+
+/**
+ * @brief 关闭文件并释放窗口和缓冲区
+ */
+static void ezctest_file_reader_close(ezctest_file_reader_t *r) {
+  ezctest_file_reader_unmap(r);
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  if (r->mapping != NULL) {
+    CloseHandle(r->mapping);
+  }
+  CloseHandle(r->file);
+#elif defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  close(r->fd);
+#else
+  fclose(r->fp);
+#endif
+  free(r->buffer);
+  r->buffer = NULL;
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 内容哈希断言（XXH64）
+ * ========================================================================== */
+
+/**
+ * @brief XXH64 流式计算状态
+ * @note 算法与 xxHash 的 XXH64 完全一致，结果可与 xxh64sum 工具互相校验
+ */
+typedef struct {
+  ezctest_u64 acc[4];      /* 4路累加器 */
+  ezctest_u64 total_len;   /* 已输入的总字节数 */
+  ezctest_u64 seed;        /* 种子 */
+  unsigned char buf[32];   /* 不足一个条带(32字节)的剩余输入 */
+  unsigned int buf_len;    /* buf 中的有效字节数 */
+} ezctest_xxh64_state_t;
+
+/**
+ * @brief 初始化 XXH64 状态
+ */
+EZCTEST_API void ezctest_xxh64_reset(ezctest_xxh64_state_t *state,
+                                     ezctest_u64 seed);
+
+/**
+ * @brief 向 XXH64 状态输入数据（可多次调用）
+ */
+EZCTEST_API void ezctest_xxh64_update(ezctest_xxh64_state_t *state,
+                                      const void *data, size_t size);
+
+/**
+ * @brief 计算当前输入的 XXH64 值（不改变状态）
+ */
+EZCTEST_API ezctest_u64
+ezctest_xxh64_digest(const ezctest_xxh64_state_t *state);
+
+/**
+ * @brief 一次性计算内存块的 XXH64 值
+ */
+EZCTEST_API ezctest_u64 ezctest_xxh64(const void *data, size_t size,
+                                      ezctest_u64 seed);
+
+/**
+ * @brief 检查内存块的 XXH64 值是否等于期望的十六进制字符串
+ * @param expr 数据表达式文本（用于失败消息）
+ * @param data 数据指针
+ * @param size 数据字节数
+ * @param hex 期望值（16位以内十六进制，可带 0x 前缀）
+ * @param buf 失败消息缓冲区
+ * @param bufsize 缓冲区大小
+ * @return 匹配返回1，否则返回0并在 buf 中写入失败消息（含实际哈希值）
+ */
+EZCTEST_API int ezctest_hash_check(const char *expr, const void *data,
+                                   size_t size, const char *hex, char *buf,
+                                   size_t bufsize);
+
+/**
+ * @brief 检查文件内容的 XXH64 值是否等于期望的十六进制字符串
+ * @note 文件按窗口映射或流式读取，内存占用与文件大小无关
+ */
+EZCTEST_API int ezctest_file_hash_check(const char *path, const char *hex,
+                                        char *buf, size_t bufsize);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+#define EZCTEST_XXH_PRIME64_1 EZCTEST_U64_C(0x9E3779B1u, 0x85EBCA87u)
+#define EZCTEST_XXH_PRIME64_2 EZCTEST_U64_C(0xC2B2AE3Du, 0x27D4EB4Fu)
+#define EZCTEST_XXH_PRIME64_3 EZCTEST_U64_C(0x165667B1u, 0x9E3779F9u)
+#define EZCTEST_XXH_PRIME64_4 EZCTEST_U64_C(0x85EBCA77u, 0xC2B2AE63u)
+#define EZCTEST_XXH_PRIME64_5 EZCTEST_U64_C(0x27D4EB2Fu, 0x165667C5u)
+
+#define EZCTEST_XXH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+/* 小端读取：小端平台直接 memcpy，由编译器合并为一次加载 */
+static ezctest_u64 ezctest_xxh_read64(const unsigned char *p) {
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) &&                \
+    __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return (ezctest_u64)p[0] | ((ezctest_u64)p[1] << 8) |
+         ((ezctest_u64)p[2] << 16) | ((ezctest_u64)p[3] << 24) |
+         ((ezctest_u64)p[4] << 32) | ((ezctest_u64)p[5] << 40) |
+         ((ezctest_u64)p[6] << 48) | ((ezctest_u64)p[7] << 56);
+#else
+  ezctest_u64 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+#endif
+}
+
+static ezctest_u64 ezctest_xxh_read32(const unsigned char *p) {
+  return (ezctest_u64)p[0] | ((ezctest_u64)p[1] << 8) |
+         ((ezctest_u64)p[2] << 16) | ((ezctest_u64)p[3] << 24);
+}
+
+static ezctest_u64 ezctest_xxh_round(ezctest_u64 acc, ezctest_u64 input) {
+  acc += input * EZCTEST_XXH_PRIME64_2;
+  acc = EZCTEST_XXH_ROTL64(acc, 31);
+  return acc * EZCTEST_XXH_PRIME64_1;
+}
+
+static ezctest_u64 ezctest_xxh_merge_round(ezctest_u64 acc, ezctest_u64 val) {
+  acc ^= ezctest_xxh_round(0, val);
+  return acc * EZCTEST_XXH_PRIME64_1 + EZCTEST_XXH_PRIME64_4;
+}
+
+/* 处理若干完整的32字节条带，返回处理的字节数 */
+static size_t ezctest_xxh_stripes(ezctest_u64 *acc, const unsigned char *p,
+                                  size_t size) {
+  ezctest_u64 v1 = acc[0];
+  ezctest_u64 v2 = acc[1];
+  ezctest_u64 v3 = acc[2];
+  ezctest_u64 v4 = acc[3];
+  const unsigned char *end = p + (size & ~(size_t)31);
+  const unsigned char *start = p;
+
+  while (p < end) {
+    v1 = ezctest_xxh_round(v1, ezctest_xxh_read64(p));
+    v2 = ezctest_xxh_round(v2, ezctest_xxh_read64(p + 8));
+    v3 = ezctest_xxh_round(v3, ezctest_xxh_read64(p + 16));
+    v4 = ezctest_xxh_round(v4, ezctest_xxh_read64(p + 24));
+    p += 32;
+  }
+  acc[0] = v1;
+  acc[1] = v2;
+  acc[2] = v3;
+  acc[3] = v4;
+  return (size_t)(p - start);
+}
+
+void ezctest_xxh64_reset(ezctest_xxh64_state_t *state, ezctest_u64 seed) {
+  memset(state, 0, sizeof(*state));
+  state->seed = seed;
+  state->acc[0] = seed + EZCTEST_XXH_PRIME64_1 + EZCTEST_XXH_PRIME64_2;
+  state->acc[1] = seed + EZCTEST_XXH_PRIME64_2;
+  state->acc[2] = seed;
+  state->acc[3] = seed - EZCTEST_XXH_PRIME64_1;
+}
+
+void ezctest_xxh64_update(ezctest_xxh64_state_t *state, const void *data,
+                          size_t size) {
+  const unsigned char *p = (const unsigned char *)data;
+
+  state->total_len += size;
+
+  /* 先补齐上次剩余的条带 */
+  if (state->buf_len > 0) {
+    size_t fill = 32 - state->buf_len;
+    if (fill > size) {
+      fill = size;
+    }
+    memcpy(state->buf + state->buf_len, p, fill);
+    state->buf_len += (unsigned int)fill;
+    p += fill;
+    size -= fill;
+    if (state->buf_len < 32) {
+      return;
+    }
+    ezctest_xxh_stripes(state->acc, state->buf, 32);
+    state->buf_len = 0;
+  }
+
+  /* 主循环直接在输入数据上进行，不做拷贝 */
+  {
+    size_t done = ezctest_xxh_stripes(state->acc, p, size);
+    p += done;
+    size -= done;
+  }
+
+  if (size > 0) {
+    memcpy(state->buf, p, size);
+    state->buf_len = (unsigned int)size;
+  }
+}
+
+ezctest_u64 ezctest_xxh64_digest(const ezctest_xxh64_state_t *state) {
+  ezctest_u64 h;
+  const unsigned char *p = state->buf;
+  size_t remain = state->buf_len;
+
+  if (state->total_len >= 32) {
+    h = EZCTEST_XXH_ROTL64(state->acc[0], 1) +
+        EZCTEST_XXH_ROTL64(state->acc[1], 7) +
+        EZCTEST_XXH_ROTL64(state->acc[2], 12) +
+        EZCTEST_XXH_ROTL64(state->acc[3], 18);
+    h = ezctest_xxh_merge_round(h, state->acc[0]);
+    h = ezctest_xxh_merge_round(h, state->acc[1]);
+    h = ezctest_xxh_merge_round(h, state->acc[2]);
+    h = ezctest_xxh_merge_round(h, state->acc[3]);
+  } else {
+    h = state->seed + EZCTEST_XXH_PRIME64_5;
+  }
+  h += state->total_len;
+
+  while (remain >= 8) {
+    h ^= ezctest_xxh_round(0, ezctest_xxh_read64(p));
+    h = EZCTEST_XXH_ROTL64(h, 27) * EZCTEST_XXH_PRIME64_1 +
+        EZCTEST_XXH_PRIME64_4;
+    p += 8;
+    remain -= 8;
+  }
+  if (remain >= 4) {
+    h ^= ezctest_xxh_read32(p) * EZCTEST_XXH_PRIME64_1;
+    h = EZCTEST_XXH_ROTL64(h, 23) * EZCTEST_XXH_PRIME64_2 +
+        EZCTEST_XXH_PRIME64_3;
+    p += 4;
+    remain -= 4;
+  }
+  while (remain > 0) {
+    h ^= (ezctest_u64)(*p) * EZCTEST_XXH_PRIME64_5;
+    h = EZCTEST_XXH_ROTL64(h, 11) * EZCTEST_XXH_PRIME64_1;
+    p++;
+    remain--;
+  }
+
+  /* 雪崩 */
+  h ^= h >> 33;
+  h *= EZCTEST_XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= EZCTEST_XXH_PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+ezctest_u64 ezctest_xxh64(const void *data, size_t size, ezctest_u64 seed) {
+  ezctest_xxh64_state_t state;
+  ezctest_xxh64_reset(&state, seed);
+  ezctest_xxh64_update(&state, data, size);
+  return ezctest_xxh64_digest(&state);
+}
+
+/**
+ * @brief 解析十六进制哈希字符串
+ * @return 成功返回1，格式错误返回0
+ */
+static int ezctest_parse_hex64(const char *hex, ezctest_u64 *out) {
+  ezctest_u64 v = 0;
+  int digits = 0;
+
+  if (hex == NULL) {
+    return 0;
+  }
+  while (*hex == ' ' || *hex == '\t') {
+    hex++;
+  }
+  if (hex[0] == '0' && (hex[1] == 'x' || hex[1] == 'X')) {
+    hex += 2;
+  }
+  for (; *hex; hex++) {
+    int d;
+    if (*hex >= '0' && *hex <= '9') {
+      d = *hex - '0';
+    } else if (*hex >= 'a' && *hex <= 'f') {
+      d = *hex - 'a' + 10;
+    } else if (*hex >= 'A' && *hex <= 'F') {
+      d = *hex - 'A' + 10;
+    } else if (*hex == ' ' || *hex == '\t' || *hex == '\r' || *hex == '\n') {
+      break;
+    } else {
+      return 0;
+    }
+    if (++digits > 16) {
+      return 0;
+    }
+    v = (v << 4) | (ezctest_u64)d;
+  }
+  *out = v;
+  return digits > 0;
+}
+
+/* 以16位十六进制格式化（避免使用 C++98 不支持的 %llx） */
+static void ezctest_format_hex64(ezctest_u64 v, char out[17]) {
+  snprintf(out, 17, "%08lx%08lx", (unsigned long)(v >> 32),
+           (unsigned long)(v & 0xFFFFFFFFu));
+}
+
+int ezctest_hash_check(const char *expr, const void *data, size_t size,
+                       const char *hex, char *buf, size_t bufsize) {
+  ezctest_u64 expected;
+  ezctest_u64 actual;
+  char actual_hex[17];
+
+  actual = ezctest_xxh64(data, size, 0);
+  ezctest_format_hex64(actual, actual_hex);
+
+  if (!ezctest_parse_hex64(hex, &expected)) {
+    snprintf(buf, bufsize,
+             "Expected: XXH64(%s) == \"%s\"\n  Actual: invalid expected hash "
+             "(actual XXH64 of %lu bytes is %s)",
+             expr, hex ? hex : "(null)", (unsigned long)size, actual_hex);
+    return 0;
+  }
+  if (actual != expected) {
+    snprintf(buf, bufsize,
+             "Expected: XXH64(%s) == \"%s\"\n  Actual: %s (%lu bytes)\n"
+             "  Update the golden value to \"%s\" if the change is intended",
+             expr, hex, actual_hex, (unsigned long)size, actual_hex);
+    return 0;
+  }
+  return 1;
+}
+
+int ezctest_file_hash_check(const char *path, const char *hex, char *buf,
+                            size_t bufsize) {
+  ezctest_xxh64_state_t state;
+  ezctest_file_reader_t reader;
+  ezctest_u64 expected;
+  ezctest_u64 actual;
+  char actual_hex[17];
+  const unsigned char *data;
+  size_t n;
+
+  if (!ezctest_file_reader_open(&reader, path)) {
+    snprintf(buf, bufsize, "Expected: XXH64(file \"%s\") == \"%s\"\n"
+             "  Actual: cannot open file", path, hex ? hex : "(null)");
+    return 0;
+  }
+
+  ezctest_xxh64_reset(&state, 0);
+  while ((n = ezctest_file_reader_next(&reader, &data)) > 0) {
+    ezctest_xxh64_update(&state, data, n);
+  }
+  if (reader.error) {
+    ezctest_file_reader_close(&reader);
+    snprintf(buf, bufsize, "Expected: XXH64(file \"%s\") == \"%s\"\n"
+             "  Actual: read error", path, hex ? hex : "(null)");
+    return 0;
+  }
+  ezctest_file_reader_close(&reader);
+
+  actual = ezctest_xxh64_digest(&state);
+  ezctest_format_hex64(actual, actual_hex);
+
+  if (!ezctest_parse_hex64(hex, &expected)) {
+    snprintf(buf, bufsize,
+             "Expected: XXH64(file \"%s\") == \"%s\"\n  Actual: invalid "
+             "expected hash (actual XXH64 of %lu bytes is %s)",
+             path, hex ? hex : "(null)", (unsigned long)state.total_len,
+             actual_hex);
+    return 0;
+  }
+  if (actual != expected) {
+    snprintf(buf, bufsize,
+             "Expected: XXH64(file \"%s\") == \"%s\"\n  Actual: %s (%lu "
+             "bytes)\n  Update the golden value to \"%s\" if the change is "
+             "intended",
+             path, hex, actual_hex, (unsigned long)state.total_len,
+             actual_hex);
+    return 0;
+  }
+  return 1;
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 文件与黄金快照比较断言
+ * ========================================================================== */
+
+/**
+ * @brief 检查两个文件的内容是否逐字节相同
+ * @param actual_path 实际输出文件路径
+ * @param golden_path 黄金（期望）文件路径
+ * @param buf 失败消息缓冲区
+ * @param bufsize 缓冲区大小
+ * @return 相同返回1，否则返回0并在 buf 中写入首个差异的偏移和行列号
+ * @note 指定 --ezctest_update_golden 时，内容不同（或黄金文件不存在）
+ *       会用实际输出原子地重写黄金文件并返回1
+ */
+EZCTEST_API int ezctest_file_eq_check(const char *actual_path,
+                                      const char *golden_path, char *buf,
+                                      size_t bufsize);
+
+/**
+ * @brief 检查内存块是否与黄金文件的内容逐字节相同
+ * @param expr 数据表达式文本（用于失败消息）
+ * @param data 数据指针
+ * @param size 数据字节数
+ * @param golden_path 黄金文件路径
+ * @return 相同返回1，否则返回0并在 buf 中写入失败消息
+ */
+EZCTEST_API int ezctest_golden_check(const char *expr, const void *data,
+                                     size_t size, const char *golden_path,
+                                     char *buf, size_t bufsize);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+/* 比较数据源：内存块或文件 */
+typedef struct {
+  const char *path;              /* 文件路径（内存源为NULL） */
+  const unsigned char *mem;      /* 内存数据 */
+  size_t mem_size;               /* 内存数据字节数 */
+  int mem_consumed;              /* 内存数据是否已取出 */
+  ezctest_file_reader_t reader;  /* 文件读取器 */
+} ezctest_golden_source_t;
+
+static int ezctest_golden_source_open(ezctest_golden_source_t *src) {
+  src->mem_consumed = 0;
+  if (src->path == NULL) {
+    return 1;
+  }
+  return ezctest_file_reader_open(&src->reader, src->path);
+}
+
+static size_t ezctest_golden_source_next(ezctest_golden_source_t *src,
+                                         const unsigned char **data) {
+  if (src->path != NULL) {
+    return ezctest_file_reader_next(&src->reader, data);
+  }
+  *data = src->mem;
+  if (src->mem_consumed) {
+    return 0;
+  }
+  src->mem_consumed = 1;
+  return src->mem_size;
+}
+
+static int ezctest_golden_source_error(const ezctest_golden_source_t *src) {
+  return src->path != NULL && src->reader.error;
+}
+
+static ezctest_u64 ezctest_golden_source_size(
+    const ezctest_golden_source_t *src) {
+  return src->path != NULL ? src->reader.size : (ezctest_u64)src->mem_size;
+}
+
+static void ezctest_golden_source_close(ezctest_golden_source_t *src) {
+  if (src->path != NULL) {
+    ezctest_file_reader_close(&src->reader);
+  }
+}
+
+/* 十进制格式化64位无符号数（避免使用 C++98 不支持的 %llu） */
+static void ezctest_format_u64(ezctest_u64 v, char out[21]) {
+  char tmp[21];
+  int n = 0;
+  int i;
+
+  do {
+    tmp[n++] = (char)('0' + (int)(v % 10));
+    v /= 10;
+  } while (v != 0);
+  for (i = 0; i < n; i++) {
+    out[i] = tmp[n - 1 - i];
+  }
+  out[n] = '\0';
+}
+
+/**
+ * @brief 逐窗口比较两个已打开的数据源
+ * @param diff_offset 输出：首个差异的字节偏移
+ * @param byte_a/byte_b 输出：差异处的字节，-1 表示该数据源已结束
+ * @return 相同返回1，不同返回0，读取错误返回-1
+ */
+static int ezctest_golden_compare(ezctest_golden_source_t *a,
+                                  ezctest_golden_source_t *b,
+                                  ezctest_u64 *diff_offset, int *byte_a,
+                                  int *byte_b) {
+  const unsigned char *pa = NULL;
+  const unsigned char *pb = NULL;
+  size_t la = 0;
+  size_t lb = 0;
+  ezctest_u64 pos = 0;
+
+  for (;;) {
+    size_t n;
+    size_t same;
+
+    /* 当前窗口用完才取下一个，取下一个窗口会解除上一个映射 */
+    if (la == 0) {
+      la = ezctest_golden_source_next(a, &pa);
+    }
+    if (lb == 0) {
+      lb = ezctest_golden_source_next(b, &pb);
+    }
+    if (ezctest_golden_source_error(a) || ezctest_golden_source_error(b)) {
+      return -1;
+    }
+    if (la == 0 || lb == 0) {
+      if (la == 0 && lb == 0) {
+        return 1;
+      }
+      *diff_offset = pos;
+      *byte_a = la > 0 ? pa[0] : -1;
+      *byte_b = lb > 0 ? pb[0] : -1;
+      return 0;
+    }
+
+    n = la < lb ? la : lb;
+    same = ezctest_diff_common_prefix((const char *)pa, (const char *)pb, n);
+    if (same < n) {
+      *diff_offset = pos + same;
+      *byte_a = pa[same];
+      *byte_b = pb[same];
+      return 0;
+    }
+    pos += n;
+    pa += n;
+    pb += n;
+    la -= n;
+    lb -= n;
+  }
+}
+
+/**
+ * @brief 计算偏移所在的行号和列号（均从1开始）
+ * @note 只在失败时调用，重新扫描 [0, offset) 统计换行符
+ */
+static void ezctest_golden_locate(ezctest_golden_source_t *src,
+                                  ezctest_u64 offset, ezctest_u64 *line,
+                                  ezctest_u64 *column) {
+  ezctest_u64 pos = 0;
+  ezctest_u64 line_start = 0;
+  const unsigned char *data;
+  size_t n;
+
+  *line = 1;
+  if (ezctest_golden_source_open(src)) {
+    while (pos < offset && (n = ezctest_golden_source_next(src, &data)) > 0) {
+      const unsigned char *p = data;
+      const unsigned char *end;
+
+      if ((ezctest_u64)n > offset - pos) {
+        n = (size_t)(offset - pos);
+      }
+      end = data + n;
+      while (p < end &&
+             (p = (const unsigned char *)memchr(p, '\n', (size_t)(end - p))) !=
+                 NULL) {
+        p++;
+        (*line)++;
+        line_start = pos + (ezctest_u64)(p - data);
+      }
+      pos += n;
+    }
+    ezctest_golden_source_close(src);
+  }
+  *column = offset - line_start + 1;
+}
+
+/* 以 "0x41 'A'" 形式描述一个字节 */
+static void ezctest_golden_describe_byte(int byte, char out[16]) {
+  if (byte >= 0x20 && byte < 0x7F && byte != '\'') {
+    snprintf(out, 16, "0x%02X '%c'", byte, byte);
+  } else if (byte == '\n') {
+    snprintf(out, 16, "0x0A '\\n'");
+  } else if (byte == '\r') {
+    snprintf(out, 16, "0x0D '\\r'");
+  } else {
+    snprintf(out, 16, "0x%02X", byte);
+  }
+}
+
+/**
+ * @brief 用数据源内容原子地重写黄金文件
+ * @details 先写入同目录下的临时文件并刷盘，再用 rename（Windows 下为
+ *          MoveFileEx）替换目标，中途失败不会留下写了一半的黄金文件。
+ * @return 成功返回1
+ */
+static int ezctest_golden_write(ezctest_golden_source_t *src,
+                                const char *golden_path) {
+  char tmp_path[1024];
+  const unsigned char *data;
+  size_t n;
+  FILE *fp;
+  int ok = 1;
+
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.ezctest_tmp", golden_path) >=
+      (int)sizeof(tmp_path)) {
+    return 0;
+  }
+  if (!ezctest_golden_source_open(src)) {
+    return 0;
+  }
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+  if (fopen_s(&fp, tmp_path, "wb") != 0) {
+    fp = NULL;
+  }
+#else
+  fp = fopen(tmp_path, "wb");
+#endif
+  if (fp == NULL) {
+    ezctest_golden_source_close(src);
+    return 0;
+  }
+  while (ok && (n = ezctest_golden_source_next(src, &data)) > 0) {
+    ok = fwrite(data, 1, n, fp) == n;
+  }
+  if (ezctest_golden_source_error(src) || fflush(fp) != 0) {
+    ok = 0;
+  }
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  if (ok && _commit(_fileno(fp)) != 0) {
+    ok = 0;
+  }
+#elif defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  if (ok && fsync(fileno(fp)) != 0) {
+    ok = 0;
+  }
+#endif
+  if (fclose(fp) != 0) {
+    ok = 0;
+  }
+  ezctest_golden_source_close(src);
+
+  if (ok) {
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+    ok = MoveFileExA(tmp_path, golden_path,
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#elif defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+    ok = rename(tmp_path, golden_path) == 0;
+#else
+    /* 标准C的rename不保证覆盖已存在的文件 */
+    remove(golden_path);
+    ok = rename(tmp_path, golden_path) == 0;
+#endif
+  }
+  if (!ok) {
+    remove(tmp_path);
+  }
+  return ok;
+}
+
+/**
+ * @brief 文件/内存块与黄金文件比较的公共实现
+ * @param desc 实际数据的描述（用于失败消息）
+ */
+static int ezctest_golden_check_source(ezctest_golden_source_t *actual,
+                                       const char *desc,
+                                       const char *golden_path, char *buf,
+                                       size_t bufsize) {
+  ezctest_golden_source_t golden;
+  ezctest_u64 offset = 0;
+  ezctest_u64 line;
+  ezctest_u64 column;
+  int byte_a = -1;
+  int byte_b = -1;
+  int result;
+  char offset_str[21];
+  char line_str[21];
+  char column_str[21];
+
+  memset(&golden, 0, sizeof(golden));
+  golden.path = golden_path;
+
+  if (!ezctest_golden_source_open(actual)) {
+    snprintf(buf, bufsize, "Expected: %s == golden \"%s\"\n"
+             "  Actual: cannot open actual file", desc, golden_path);
+    return 0;
+  }
+  if (!ezctest_golden_source_open(&golden)) {
+    ezctest_golden_source_close(actual);
+    if (g_ezctest_config.update_golden) {
+      result = 0; /* 黄金文件不存在，直接创建 */
+    } else {
+      snprintf(buf, bufsize, "Expected: %s == golden \"%s\"\n"
+               "  Actual: cannot open golden file (run with "
+               "--ezctest_update_golden to create it)", desc, golden_path);
+      return 0;
+    }
+  } else {
+    result = ezctest_golden_compare(actual, &golden, &offset, &byte_a, &byte_b);
+    ezctest_golden_source_close(actual);
+    ezctest_golden_source_close(&golden);
+  }
+
+  if (result < 0) {
+    snprintf(buf, bufsize, "Expected: %s == golden \"%s\"\n"
+             "  Actual: read error", desc, golden_path);
+    return 0;
+  }
+  if (result == 1) {
+    return 1;
+  }
+
+  if (g_ezctest_config.update_golden) {
+    if (!ezctest_golden_write(actual, golden_path)) {
+      snprintf(buf, bufsize, "Expected: %s == golden \"%s\"\n"
+               "  Actual: cannot update golden file", desc, golden_path);
+      return 0;
+    }
+    ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "[ UPDATED  ] ");
+    printf("%s\n", golden_path);
+    return 1;
+  }
+
+  ezctest_golden_locate(actual->path != NULL ? &golden : actual, offset, &line,
+                        &column);
+  ezctest_format_u64(offset, offset_str);
+  ezctest_format_u64(line, line_str);
+  ezctest_format_u64(column, column_str);
+
+  if (byte_a >= 0 && byte_b >= 0) {
+    char desc_a[16];
+    char desc_b[16];
+    ezctest_golden_describe_byte(byte_a, desc_a);
+    ezctest_golden_describe_byte(byte_b, desc_b);
+    snprintf(buf, bufsize,
+             "Expected: %s == golden \"%s\"\n  Actual: first difference at "
+             "byte %s (line %s, column %s): %s vs golden %s\n  Run with "
+             "--ezctest_update_golden to accept the new output",
+             desc, golden_path, offset_str, line_str, column_str, desc_a,
+             desc_b);
+  } else {
+    char size_str[21];
+    ezctest_format_u64(byte_a < 0 ? ezctest_golden_source_size(&golden)
+                                  : ezctest_golden_source_size(actual),
+                       size_str);
+    snprintf(buf, bufsize,
+             "Expected: %s == golden \"%s\"\n  Actual: %s ends at byte %s "
+             "(line %s, column %s) while %s has %s bytes\n  Run with "
+             "--ezctest_update_golden to accept the new output",
+             desc, golden_path, byte_a < 0 ? "actual" : "golden", offset_str,
+             line_str, column_str, byte_a < 0 ? "golden" : "actual",
+             size_str);
+  }
+  return 0;
+}
+
+int ezctest_file_eq_check(const char *actual_path, const char *golden_path,
+                          char *buf, size_t bufsize) {
+  ezctest_golden_source_t actual;
+  char desc[EZCTEST_MAX_MESSAGE_LENGTH / 4];
+
+  memset(&actual, 0, sizeof(actual));
+  actual.path = actual_path;
+  snprintf(desc, sizeof(desc), "file \"%s\"", actual_path);
+  return ezctest_golden_check_source(&actual, desc, golden_path, buf, bufsize);
+}
+
+int ezctest_golden_check(const char *expr, const void *data, size_t size,
+                         const char *golden_path, char *buf, size_t bufsize) {
+  ezctest_golden_source_t actual;
+
+  memset(&actual, 0, sizeof(actual));
+  actual.mem = (const unsigned char *)data;
+  actual.mem_size = size;
+  return ezctest_golden_check_source(&actual, expr, golden_path, buf, bufsize);
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 高精度计时与性能预算断言
+ * ========================================================================== */
+
+/**
+ * @brief 单调递增的高精度时钟（纳秒）
+ * @note Linux/Unix 使用 CLOCK_MONOTONIC，Windows 使用 QueryPerformanceCounter，
+ *       定义了 EZCTEST_USER_NOW_NS() 时使用用户时钟（STM32 等裸机平台），
+ *       其他平台退化为 clock()
+ */
+EZCTEST_API ezctest_u64 ezctest_now_ns(void);
+
+/**
+ * @brief 当前进程已消耗的CPU时间（纳秒，用户态+内核态）
+ */
+EZCTEST_API ezctest_u64 ezctest_cpu_time_ns(void);
+
+/**
+ * @brief 已结束的隔离子进程累计消耗的CPU时间（纳秒）
+ * @note POSIX 使用 getrusage(RUSAGE_CHILDREN)，只包含已 waitpid 的子进程；
+ *       Windows 由隔离机制在子进程结束后调用 ezctest_children_cpu_add 累加
+ */
+EZCTEST_API ezctest_u64 ezctest_children_cpu_time_ns(void);
+
+/**
+ * @brief 累加一个已结束子进程的CPU时间（纳秒）
+ */
+EZCTEST_API void ezctest_children_cpu_add(ezctest_u64 ns);
+
+/**
+ * @brief 已统计到的内存分配次数
+ * @note 定义 EZCTEST_ALLOC_HOOKS 后，glibc 下拦截 malloc/calloc/realloc/free
+ *       （C++ 还有 operator new/delete），MSVC Debug 下使用 _CrtSetAllocHook；
+ *       自定义分配器可调用 ezctest_count_allocation() 自行上报
+ */
+EZCTEST_API unsigned long ezctest_alloc_count(void);
+
+/**
+ * @brief 向分配计数器上报一次分配（供自定义分配器/内存池使用）
+ */
+EZCTEST_API void ezctest_count_allocation(void);
+
+/**
+ * @brief 一段代码的内存分配统计
+ */
+typedef struct {
+  unsigned long allocs; /* 分配次数 */
+  ezctest_u64 bytes;    /* 申请的字节数 */
+  ezctest_u64 peak;     /* 存活字节数相对起点的峰值增量 */
+} ezctest_alloc_stats_t;
+
+/**
+ * @brief 分配统计是否可用（定义了 EZCTEST_ALLOC_HOOKS 且平台支持拦截）
+ */
+EZCTEST_API int ezctest_alloc_tracking(void);
+
+/**
+ * @brief 开始统计：记下当前读数，并把峰值重置为当前存活字节数
+ * @param mark 输出起点读数，传给 ezctest_alloc_end
+ * @note 计数器是全进程的，其他线程的分配也会计入
+ */
+EZCTEST_API void ezctest_alloc_begin(ezctest_alloc_stats_t *mark);
+
+/**
+ * @brief 结束统计：把 ezctest_alloc_begin 记下的起点换算为区间内的统计
+ */
+EZCTEST_API void ezctest_alloc_end(ezctest_alloc_stats_t *stats);
+
+/**
+ * @brief 泄漏检测是否可用（glibc 下定义了 EZCTEST_ALLOC_HOOKS）
+ */
+EZCTEST_API int ezctest_leak_available(void);
+
+/**
+ * @brief 开始记录此后分配、尚未释放的堆块（连同分配处的调用栈）
+ */
+EZCTEST_API void ezctest_leak_begin(void);
+
+/**
+ * @brief 停止记录，报告仍未释放的块（按调用栈归并，列出大小、个数和调用栈）
+ * @return 泄漏的块数；有泄漏时当前测试标记为失败
+ * @note 调用栈由 backtrace_symbols 解析，链接时加 -rdynamic 可显示函数名，
+ *       否则可用 addr2line 换算偏移
+ */
+EZCTEST_API unsigned long ezctest_leak_end(void);
+
+/* 性能预算的测量类型 */
+#define EZCTEST_PERF_WALL 0   /* 墙钟时间（微秒） */
+#define EZCTEST_PERF_CPU 1    /* CPU时间（微秒） */
+#define EZCTEST_PERF_ALLOCS 2 /* 分配次数 */
+
+/**
+ * @brief 开始一个性能预算作用域（由 EXPECT_DURATION_LT_US 等宏调用）
+ * @param kind 测量类型 EZCTEST_PERF_*
+ * @param budget 预算（时间为微秒，分配为次数）
+ * @param runs 最多运行次数，取最好的一次（best of K）
+ */
+EZCTEST_API void ezctest_perf_scope_begin(int kind, double budget, int runs,
+                                          int is_fatal, const char *file,
+                                          int line, const char *expr);
+
+/**
+ * @brief 推进性能预算作用域
+ * @return 需要（再）执行代码块返回1；结束（已报告结果）返回0
+ */
+EZCTEST_API int ezctest_perf_scope_next(void);
+
+/**
+ * @brief 最近结束的作用域是否失败（供 ASSERT_* 版本决定是否返回）
+ */
+EZCTEST_API int ezctest_perf_scope_failed(void);
+
+/**
+ * @brief 丢弃未正常结束的作用域（测试开始时调用）
+ */
+EZCTEST_API void ezctest_perf_reset(void);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+/* ---- 分配计数 ---- */
+
+static unsigned long g_ezctest_alloc_counter = 0;
+static int g_ezctest_alloc_manual = 0; /* 是否有自定义分配器上报 */
+static ezctest_u64 g_ezctest_alloc_bytes = 0; /* 累计申请字节数 */
+static ezctest_u64 g_ezctest_alloc_live = 0;  /* 当前存活字节数 */
+static ezctest_u64 g_ezctest_alloc_peak = 0;  /* 存活字节数峰值 */
+
+#if defined(EZCTEST_ALLOC_HOOKS) && defined(__GLIBC__) &&                      \
+    !defined(EZCTEST_STM32_MODE)
+#define EZCTEST_ALLOC_COUNTER_AVAILABLE 1
+
+#define EZCTEST_LEAK_CHECK_AVAILABLE 1
+#include <execinfo.h> /* backtrace */
+#include <malloc.h>   /* malloc_usable_size */
+
+/* glibc 导出的原始分配函数，拦截后转发给它们 */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+/* C++ 中需要与 <stdlib.h> 的异常说明保持一致 */
+#if defined(__cplusplus) && defined(__THROW)
+#define EZCTEST_ALLOC_NOTHROW __THROW
+#else
+#define EZCTEST_ALLOC_NOTHROW
+#endif
+
+/* ---- 泄漏检测：记录窗口内分配、尚未释放的块 ---- */
+
+typedef struct {
+  void *ptr;   /* NULL 为空槽，&g_ezctest_leak_tombstone 为已删除 */
+  size_t size; /* 申请的字节数 */
+  int depth;   /* 调用栈层数 */
+  void *frames[EZCTEST_LEAK_BACKTRACE_DEPTH];
+} ezctest_leak_entry_t;
+
+static ezctest_leak_entry_t *g_ezctest_leak_table = NULL; /* 开放寻址表 */
+static size_t g_ezctest_leak_cap = 0;   /* 槽数（2 的幂） */
+static size_t g_ezctest_leak_used = 0;  /* 已占用槽数（含已删除） */
+static size_t g_ezctest_leak_live = 0;  /* 记录中的块数 */
+static int g_ezctest_leak_active = 0;   /* 是否记录新分配 */
+static int g_ezctest_leak_lock = 0;     /* 自旋锁 */
+static char g_ezctest_leak_tombstone;
+static __thread int g_ezctest_leak_busy; /* 防止 backtrace 内部分配重入 */
+
+static void ezctest_leak_lock(void) {
+  while (__sync_lock_test_and_set(&g_ezctest_leak_lock, 1)) {
+  }
+}
+
+static void ezctest_leak_unlock(void) {
+  __sync_lock_release(&g_ezctest_leak_lock);
+}
+
+static size_t ezctest_leak_slot(const void *ptr, size_t cap) {
+  size_t h = (size_t)ptr >> 4; /* malloc 返回的地址至少 16 字节对齐 */
+  h ^= h >> 15;
+  h *= 0x9E3779B1u;
+  return (h ^ (h >> 13)) & (cap - 1);
+}
+
+/* 扩容并丢弃已删除的槽（调用者持有锁）；表本身不经过拦截的分配函数 */
+static int ezctest_leak_grow(void) {
+  size_t cap = g_ezctest_leak_cap ? g_ezctest_leak_cap * 2 : 256;
+  ezctest_leak_entry_t *table;
+  size_t i;
+
+  table = (ezctest_leak_entry_t *)__libc_calloc(cap, sizeof(*table));
+  if (table == NULL) {
+    return 0;
+  }
+  for (i = 0; i < g_ezctest_leak_cap; i++) {
+    void *ptr = g_ezctest_leak_table[i].ptr;
+    if (ptr != NULL && ptr != (void *)&g_ezctest_leak_tombstone) {
+      size_t j = ezctest_leak_slot(ptr, cap);
+      while (table[j].ptr != NULL) {
+        j = (j + 1) & (cap - 1);
+      }
+      table[j] = g_ezctest_leak_table[i];
+    }
+  }
+  __libc_free(g_ezctest_leak_table);
+  g_ezctest_leak_table = table;
+  g_ezctest_leak_cap = cap;
+  g_ezctest_leak_used = g_ezctest_leak_live;
+  return 1;
+}
+
+/* 调用栈跳过的层数：本函数、ezctest_alloc_note 和拦截函数（均不内联） */
+#define EZCTEST_LEAK_SKIP_FRAMES 3
+
+static __attribute__((noinline)) void ezctest_leak_track(void *ptr,
+                                                         size_t size) {
+  void *frames[EZCTEST_LEAK_BACKTRACE_DEPTH + EZCTEST_LEAK_SKIP_FRAMES];
+  int depth;
+  size_t i;
+
+  if (ptr == NULL || g_ezctest_leak_busy) {
+    return;
+  }
+  g_ezctest_leak_busy = 1;
+  depth = backtrace(frames, EZCTEST_LEAK_BACKTRACE_DEPTH +
+                               EZCTEST_LEAK_SKIP_FRAMES);
+  depth -= EZCTEST_LEAK_SKIP_FRAMES;
+  g_ezctest_leak_busy = 0;
+
+  ezctest_leak_lock();
+  if ((g_ezctest_leak_used + 1) * 2 > g_ezctest_leak_cap &&
+      !ezctest_leak_grow()) {
+    ezctest_leak_unlock();
+    return;
+  }
+  i = ezctest_leak_slot(ptr, g_ezctest_leak_cap);
+  while (g_ezctest_leak_table[i].ptr != NULL &&
+         g_ezctest_leak_table[i].ptr != (void *)&g_ezctest_leak_tombstone) {
+    i = (i + 1) & (g_ezctest_leak_cap - 1);
+  }
+  if (g_ezctest_leak_table[i].ptr == NULL) {
+    g_ezctest_leak_used++;
+  }
+  g_ezctest_leak_table[i].ptr = ptr;
+  g_ezctest_leak_table[i].size = size;
+  g_ezctest_leak_table[i].depth = (depth > 0) ? depth : 0;
+  if (depth > 0) {
+    memcpy(g_ezctest_leak_table[i].frames, frames + EZCTEST_LEAK_SKIP_FRAMES,
+           sizeof(void *) * (size_t)depth);
+  }
+  g_ezctest_leak_live++;
+  ezctest_leak_unlock();
+}
+
+static void ezctest_leak_untrack(void *ptr) {
+  size_t i;
+
+  ezctest_leak_lock();
+  if (g_ezctest_leak_live > 0) {
+    i = ezctest_leak_slot(ptr, g_ezctest_leak_cap);
+    while (g_ezctest_leak_table[i].ptr != NULL) {
+      if (g_ezctest_leak_table[i].ptr == ptr) {
+        g_ezctest_leak_table[i].ptr = (void *)&g_ezctest_leak_tombstone;
+        g_ezctest_leak_live--;
+        break;
+      }
+      i = (i + 1) & (g_ezctest_leak_cap - 1);
+    }
+  }
+  ezctest_leak_unlock();
+}
+
+/* 计数器可能被多个线程同时更新，使用 GCC 原子内建函数 */
+static __attribute__((noinline)) void ezctest_alloc_note(void *ptr,
+                                                         size_t size) {
+  ezctest_u64 live;
+  ezctest_u64 peak;
+
+  __sync_fetch_and_add(&g_ezctest_alloc_counter, 1ul);
+  __sync_fetch_and_add(&g_ezctest_alloc_bytes, (ezctest_u64)size);
+  if (ptr == NULL) {
+    return;
+  }
+  if (g_ezctest_leak_active) {
+    ezctest_leak_track(ptr, size);
+  }
+  live = __sync_add_and_fetch(&g_ezctest_alloc_live,
+                              (ezctest_u64)malloc_usable_size(ptr));
+  peak = g_ezctest_alloc_peak;
+  while (live > peak) {
+    ezctest_u64 seen =
+        __sync_val_compare_and_swap(&g_ezctest_alloc_peak, peak, live);
+    if (seen == peak) {
+      break;
+    }
+    peak = seen;
+  }
+}
+
+/* 释放时按块的实际大小扣减；memalign 等未拦截的块可能让差值为负，截到0 */
+static void ezctest_alloc_forget(void *ptr) {
+  ezctest_u64 size;
+  ezctest_u64 live;
+
+  if (ptr == NULL) {
+    return;
+  }
+  if (g_ezctest_leak_live > 0) {
+    ezctest_leak_untrack(ptr);
+  }
+  size = (ezctest_u64)malloc_usable_size(ptr);
+  live = g_ezctest_alloc_live;
+  for (;;) {
+    ezctest_u64 next = (live > size) ? live - size : 0;
+    ezctest_u64 seen =
+        __sync_val_compare_and_swap(&g_ezctest_alloc_live, live, next);
+    if (seen == live) {
+      return;
+    }
+    live = seen;
+  }
+}
+
+void *malloc(size_t size) EZCTEST_ALLOC_NOTHROW {
+  void *ptr = __libc_malloc(size);
+  ezctest_alloc_note(ptr, size);
+  return ptr;
+}
+
+void *calloc(size_t count, size_t size) EZCTEST_ALLOC_NOTHROW {
+  void *ptr = __libc_calloc(count, size);
+  ezctest_alloc_note(ptr, count * size);
+  return ptr;
+}
+
+void *realloc(void *ptr, size_t size) EZCTEST_ALLOC_NOTHROW {
+  size_t old_size = (ptr != NULL) ? malloc_usable_size(ptr) : 0;
+  void *moved;
+
+  /* 先扣掉旧块：realloc 之后旧指针不能再访问 */
+  ezctest_alloc_forget(ptr);
+  moved = __libc_realloc(ptr, size);
+  if (moved == NULL && ptr != NULL && size != 0) {
+    /* 失败时旧块仍然有效，补回去 */
+    __sync_fetch_and_add(&g_ezctest_alloc_live, (ezctest_u64)old_size);
+  }
+  ezctest_alloc_note(moved, size);
+  return moved;
+}
+
+void free(void *ptr) EZCTEST_ALLOC_NOTHROW {
+  ezctest_alloc_forget(ptr);
+  __libc_free(ptr);
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+
+/* operator new/delete 的异常说明在 C++11 前后写法不同 */
+#if __cplusplus >= 201103L
+#define EZCTEST_NEW_THROWS
+#define EZCTEST_NEW_NOTHROW noexcept
+#else
+#define EZCTEST_NEW_THROWS throw(std::bad_alloc)
+#define EZCTEST_NEW_NOTHROW throw()
+#endif
+
+/* 与标准库默认实现一致：失败时调用 new_handler，没有则抛出 bad_alloc */
+static void *ezctest_operator_new(std::size_t size) {
+  void *ptr;
+
+  if (size == 0) {
+    size = 1;
+  }
+  while ((ptr = malloc(size)) == NULL) {
+    std::new_handler handler = std::set_new_handler(0);
+    std::set_new_handler(handler);
+    if (handler == 0) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+  return ptr;
+}
+
+static void *ezctest_operator_new_nothrow(std::size_t size) {
+  try {
+    return ezctest_operator_new(size);
+  } catch (...) {
+    return 0;
+  }
+}
+
+void *operator new(std::size_t size) EZCTEST_NEW_THROWS {
+  return ezctest_operator_new(size);
+}
+
+void *operator new[](std::size_t size) EZCTEST_NEW_THROWS {
+  return ezctest_operator_new(size);
+}
+
+void *operator new(std::size_t size,
+                   const std::nothrow_t &) EZCTEST_NEW_NOTHROW {
+  return ezctest_operator_new_nothrow(size);
+}
+
+void *operator new[](std::size_t size,
+                     const std::nothrow_t &) EZCTEST_NEW_NOTHROW {
+  return ezctest_operator_new_nothrow(size);
+}
+
+void operator delete(void *ptr) EZCTEST_NEW_NOTHROW { free(ptr); }
+
+void operator delete[](void *ptr) EZCTEST_NEW_NOTHROW { free(ptr); }
+
+void operator delete(void *ptr, const std::nothrow_t &) EZCTEST_NEW_NOTHROW {
+  free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) EZCTEST_NEW_NOTHROW {
+  free(ptr);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void *ptr, std::size_t) EZCTEST_NEW_NOTHROW { free(ptr); }
+
+void operator delete[](void *ptr, std::size_t) EZCTEST_NEW_NOTHROW {
+  free(ptr);
+}
+#endif
+
+extern "C" {
+#endif /* __cplusplus */
+
+#elif defined(EZCTEST_ALLOC_HOOKS) && defined(_MSC_VER) && defined(_DEBUG)
+#define EZCTEST_ALLOC_COUNTER_AVAILABLE 1
+#include <crtdbg.h>
+
+static _CRT_ALLOC_HOOK g_ezctest_prev_alloc_hook = NULL;
+static int g_ezctest_alloc_hook_installed = 0;
+
+/* 调试堆在持有堆锁时调用钩子，这里的更新不需要再加锁 */
+static int __cdecl ezctest_crt_alloc_hook(int alloc_type, void *user_data,
+                                          size_t size, int block_type,
+                                          long request,
+                                          const unsigned char *file,
+                                          int line) {
+  if ((alloc_type == _HOOK_REALLOC || alloc_type == _HOOK_FREE) &&
+      user_data != NULL && block_type != _CRT_BLOCK) {
+    ezctest_u64 old_size = (ezctest_u64)_msize_dbg(user_data, block_type);
+    g_ezctest_alloc_live =
+        (g_ezctest_alloc_live > old_size) ? g_ezctest_alloc_live - old_size
+                                          : 0;
+  }
+  if (alloc_type == _HOOK_ALLOC || alloc_type == _HOOK_REALLOC) {
+    g_ezctest_alloc_counter++;
+    g_ezctest_alloc_bytes += (ezctest_u64)size;
+    if (block_type != _CRT_BLOCK) {
+      g_ezctest_alloc_live += (ezctest_u64)size;
+      if (g_ezctest_alloc_live > g_ezctest_alloc_peak) {
+        g_ezctest_alloc_peak = g_ezctest_alloc_live;
+      }
+    }
+  }
+  if (g_ezctest_prev_alloc_hook != NULL) {
+    return g_ezctest_prev_alloc_hook(alloc_type, user_data, size, block_type,
+                                     request, file, line);
+  }
+  return 1;
+}
+#endif
+
+/* 钩子在首次需要时才安装，避免影响没用到分配统计的程序 */
+static void ezctest_alloc_install(void) {
+#if defined(EZCTEST_ALLOC_COUNTER_AVAILABLE) && defined(_MSC_VER)
+  if (!g_ezctest_alloc_hook_installed) {
+    g_ezctest_prev_alloc_hook = _CrtSetAllocHook(ezctest_crt_alloc_hook);
+    g_ezctest_alloc_hook_installed = 1;
+  }
+#endif
+}
+
+unsigned long ezctest_alloc_count(void) { return g_ezctest_alloc_counter; }
+
+void ezctest_count_allocation(void) {
+  g_ezctest_alloc_manual = 1;
+  g_ezctest_alloc_counter++;
+}
+
+int ezctest_alloc_tracking(void) {
+#if defined(EZCTEST_ALLOC_COUNTER_AVAILABLE)
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+void ezctest_alloc_begin(ezctest_alloc_stats_t *mark) {
+  ezctest_alloc_install();
+  mark->allocs = g_ezctest_alloc_counter;
+  mark->bytes = g_ezctest_alloc_bytes;
+  mark->peak = g_ezctest_alloc_live;
+  g_ezctest_alloc_peak = mark->peak;
+}
+
+void ezctest_alloc_end(ezctest_alloc_stats_t *stats) {
+  ezctest_u64 peak = g_ezctest_alloc_peak;
+
+  stats->allocs = g_ezctest_alloc_counter - stats->allocs;
+  stats->bytes = g_ezctest_alloc_bytes - stats->bytes;
+  stats->peak = (peak > stats->peak) ? peak - stats->peak : 0;
+}
+
+/* ---- 泄漏检测 ---- */
+
+#if defined(EZCTEST_LEAK_CHECK_AVAILABLE)
+
+int ezctest_leak_available(void) { return 1; }
+
+void ezctest_leak_begin(void) {
+  static int preloaded = 0;
+  ezctest_leak_entry_t *table;
+
+  if (!preloaded) {
+    /* backtrace 首次调用会加载 libgcc 并分配内存，提前在窗口外完成 */
+    void *frame;
+    backtrace(&frame, 1);
+    preloaded = 1;
+  }
+  ezctest_leak_lock();
+  table = g_ezctest_leak_table;
+  g_ezctest_leak_table = NULL;
+  g_ezctest_leak_cap = 0;
+  g_ezctest_leak_used = 0;
+  g_ezctest_leak_live = 0;
+  g_ezctest_leak_active = 1;
+  ezctest_leak_unlock();
+  __libc_free(table);
+}
+
+static int ezctest_leak_same_site(const ezctest_leak_entry_t *a,
+                                  const ezctest_leak_entry_t *b) {
+  return a->depth == b->depth &&
+         memcmp(a->frames, b->frames, sizeof(void *) * (size_t)a->depth) == 0;
+}
+
+unsigned long ezctest_leak_end(void) {
+  ezctest_leak_entry_t *table;
+  size_t cap;
+  size_t i;
+  size_t j;
+  unsigned long count = 0;
+  double bytes = 0.0;
+  int reports = 0;
+
+  /* 先把表摘下来，输出时的分配和其他线程的释放不再碰它 */
+  ezctest_leak_lock();
+  g_ezctest_leak_active = 0;
+  table = g_ezctest_leak_table;
+  cap = g_ezctest_leak_cap;
+  g_ezctest_leak_table = NULL;
+  g_ezctest_leak_cap = 0;
+  g_ezctest_leak_used = 0;
+  g_ezctest_leak_live = 0;
+  ezctest_leak_unlock();
+
+  for (i = 0; i < cap; i++) {
+    if (table[i].ptr != NULL &&
+        table[i].ptr != (void *)&g_ezctest_leak_tombstone) {
+      count++;
+      bytes += (double)table[i].size;
+    }
+  }
+  if (count == 0) {
+    __libc_free(table);
+    return 0;
+  }
+
+  g_ezctest_current_failed = 1;
+  printf("  Leak check: %.0f byte(s) in %lu allocation(s) not freed\n", bytes,
+         count);
+  /* 同一调用栈的块归并为一条，列出前 EZCTEST_LEAK_MAX_REPORTS 条 */
+  for (i = 0; i < cap && reports < EZCTEST_LEAK_MAX_REPORTS; i++) {
+    unsigned long site_count = 0;
+    double site_bytes = 0.0;
+    ezctest_leak_entry_t site;
+    char **symbols;
+    int k;
+
+    if (table[i].ptr == NULL ||
+        table[i].ptr == (void *)&g_ezctest_leak_tombstone) {
+      continue;
+    }
+    site = table[i];
+    for (j = i; j < cap; j++) {
+      if (table[j].ptr != NULL &&
+          table[j].ptr != (void *)&g_ezctest_leak_tombstone &&
+          ezctest_leak_same_site(&table[j], &site)) {
+        site_count++;
+        site_bytes += (double)table[j].size;
+        table[j].ptr = (void *)&g_ezctest_leak_tombstone;
+      }
+    }
+    reports++;
+    printf("  Leaked %.0f byte(s) in %lu allocation(s) at:\n", site_bytes,
+           site_count);
+    symbols = backtrace_symbols(site.frames, site.depth);
+    for (k = 0; k < site.depth; k++) {
+      if (symbols != NULL) {
+        printf("    #%d %s\n", k, symbols[k]);
+      } else {
+        printf("    #%d %p\n", k, site.frames[k]);
+      }
+    }
+    free(symbols);
+  }
+  for (; i < cap; i++) {
+    if (table[i].ptr != NULL &&
+        table[i].ptr != (void *)&g_ezctest_leak_tombstone) {
+      printf("  (more leak sites not shown)\n");
+      break;
+    }
+  }
+  __libc_free(table);
+  return count;
+}
+
+#else
+
+int ezctest_leak_available(void) { return 0; }
+
+void ezctest_leak_begin(void) {}
+
+unsigned long ezctest_leak_end(void) { return 0; }
+
+#endif /* EZCTEST_LEAK_CHECK_AVAILABLE */
+
+/* ---- 计时 ---- */
+
+ezctest_u64 ezctest_now_ns(void) {
+#if defined(EZCTEST_USER_NOW_NS)
+  return (ezctest_u64)(EZCTEST_USER_NOW_NS());
+#elif defined(EZCTEST_PLATFORM_WINDOWS)
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER now;
+  ezctest_u64 ticks;
+  ezctest_u64 f;
+
+  if (freq.QuadPart == 0) {
+    QueryPerformanceFrequency(&freq);
+  }
+  QueryPerformanceCounter(&now);
+  ticks = (ezctest_u64)now.QuadPart;
+  f = (ezctest_u64)freq.QuadPart;
+  /* 分成整秒和余数两部分换算，避免乘法溢出 */
+  return (ticks / f) * 1000000000u + (ticks % f) * 1000000000u / f;
+#elif defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ezctest_u64)ts.tv_sec * 1000000000u + (ezctest_u64)ts.tv_nsec;
+#else
+  return (ezctest_u64)clock() * (1000000000u / CLOCKS_PER_SEC);
+#endif
+}
+
+ezctest_u64 ezctest_cpu_time_ns(void) {
+#if defined(EZCTEST_USER_CPU_TIME_NS)
+  return (ezctest_u64)(EZCTEST_USER_CPU_TIME_NS());
+#elif defined(EZCTEST_STM32_MODE)
+  return ezctest_now_ns(); /* 裸机单任务：CPU时间即墙钟时间 */
+#elif defined(EZCTEST_PLATFORM_WINDOWS)
+  FILETIME created, exited, kernel, user;
+  ezctest_u64 k;
+  ezctest_u64 u;
+
+  if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel,
+                       &user)) {
+    return 0;
+  }
+  k = ((ezctest_u64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+  u = ((ezctest_u64)user.dwHighDateTime << 32) | user.dwLowDateTime;
+  return (k + u) * 100u; /* FILETIME 单位为100纳秒 */
+#elif defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (ezctest_u64)ts.tv_sec * 1000000000u + (ezctest_u64)ts.tv_nsec;
+#else
+  return (ezctest_u64)clock() * (1000000000u / CLOCKS_PER_SEC);
+#endif
+}
+
+static ezctest_u64 g_ezctest_children_cpu_ns = 0;
+
+ezctest_u64 ezctest_children_cpu_time_ns(void) {
+#if defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  struct rusage ru;
+
+  if (getrusage(RUSAGE_CHILDREN, &ru) == 0) {
+    return g_ezctest_children_cpu_ns +
+           (ezctest_u64)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) *
+               1000000000u +
+           (ezctest_u64)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000u;
+  }
+#endif
+  return g_ezctest_children_cpu_ns;
+}
+
+void ezctest_children_cpu_add(ezctest_u64 ns) {
+  g_ezctest_children_cpu_ns += ns;
+}
+
+/* ---- 预算作用域 ---- */
+
+typedef struct {
+  int kind;            /* 测量类型 */
+  double budget;       /* 预算 */
+  int runs_left;       /* 剩余运行次数 */
+  int runs;            /* 已运行次数 */
+  int running;         /* 代码块是否正在执行 */
+  double best;         /* 最好的一次测量值 */
+  ezctest_u64 start;   /* 本次运行的起始读数 */
+  int is_fatal;        /* 是否为 ASSERT_* */
+  const char *file;    /* 所在文件 */
+  int line;            /* 所在行 */
+  const char *expr;    /* 预算表达式文本 */
+} ezctest_perf_scope_t;
+
+static ezctest_perf_scope_t g_ezctest_perf_scopes[EZCTEST_PERF_MAX_DEPTH];
+static int g_ezctest_perf_depth = 0;
+static int g_ezctest_perf_overflow = 0; /* 超出嵌套深度、未执行的作用域数 */
+static int g_ezctest_perf_failed = 0;
+
+static ezctest_u64 ezctest_perf_read(int kind) {
+  switch (kind) {
+  case EZCTEST_PERF_CPU:
+    return ezctest_cpu_time_ns();
+  case EZCTEST_PERF_ALLOCS:
+    return (ezctest_u64)g_ezctest_alloc_counter;
+  default:
+    return ezctest_now_ns();
+  }
+}
+
+void ezctest_perf_scope_begin(int kind, double budget, int runs, int is_fatal,
+                              const char *file, int line, const char *expr) {
+  ezctest_perf_scope_t *scope;
+
+  if (g_ezctest_perf_depth >= EZCTEST_PERF_MAX_DEPTH) {
+    g_ezctest_perf_overflow++;
+    ezctest_assertion_failed(file, line, is_fatal,
+                             "Performance budget scopes nested deeper than "
+                             "%d (EZCTEST_PERF_MAX_DEPTH); block skipped",
+                             EZCTEST_PERF_MAX_DEPTH);
+    return;
+  }
+  if (kind == EZCTEST_PERF_ALLOCS) {
+    ezctest_alloc_install();
+  }
+  scope = &g_ezctest_perf_scopes[g_ezctest_perf_depth++];
+  scope->kind = kind;
+  scope->budget = budget;
+  scope->runs_left = runs < 1 ? 1 : runs;
+  scope->runs = 0;
+  scope->running = 0;
+  scope->best = 0.0;
+  scope->start = 0;
+  scope->is_fatal = is_fatal;
+  scope->file = file;
+  scope->line = line;
+  scope->expr = expr;
+}
+
+/* 测量值是否在预算内：时间要求严格小于，分配次数允许等于 */
+static int ezctest_perf_within(const ezctest_perf_scope_t *scope,
+                               double value) {
+  return scope->kind == EZCTEST_PERF_ALLOCS ? value <= scope->budget
+                                            : value < scope->budget;
+}
+
+static void ezctest_perf_report(const ezctest_perf_scope_t *scope) {
+  char runs_note[48];
+
+#if !defined(EZCTEST_ALLOC_COUNTER_AVAILABLE)
+  if (scope->kind == EZCTEST_PERF_ALLOCS && !g_ezctest_alloc_manual) {
+    /* 没有分配计数器时无法判断，只提示而不让测试失败 */
+    ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "%s:%d: Note: ", scope->file,
+                           scope->line);
+    printf("allocation counting unavailable (define EZCTEST_ALLOC_HOOKS), "
+           "budget %s not checked\n", scope->expr);
+    g_ezctest_perf_failed = 0;
+    ezctest_assertion_passed();
+    return;
+  }
+#endif
+
+  g_ezctest_perf_failed = !ezctest_perf_within(scope, scope->best);
+  if (!g_ezctest_perf_failed) {
+    ezctest_assertion_passed();
+    return;
+  }
+
+  runs_note[0] = '\0';
+  if (scope->runs > 1) {
+    snprintf(runs_note, sizeof(runs_note), " (best of %d runs)", scope->runs);
+  }
+  switch (scope->kind) {
+  case EZCTEST_PERF_ALLOCS:
+    ezctest_assertion_failed(scope->file, scope->line, scope->is_fatal,
+                             "Expected: allocations in block <= %s (%.0f)\n"
+                             "  Actual: %.0f allocations%s",
+                             scope->expr, scope->budget, scope->best,
+                             runs_note);
+    return;
+  case EZCTEST_PERF_CPU:
+    ezctest_assertion_failed(scope->file, scope->line, scope->is_fatal,
+                             "Expected: CPU time of block < %s us (%.3f)\n"
+                             "  Actual: %.3f us%s",
+                             scope->expr, scope->budget, scope->best,
+                             runs_note);
+    return;
+  default:
+    ezctest_assertion_failed(scope->file, scope->line, scope->is_fatal,
+                             "Expected: duration of block < %s us (%.3f)\n"
+                             "  Actual: %.3f us%s",
+                             scope->expr, scope->budget, scope->best,
+                             runs_note);
+    return;
+  }
+}
+
+int ezctest_perf_scope_next(void) {
+  ezctest_perf_scope_t *scope;
+
+  if (g_ezctest_perf_overflow > 0) {
+    g_ezctest_perf_overflow--;
+    g_ezctest_perf_failed = 1;
+    return 0;
+  }
+  if (g_ezctest_perf_depth == 0) {
+    return 0;
+  }
+  scope = &g_ezctest_perf_scopes[g_ezctest_perf_depth - 1];
+
+  if (scope->running) {
+    ezctest_u64 end = ezctest_perf_read(scope->kind);
+    double value = (double)(end - scope->start);
+
+    if (scope->kind != EZCTEST_PERF_ALLOCS) {
+      value /= 1000.0; /* 纳秒 -> 微秒 */
+    }
+    if (scope->runs == 0 || value < scope->best) {
+      scope->best = value;
+    }
+    scope->runs++;
+    scope->runs_left--;
+    scope->running = 0;
+
+    /* 已经满足预算时不必再跑剩余的轮次 */
+    if (scope->runs_left <= 0 || ezctest_perf_within(scope, scope->best)) {
+      g_ezctest_perf_depth--;
+      ezctest_perf_report(scope);
+      return 0;
+    }
+  }
+
+  scope->running = 1;
+  scope->start = ezctest_perf_read(scope->kind);
+  return 1;
+}
+
+int ezctest_perf_scope_failed(void) { return g_ezctest_perf_failed; }
+
+void ezctest_perf_reset(void) {
+  g_ezctest_perf_depth = 0;
+  g_ezctest_perf_overflow = 0;
+  g_ezctest_perf_failed = 0;
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 硬件性能计数器（perf_event_open）
+ * ========================================================================== */
+
+/**
+ * @brief 解析 --ezctest_perf_counters 的计数器列表并试探性打开一次
+ * @param list 逗号分隔的事件名，如 "cycles,instructions,LLC-misses"
+ * @return 可用的计数器个数；内核禁止或平台不支持时输出原因并返回0
+ * @note 仅 Linux 支持；只统计用户态（exclude_kernel），
+ *       因此 kernel.perf_event_paranoid <= 2 即可使用
+ */
+EZCTEST_API int ezctest_perf_counters_setup(const char *list);
+
+/**
+ * @brief 打开计数器组并开始计数（测试体开始前调用，不含 Setup）
+ */
+EZCTEST_API void ezctest_perf_counters_start(void);
+
+/**
+ * @brief 停止计数、读取数值并关闭计数器组（测试体结束后调用，不含 Teardown）
+ */
+EZCTEST_API void ezctest_perf_counters_stop(void);
+
+/**
+ * @brief 输出最近一次计数结果
+ * @param label 行首标签，如 "perf" 或 "perf/op"
+ * @param divisor 除数（基准测试为迭代次数，普通测试为1）
+ */
+EZCTEST_API void ezctest_perf_counters_print(const char *label,
+                                             double divisor);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+#if defined(__linux__) && !defined(EZCTEST_STM32_MODE)
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+/* syscall() 需要 glibc 默认扩展；用户先于本头文件包含了系统头时可能缺失 */
+#if defined(SYS_perf_event_open) &&                                            \
+    (defined(__USE_MISC) ||                                                    \
+     (!defined(__GLIBC__) && (defined(_BSD_SOURCE) || defined(_GNU_SOURCE))))
+#define EZCTEST_PERF_EVENTS_AVAILABLE 1
+#endif
+#endif
+
+static int g_ezctest_pc_count = 0;   /* 已选中的计数器个数 */
+static int g_ezctest_pc_sampled = 0; /* 是否有尚未输出的计数结果 */
+static int g_ezctest_pc_scaled = 0;  /* 结果是否因复用按比例换算 */
+static const char *g_ezctest_pc_names[EZCTEST_PERF_MAX_COUNTERS];
+static ezctest_u64 g_ezctest_pc_values[EZCTEST_PERF_MAX_COUNTERS];
+
+#if defined(EZCTEST_PERF_EVENTS_AVAILABLE)
+
+typedef struct {
+  const char *name;
+  unsigned int type;
+  unsigned long config;
+} ezctest_pc_event_t;
+
+/* 缓存事件编码：cache | (op << 8) | (result << 16) */
+#define EZCTEST_PC_CACHE(cache, result)                                        \
+  ((unsigned long)(cache) |                                                    \
+   ((unsigned long)PERF_COUNT_HW_CACHE_OP_READ << 8) |                         \
+   ((unsigned long)(result) << 16))
+
+static const ezctest_pc_event_t g_ezctest_pc_events[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"L1-dcache-loads", PERF_TYPE_HW_CACHE,
+     EZCTEST_PC_CACHE(PERF_COUNT_HW_CACHE_L1D,
+                      PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+    {"L1-dcache-load-misses", PERF_TYPE_HW_CACHE,
+     EZCTEST_PC_CACHE(PERF_COUNT_HW_CACHE_L1D,
+                      PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {"LLC-loads", PERF_TYPE_HW_CACHE,
+     EZCTEST_PC_CACHE(PERF_COUNT_HW_CACHE_LL,
+                      PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+    {"LLC-misses", PERF_TYPE_HW_CACHE,
+     EZCTEST_PC_CACHE(PERF_COUNT_HW_CACHE_LL,
+                      PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+#define EZCTEST_PC_EVENT_COUNT                                                 \
+  ((int)(sizeof(g_ezctest_pc_events) / sizeof(g_ezctest_pc_events[0])))
+
+static const ezctest_pc_event_t
+    *g_ezctest_pc_selected[EZCTEST_PERF_MAX_COUNTERS];
+static int g_ezctest_pc_fds[EZCTEST_PERF_MAX_COUNTERS];
+static int g_ezctest_pc_leader[EZCTEST_PERF_MAX_COUNTERS]; /* 是否为组长 */
+static int g_ezctest_pc_running = 0;
+
+/**
+ * @brief 打开一个计数器
+ * @param group_fd 组长描述符，-1 表示自己成为组长
+ * @return 文件描述符，失败返回-1（errno 保留）
+ */
+static int ezctest_pc_open(const ezctest_pc_event_t *event, int group_fd) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event->type;
+  attr.config = event->config;
+  attr.disabled = (group_fd == -1) ? 1 : 0; /* 组员跟随组长启停 */
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/**
+ * @brief 打开所有选中的计数器：尽量放在同一组中同时调度，
+ *        PMU 放不下的计数器单独成组
+ * @return 全部打开返回1；失败时关闭已打开的并返回0，*failed 为失败的下标
+ */
+static int ezctest_pc_open_all(int *failed) {
+  int leader_fd = -1;
+  int i;
+
+  for (i = 0; i < g_ezctest_pc_count; i++) {
+    int fd = -1;
+
+    if (leader_fd != -1) {
+      fd = ezctest_pc_open(g_ezctest_pc_selected[i], leader_fd);
+    }
+    g_ezctest_pc_leader[i] = (fd == -1);
+    if (fd == -1) {
+      fd = ezctest_pc_open(g_ezctest_pc_selected[i], -1);
+    }
+    if (fd == -1) {
+      int saved = errno;
+      *failed = i;
+      while (--i >= 0) {
+        close(g_ezctest_pc_fds[i]);
+      }
+      errno = saved;
+      return 0;
+    }
+    if (leader_fd == -1) {
+      leader_fd = fd;
+    }
+    g_ezctest_pc_fds[i] = fd;
+  }
+  return 1;
+}
+
+static void ezctest_pc_close_all(void) {
+  int i;
+  for (i = g_ezctest_pc_count - 1; i >= 0; i--) {
+    close(g_ezctest_pc_fds[i]);
+  }
+}
+
+/* 读取 kernel.perf_event_paranoid，失败返回 -100 */
+static int ezctest_pc_paranoid_level(void) {
+  FILE *f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+  int level = -100;
+
+  if (f != NULL) {
+    if (fscanf(f, "%d", &level) != 1) {
+      level = -100;
+    }
+    fclose(f);
+  }
+  return level;
+}
+
+/* 输出计数器打开失败的原因 */
+static void ezctest_pc_explain(const char *name, int err) {
+  ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "Note: ");
+  if (err == EACCES || err == EPERM) {
+    int level = ezctest_pc_paranoid_level();
+    printf("perf counters disabled: permission denied opening '%s'", name);
+    if (level != -100) {
+      printf(" (kernel.perf_event_paranoid = %d, user-space counting needs "
+             "<= 2 or CAP_PERFMON)",
+             level);
+    }
+    printf("\n");
+  } else if (err == ENOSYS) {
+    printf("perf counters disabled: perf_event_open is not available "
+           "(kernel config or seccomp)\n");
+  } else {
+    printf("perf counter '%s' is not supported on this CPU/kernel (%s), "
+           "skipped\n",
+           name, strerror(err));
+  }
+}
+
+int ezctest_perf_counters_setup(const char *list) {
+  const char *p = list;
+
+  g_ezctest_pc_count = 0;
+  while (p != NULL && *p != '\0') {
+    const char *end = strchr(p, ',');
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+    int i;
+    int found = 0;
+
+    for (i = 0; i < EZCTEST_PC_EVENT_COUNT && len > 0; i++) {
+      if (strlen(g_ezctest_pc_events[i].name) == len &&
+          strncmp(g_ezctest_pc_events[i].name, p, len) == 0) {
+        found = 1;
+        if (g_ezctest_pc_count < EZCTEST_PERF_MAX_COUNTERS) {
+          g_ezctest_pc_selected[g_ezctest_pc_count] = &g_ezctest_pc_events[i];
+          g_ezctest_pc_names[g_ezctest_pc_count] = g_ezctest_pc_events[i].name;
+          g_ezctest_pc_count++;
+        }
+        break;
+      }
+    }
+    if (!found && len > 0) {
+      ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "Note: ");
+      printf("unknown perf counter '%.*s' ignored (supported:", (int)len, p);
+      for (i = 0; i < EZCTEST_PC_EVENT_COUNT; i++) {
+        printf(" %s", g_ezctest_pc_events[i].name);
+      }
+      printf(")\n");
+    }
+    p = end ? end + 1 : NULL;
+  }
+
+  /* 试探性打开：不支持的事件剔除，没有权限则整体关闭 */
+  while (g_ezctest_pc_count > 0) {
+    int failed = 0;
+    int err;
+    int i;
+
+    if (ezctest_pc_open_all(&failed)) {
+      ezctest_pc_close_all();
+      break;
+    }
+    err = errno;
+    ezctest_pc_explain(g_ezctest_pc_selected[failed]->name, err);
+    if (err == EACCES || err == EPERM || err == ENOSYS) {
+      g_ezctest_pc_count = 0;
+      break;
+    }
+    for (i = failed; i + 1 < g_ezctest_pc_count; i++) {
+      g_ezctest_pc_selected[i] = g_ezctest_pc_selected[i + 1];
+      g_ezctest_pc_names[i] = g_ezctest_pc_names[i + 1];
+    }
+    g_ezctest_pc_count--;
+  }
+  return g_ezctest_pc_count;
+}
+
+void ezctest_perf_counters_start(void) {
+  int failed = 0;
+  int i;
+
+  g_ezctest_pc_sampled = 0;
+  if (g_ezctest_pc_count == 0 || g_ezctest_pc_running) {
+    return;
+  }
+  if (!ezctest_pc_open_all(&failed)) {
+    return; /* 试探时能打开，此时失败多为描述符耗尽：本次不计数 */
+  }
+  for (i = 0; i < g_ezctest_pc_count; i++) {
+    if (g_ezctest_pc_leader[i]) {
+      ioctl(g_ezctest_pc_fds[i], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    }
+  }
+  g_ezctest_pc_running = 1;
+  for (i = 0; i < g_ezctest_pc_count; i++) {
+    if (g_ezctest_pc_leader[i]) {
+      ioctl(g_ezctest_pc_fds[i], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+  }
+}
+
+void ezctest_perf_counters_stop(void) {
+  int i;
+
+  if (!g_ezctest_pc_running) {
+    return;
+  }
+  for (i = 0; i < g_ezctest_pc_count; i++) {
+    if (g_ezctest_pc_leader[i]) {
+      ioctl(g_ezctest_pc_fds[i], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+  }
+  g_ezctest_pc_running = 0;
+
+  g_ezctest_pc_scaled = 0;
+  for (i = 0; i < g_ezctest_pc_count; i++) {
+    ezctest_u64 data[3]; /* value, time_enabled, time_running */
+
+    g_ezctest_pc_values[i] = 0;
+    if (read(g_ezctest_pc_fds[i], data, sizeof(data)) !=
+        (ssize_t)sizeof(data)) {
+      continue;
+    }
+    g_ezctest_pc_values[i] = data[0];
+    if (data[2] != 0 && data[2] < data[1]) {
+      /* 计数器被复用：按启用时间比例换算 */
+      g_ezctest_pc_values[i] =
+          (ezctest_u64)((double)data[0] * (double)data[1] / (double)data[2]);
+      g_ezctest_pc_scaled = 1;
+    }
+  }
+  ezctest_pc_close_all();
+  g_ezctest_pc_sampled = 1;
+}
+
+#else
+
+int ezctest_perf_counters_setup(const char *list) {
+  if (list != NULL && *list != '\0') {
+    ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "Note: ");
+    printf("perf counters are only supported on Linux (perf_event_open), "
+           "--ezctest_perf_counters ignored\n");
+  }
+  return 0;
+}
+
+void ezctest_perf_counters_start(void) {}
+
+void ezctest_perf_counters_stop(void) {}
+
+#endif /* EZCTEST_PERF_EVENTS_AVAILABLE */
+
+void ezctest_perf_counters_print(const char *label, double divisor) {
+  int i;
+
+  if (!g_ezctest_pc_sampled) {
+    return;
+  }
+  g_ezctest_pc_sampled = 0;
+  printf("  %s:", label);
+  for (i = 0; i < g_ezctest_pc_count; i++) {
+    if (divisor == 1.0) {
+      char value[21];
+      ezctest_format_u64(g_ezctest_pc_values[i], value);
+      printf(" %s=%s", g_ezctest_pc_names[i], value);
+    } else {
+      printf(" %s=%.2f", g_ezctest_pc_names[i],
+             (double)g_ezctest_pc_values[i] / divisor);
+    }
+  }
+  printf("%s\n", g_ezctest_pc_scaled ? " (multiplexed, scaled)" : "");
+}
+
+#endif /* EZCTEST_IMPLEMENTATION */
+
+/* ============================================================================
+ * 线程、CPU 亲和性与测量环境
+ * ========================================================================== */
+
+/**
+ * @brief 可用于测量的 CPU 列表：选定了 CPU（ezctest_cpu_select）时按给定顺序
+ *        返回，否则返回进程允许的 CPU，每个物理核心的第一个逻辑 CPU 排在前面
+ * @param cpus 输出 CPU 编号
+ * @param max cpus 的容量
+ * @return CPU 个数；无法获取时返回0
+ * @note 依次绑定前 N 个 CPU 即可让 N 个线程尽量落在不同的物理核心上
+ */
+EZCTEST_API int ezctest_cpu_list(int *cpus, int max);
+
+/**
+ * @brief 把调用线程绑定到指定 CPU
+ * @param cpu CPU 编号
+ * @return 成功返回1；平台不支持或失败返回0
+ */
+EZCTEST_API int ezctest_cpu_pin_self(int cpu);
+
+/**
+ * @brief 选定测量使用的 CPU（--ezctest_cpu=LIST）
+ * @param list CPU 列表，例如 "2,3" 或 "0-3,8"；NULL 或空串表示不选定
+ * @return 选定的 CPU 个数；格式错误返回-1
+ * @note 选定后 ezctest_cpu_list 按给定顺序返回这些 CPU，基准测试线程
+ *       依次绑定到它们上
+ */
+EZCTEST_API int ezctest_cpu_select(const char *list);
+
+/**
+ * @brief 把调用线程绑定到选定的第一个 CPU，隔离子进程通过 fork 继承
+ * @return 成功返回1；未选定 CPU 或失败返回0
+ */
+EZCTEST_API int ezctest_cpu_pin_runner(void);
+
+/**
+ * @brief 忙等 ms 毫秒，让 CPU 在测量前升到稳定频率
+ * @param ms 预热时间（毫秒）
+ */
+EZCTEST_API void ezctest_cpu_warmup(int ms);
+
+/**
+ * @brief 输出测量环境（内核、CPU 型号、绑定、调频策略、SMT、负载），
+ *        并对会让计时抖动的设置给出警告
+ */
+EZCTEST_API void ezctest_env_report(void);
+
+/**
+ * @brief 在 threads 个新线程上同时运行一轮基准测试
+ * @param test 测试信息
+ * @param states 每个线程的状态（调用者已填好 iterations/range）
+ * @param threads 线程数
+ * @return 所有线程都创建成功返回1
+ * @details 线程依次绑定到 ezctest_cpu_list 的前 threads 个 CPU（CPU 不够时
+ * 不绑定）。各线程在首次进入 BENCHMARK_LOOP 时等待，全部到齐后同时放行。
+ */
+EZCTEST_API int ezctest_bench_threads_run(const ezctest_info_t *test,
+                                          ezctest_bench_state_t *states,
+                                          int threads);
+
+/**
+ * @brief BENCHMARK_LOOP 首次进入时调用：登记到达并等待放行
+ * @param gate ezctest_bench_state_t::gate
+ * @param wait 是否等待放行（线程没有进入循环就结束时为0）
+ */
+EZCTEST_API void ezctest_bench_threads_arrive(void *gate, int wait);
+
+#ifdef EZCTEST_IMPLEMENTATION
+
+#if defined(__linux__) && !defined(EZCTEST_STM32_MODE)
+#include <sys/syscall.h>
+#if defined(SYS_sched_setaffinity) &&                                          \
+    (defined(__USE_MISC) ||                                                    \
+     (!defined(__GLIBC__) && (defined(_BSD_SOURCE) || defined(_GNU_SOURCE))))
+#define EZCTEST_AFFINITY_SYSCALL 1
+#endif
+#endif
+
+#if !defined(EZCTEST_PLATFORM_WINDOWS) && !defined(EZCTEST_STM32_MODE)
+#include <sys/utsname.h>
+#endif
+
+/* CPU 掩码最多覆盖的逻辑 CPU 个数 */
+#define EZCTEST_CPU_MAX 1024
+#define EZCTEST_CPU_MASK_BITS (8 * (int)sizeof(unsigned long))
+#define EZCTEST_CPU_MASK_WORDS (EZCTEST_CPU_MAX / EZCTEST_CPU_MASK_BITS)
+
+/* --ezctest_cpu 选定的 CPU（按给定顺序） */
+static int g_ezctest_cpu_selected[EZCTEST_CPU_MAX];
+static int g_ezctest_cpu_selected_count = 0;
+static int g_ezctest_cpu_pinned = 0; /* ezctest_cpu_pin_runner 是否成功 */
+
+#if defined(EZCTEST_AFFINITY_SYSCALL)
+/* 从 sysfs 读取 cpu 所在核心的第一个逻辑 CPU（"0,4" 或 "0-1" 格式） */
+static int ezctest_cpu_first_sibling(int cpu) {
+  char path[96];
+  FILE *fp;
+  int first = cpu;
+
+  snprintf(path, sizeof(path),
+           "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+  fp = fopen(path, "r");
+  if (fp != NULL) {
+    if (fscanf(fp, "%d", &first) != 1) {
+      first = cpu;
+    }
+    fclose(fp);
+  }
+  return first;
+}
+#endif
+
+/* 进程亲和性掩码允许的 CPU，每个物理核心的第一个逻辑 CPU 排在前面 */
+static int ezctest_cpu_list_allowed(int *cpus, int max) {
+  int count = 0;
+#if defined(EZCTEST_AFFINITY_SYSCALL)
+  unsigned long mask[EZCTEST_CPU_MASK_WORDS];
+  int pass;
+  int cpu;
+
+  memset(mask, 0, sizeof(mask));
+  if (syscall(SYS_sched_getaffinity, 0, sizeof(mask), mask) <= 0) {
+    return 0;
+  }
+  /* 第一遍取每个核心的第一个逻辑 CPU，第二遍取其余的超线程 */
+  for (pass = 0; pass < 2; pass++) {
+    for (cpu = 0; cpu < EZCTEST_CPU_MAX && count < max; cpu++) {
+      int primary;
+
+      if (!(mask[cpu / EZCTEST_CPU_MASK_BITS] &
+            (1UL << (cpu % EZCTEST_CPU_MASK_BITS)))) {
+        continue;
+      }
+      primary = (ezctest_cpu_first_sibling(cpu) == cpu);
+      if (primary == (pass == 0)) {
+        cpus[count++] = cpu;
+      }
+    }
+  }
+#elif defined(EZCTEST_PLATFORM_WINDOWS)
+#if defined(_MSC_VER) && _MSC_VER < 1300
+  DWORD process_mask;
+  DWORD system_mask;
+#else
+  DWORD_PTR process_mask;
+  DWORD_PTR system_mask;
+#endif
+  int cpu;
+
+  if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask,
+                              &system_mask)) {
+    return 0;
+  }
+  for (cpu = 0; cpu < (int)(8 * sizeof(process_mask)) && count < max; cpu++) {
+    if ((process_mask >> cpu) & 1) {
+      cpus[count++] = cpu;
+    }
+  }
+#elif defined(_SC_NPROCESSORS_ONLN) && !defined(EZCTEST_STM32_MODE)
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+  while (count < online && count < max) {
+    cpus[count] = count;
+    count++;
+  }
+#else
+  (void)cpus;
+  (void)max;
+#endif
+  return count;
+}
+
+int ezctest_cpu_list(int *cpus, int max) {
+  int count = 0;
+
+  if (g_ezctest_cpu_selected_count == 0) {
+    return ezctest_cpu_list_allowed(cpus, max);
+  }
+  while (count < g_ezctest_cpu_selected_count && count < max) {
+    cpus[count] = g_ezctest_cpu_selected[count];
+    count++;
+  }
+  return count;
+}
+
+/* 把调用线程绑定到一组 CPU */
+static int ezctest_cpu_pin_set(const int *cpus, int count) {
+#if defined(EZCTEST_AFFINITY_SYSCALL)
+  unsigned long mask[EZCTEST_CPU_MASK_WORDS];
+  int i;
+
+  memset(mask, 0, sizeof(mask));
+  for (i = 0; i < count; i++) {
+    if (cpus[i] < 0 || cpus[i] >= EZCTEST_CPU_MAX) {
+      return 0;
+    }
+    mask[cpus[i] / EZCTEST_CPU_MASK_BITS] |=
+        1UL << (cpus[i] % EZCTEST_CPU_MASK_BITS);
+  }
+  return syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0;
+#elif defined(EZCTEST_PLATFORM_WINDOWS)
+  DWORD_PTR mask = 0; /* 64 位 Windows 上可以表示 64 个 CPU */
+  int i;
+
+  for (i = 0; i < count; i++) {
+    if (cpus[i] < 0 || cpus[i] >= (int)(8 * sizeof(DWORD_PTR))) {
+      return 0;
+    }
+    mask |= (DWORD_PTR)1 << cpus[i];
+  }
+  return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+  (void)cpus;
+  (void)count;
+  return 0;
+#endif
+}
+
+int ezctest_cpu_pin_self(int cpu) { return ezctest_cpu_pin_set(&cpu, 1); }
+
+int ezctest_cpu_select(const char *list) {
+  int cpus[EZCTEST_CPU_MAX];
+  int count = 0;
+  const char *p = list;
+
+  while (p != NULL && *p != '\0') {
+    char *end;
+    long first = strtol(p, &end, 10);
+    long last = first;
+
+    if (end == p || first < 0 || first >= EZCTEST_CPU_MAX) {
+      return -1;
+    }
+    p = end;
+    if (*p == '-') { /* 范围 a-b */
+      last = strtol(p + 1, &end, 10);
+      if (end == p + 1 || last < first || last >= EZCTEST_CPU_MAX) {
+        return -1;
+      }
+      p = end;
+    }
+    for (; first <= last && count < EZCTEST_CPU_MAX; first++) {
+      cpus[count++] = (int)first;
+    }
+    if (*p == ',') {
+      p++;
+    } else if (*p != '\0') {
+      return -1;
+    }
+  }
+  memcpy(g_ezctest_cpu_selected, cpus, sizeof(int) * (size_t)count);
+  g_ezctest_cpu_selected_count = count;
+  return count;
+}
+
+int ezctest_cpu_pin_runner(void) {
+  if (g_ezctest_cpu_selected_count == 0) {
+    return 0;
+  }
+  g_ezctest_cpu_pinned = ezctest_cpu_pin_self(g_ezctest_cpu_selected[0]);
+  return g_ezctest_cpu_pinned;
+}
+
+void ezctest_cpu_warmup(int ms) {
+  ezctest_u64 end = ezctest_now_ns() + (ezctest_u64)ms * 1000000;
+  volatile unsigned long spin = 0;
+
+  while (ezctest_now_ns() < end) {
+    int i;
+    for (i = 0; i < 10000; i++) {
+      spin++;
+    }
+  }
+}
+
+#if defined(__linux__) && !defined(EZCTEST_STM32_MODE)
+/* 读取文件第一行（去掉换行），失败返回0 */
+static int ezctest_env_read_line(const char *path, char *buf, size_t size) {
+  FILE *fp = fopen(path, "r");
+  size_t len;
+
+  if (fp == NULL) {
+    return 0;
+  }
+  if (fgets(buf, (int)size, fp) == NULL) {
+    fclose(fp);
+    return 0;
+  }
+  fclose(fp);
+  len = strlen(buf);
+  while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r')) {
+    buf[--len] = '\0';
+  }
+  return 1;
+}
+
+/* /proc/cpuinfo 中第一个 "model name" */
+static void ezctest_env_cpu_model(char *buf, size_t size) {
+  char line[256];
+  FILE *fp = fopen("/proc/cpuinfo", "r");
+
+  snprintf(buf, size, "unknown CPU");
+  if (fp == NULL) {
+    return;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    char *colon = strchr(line, ':');
+    size_t len;
+
+    if (strncmp(line, "model name", 10) != 0 || colon == NULL) {
+      continue;
+    }
+    colon++;
+    while (*colon == ' ' || *colon == '\t') {
+      colon++;
+    }
+    snprintf(buf, size, "%s", colon);
+    len = strlen(buf);
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r')) {
+      buf[--len] = '\0';
+    }
+    break;
+  }
+  fclose(fp);
+}
+#endif
+
+static void ezctest_env_warn(const char *message, const char *detail) {
+  ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "[ WARNING  ] ");
+  printf("%s%s\n", message, detail);
+}
+
+void ezctest_env_report(void) {
+  char pinned[128];
+  int cpus[EZCTEST_CPU_MAX];
+  int ncpus = 0;
+  int online = 0;
+  int i;
+
+  if (g_ezctest_cpu_selected_count > 0) {
+    ncpus = ezctest_cpu_list(cpus, EZCTEST_CPU_MAX);
+    if (g_ezctest_cpu_pinned) {
+      snprintf(pinned, sizeof(pinned), "pinned to CPU %s",
+               g_ezctest_config.cpu_list);
+    } else {
+      snprintf(pinned, sizeof(pinned), "not pinned (pin to CPU %.64s failed)",
+               g_ezctest_config.cpu_list);
+    }
+  } else {
+    snprintf(pinned, sizeof(pinned), "not pinned");
+  }
+
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  {
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    online = (int)info.dwNumberOfProcessors;
+    ezctest_printf_colored(EZCTEST_COLOR_CYAN, "[   ENV    ] ");
+    printf("Windows, %d CPU(s) online, %s\n", online, pinned);
+  }
+#elif !defined(EZCTEST_STM32_MODE)
+  {
+    struct utsname un;
+    char model[128];
+    char governor[64];
+    char smt[16];
+    char path[96];
+    double load = -1.0;
+    int measured = (ncpus > 0) ? cpus[0] : 0;
+
+#if defined(_SC_NPROCESSORS_ONLN)
+    online = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (uname(&un) != 0) {
+      snprintf(un.sysname, sizeof(un.sysname), "unknown");
+      un.release[0] = '\0';
+      un.machine[0] = '\0';
+    }
+    snprintf(model, sizeof(model), "unknown CPU");
+    snprintf(governor, sizeof(governor), "unknown");
+    snprintf(smt, sizeof(smt), "unknown");
+#if defined(__linux__)
+    ezctest_env_cpu_model(model, sizeof(model));
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor",
+             measured);
+    ezctest_env_read_line(path, governor, sizeof(governor));
+    if (ezctest_env_read_line("/sys/devices/system/cpu/smt/active", smt,
+                              sizeof(smt))) {
+      snprintf(smt, sizeof(smt), "%s", (smt[0] == '1') ? "on" : "off");
+    }
+    {
+      char line[64];
+      if (ezctest_env_read_line("/proc/loadavg", line, sizeof(line))) {
+        load = atof(line);
+      }
+    }
+#else
+    (void)path;
+    (void)measured;
+#endif
+    ezctest_printf_colored(EZCTEST_COLOR_CYAN, "[   ENV    ] ");
+    printf("%s %s %s, %s, %d CPU(s) online\n", un.sysname, un.release,
+           un.machine, model, online);
+    ezctest_printf_colored(EZCTEST_COLOR_CYAN, "[   ENV    ] ");
+    printf("%s, governor %s, SMT %s", pinned, governor, smt);
+    if (load >= 0.0) {
+      printf(", load %.2f", load);
+    }
+    printf(", warm-up %d ms\n", EZCTEST_CPU_WARMUP_MS);
+
+    /* 调频：只有 performance 能保证测量期间频率不变 */
+    if (strcmp(governor, "unknown") != 0 &&
+        strcmp(governor, "performance") != 0) {
+      ezctest_env_warn("CPU frequency scaling is enabled, governor: ",
+                       governor);
+    }
+#if defined(__linux__)
+    /* SMT：同一物理核心上的另一个硬件线程会抢占执行单元 */
+    for (i = 0; i < ncpus; i++) {
+      char siblings[64];
+
+      snprintf(path, sizeof(path),
+               "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list",
+               cpus[i]);
+      if (ezctest_env_read_line(path, siblings, sizeof(siblings)) &&
+          (strchr(siblings, ',') != NULL || strchr(siblings, '-') != NULL)) {
+        char detail[128];
+        snprintf(detail, sizeof(detail), "%d shares a core with SMT "
+                 "siblings %s", cpus[i], siblings);
+        ezctest_env_warn("CPU ", detail);
+      }
+    }
+#endif
+    if (online > 0 && load > (double)online * EZCTEST_ENV_MAX_LOAD) {
+      char detail[64];
+      snprintf(detail, sizeof(detail), "%.2f on %d CPU(s)", load, online);
+      ezctest_env_warn("System is busy, load average ", detail);
+    }
+  }
+#endif
+  (void)i;
+  (void)ncpus;
+  (void)online;
+  fflush(stdout);
+}
+
+#if defined(EZCTEST_THREADS_AVAILABLE)
+
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+typedef HANDLE ezctest_thread_handle_t;
+#else
+typedef pthread_t ezctest_thread_handle_t;
+#endif
+
+/* 起跑线的计数用原子操作读写：等待中的线程只读一个字，
+ * 放行后不会再争抢锁，各线程几乎同时开始计时 */
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+typedef volatile LONG ezctest_gate_word_t;
 
-    /* 添加颜色参数 */
-    if (g_ezctest_config.color >= 0 && cmd_len < (int)sizeof(cmd_line) - 30) {
-      cmd_len += snprintf(cmd_line + cmd_len, sizeof(cmd_line) - cmd_len,
-                          " --ezctest_color=%s",
-                          g_ezctest_config.color ? "yes" : "no");
-    }
+static int ezctest_gate_load(ezctest_gate_word_t *word) {
+  return (int)InterlockedCompareExchange(word, 0, 0);
+}
 
-    /* 创建子进程，继承stdout/stderr */
-    if (!CreateProcessA(NULL,     /* 应用程序名 */
-                        cmd_line, /* 命令行 */
-                        NULL,     /* 进程安全属性 */
-                        NULL,     /* 线程安全属性 */
-                        TRUE,     /* 继承句柄（允许子进程输出到父进程控制台） */
-                        0,        /* 创建标志 */
-                        NULL,     /* 环境变量 */
-                        NULL,     /* 当前目录 */
-                        &si,      /* 启动信息 */
-                        &pi       /* 进程信息 */
-                        )) {
-      fprintf(stderr, "Error: CreateProcess failed (%lu)\n", GetLastError());
-      fprintf(stderr, "Command: %s\n", cmd_line);
-      return -1;
-    }
+static void ezctest_gate_inc(ezctest_gate_word_t *word) {
+  InterlockedIncrement(word);
+}
+#elif defined(__GNUC__)
+typedef volatile int ezctest_gate_word_t;
 
-    /* 等待子进程完成 */
-    WaitForSingleObject(pi.hProcess, INFINITE);
+static int ezctest_gate_load(ezctest_gate_word_t *word) {
+  return __sync_fetch_and_add(word, 0);
+}
 
-    /* 获取退出码 */
-    if (!GetExitCodeProcess(pi.hProcess, &exit_code)) {
-      fprintf(stderr, "Error: GetExitCodeProcess failed (%lu)\n",
-              GetLastError());
-      CloseHandle(pi.hProcess);
-      CloseHandle(pi.hThread);
-      return -1;
-    }
+static void ezctest_gate_inc(ezctest_gate_word_t *word) {
+  __sync_fetch_and_add(word, 1);
+}
+#else
+/* 编译器没有原子操作：退回到一把全局锁 */
+typedef int ezctest_gate_word_t;
+static pthread_mutex_t g_ezctest_gate_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-    /* 清理句柄 */
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
+static int ezctest_gate_load(ezctest_gate_word_t *word) {
+  int value;
 
-    /* 检查退出码 */
-    if (exit_code == 0) {
-      return 0; /* 成功 */
-    } else if (exit_code == 1) {
-      return 1; /* 测试失败 */
-    } else {
-      /* 异常退出（崩溃等） - 返回特殊值让父进程处理输出 */
-      return (int)exit_code; /* 返回实际的退出码 */
+  pthread_mutex_lock(&g_ezctest_gate_mutex);
+  value = *word;
+  pthread_mutex_unlock(&g_ezctest_gate_mutex);
+  return value;
+}
+
+static void ezctest_gate_inc(ezctest_gate_word_t *word) {
+  pthread_mutex_lock(&g_ezctest_gate_mutex);
+  (*word)++;
+  pthread_mutex_unlock(&g_ezctest_gate_mutex);
+}
+#endif
+
+/* 起跑线：线程到齐后由主线程放行 */
+typedef struct {
+  ezctest_gate_word_t arrived;
+  ezctest_gate_word_t go;
+} ezctest_bench_gate_t;
+
+typedef struct {
+  const ezctest_info_t *test;
+  ezctest_bench_state_t *state;
+  int cpu; /* 绑定的 CPU，-1 表示不绑定 */
+} ezctest_bench_thread_t;
+
+static void ezctest_thread_yield(void) {
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+  Sleep(0);
+#else
+  sched_yield();
+#endif
+}
+
+void ezctest_bench_threads_arrive(void *gate, int wait) {
+  ezctest_bench_gate_t *g = (ezctest_bench_gate_t *)gate;
+
+  ezctest_gate_inc(&g->arrived);
+  /* 自旋等待而不是条件变量：放行时各线程几乎同时开始计时 */
+  while (wait && !ezctest_gate_load(&g->go)) {
+    ezctest_thread_yield();
+  }
+}
+
+static void ezctest_bench_thread_main(ezctest_bench_thread_t *t) {
+  if (t->cpu >= 0) {
+    ezctest_cpu_pin_self(t->cpu);
+  } else if (g_ezctest_cpu_selected_count > 0) {
+    /* 线程比选定的 CPU 多：不逐个绑定，但仍限制在选定范围内 */
+    ezctest_cpu_pin_set(g_ezctest_cpu_selected, g_ezctest_cpu_selected_count);
+  }
+  t->test->bench_func(t->state);
+  if (t->state->started == EZCTEST_BENCH_IDLE) {
+    /* 没有进入 BENCHMARK_LOOP（例如断言失败）：也要登记，否则无法放行 */
+    ezctest_bench_threads_arrive(t->state->gate, 0);
+  } else if (t->state->started == EZCTEST_BENCH_TIMING) {
+    /* 用 break 跳出了循环：计到此刻为止 */
+    t->state->elapsed_ns = ezctest_now_ns() - t->state->start_ns;
+    t->state->started = EZCTEST_BENCH_DONE;
+  }
+}
+
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+static DWORD WINAPI ezctest_bench_thread_entry(LPVOID arg) {
+  ezctest_bench_thread_main((ezctest_bench_thread_t *)arg);
+  return 0;
+}
+#else
+static void *ezctest_bench_thread_entry(void *arg) {
+  ezctest_bench_thread_main((ezctest_bench_thread_t *)arg);
+  return NULL;
+}
+#endif
+
+int ezctest_bench_threads_run(const ezctest_info_t *test,
+                              ezctest_bench_state_t *states, int threads) {
+  ezctest_bench_gate_t gate;
+  ezctest_bench_thread_t *info;
+  int cpus[EZCTEST_CPU_MAX];
+  int ncpus = ezctest_cpu_list(cpus, EZCTEST_CPU_MAX);
+  int created = 0;
+  int i;
+  ezctest_thread_handle_t *handles;
+
+  info = (ezctest_bench_thread_t *)malloc(sizeof(*info) * (size_t)threads);
+  handles = (ezctest_thread_handle_t *)malloc(sizeof(*handles) *
+                                              (size_t)threads);
+  if (info == NULL || handles == NULL) {
+    free(info);
+    free(handles);
+    return 0;
+  }
+  memset(&gate, 0, sizeof(gate));
+
+  /* 创建线程之前打开，全部结束之后关闭：断言计数在此期间改用原子加 */
+  g_ezctest_threads_active = 1;
+  for (i = 0; i < threads; i++) {
+    info[i].test = test;
+    info[i].state = &states[i];
+    /* CPU 足够时每个线程独占一个（优先不同物理核心），否则交给调度器 */
+    info[i].cpu = (threads <= ncpus) ? cpus[i] : -1;
+    states[i].thread_index = i;
+    states[i].threads = threads;
+    states[i].gate = &gate;
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+    handles[i] = CreateThread(NULL, 0, ezctest_bench_thread_entry, &info[i], 0,
+                              NULL);
+    if (handles[i] == NULL) {
+      break;
+    }
+#else
+    if (pthread_create(&handles[i], NULL, ezctest_bench_thread_entry,
+                       &info[i]) != 0) {
+      break;
     }
+#endif
+    created++;
+  }
+
+  /* 等所有已创建的线程到齐后同时放行 */
+  while (ezctest_gate_load(&gate.arrived) < created) {
+    ezctest_thread_yield();
   }
+  ezctest_gate_inc(&gate.go);
 
+  for (i = 0; i < created; i++) {
+#if defined(EZCTEST_PLATFORM_WINDOWS)
+    WaitForSingleObject(handles[i], INFINITE);
+    CloseHandle(handles[i]);
 #else
-  (void)test;
-  (void)test_index;
-  return -1; /* 不支持的平台 */
+    pthread_join(handles[i], NULL);
 #endif
+  }
+  g_ezctest_threads_active = 0;
+  free(handles);
+  free(info);
+  return created == threads;
 }
 
-#endif /* !EZCTEST_STM32_MODE */
+#else /* !EZCTEST_THREADS_AVAILABLE */
+
+void ezctest_bench_threads_arrive(void *gate, int wait) {
+  (void)gate;
+  (void)wait;
+}
+
+int ezctest_bench_threads_run(const ezctest_info_t *test,
+                              ezctest_bench_state_t *states, int threads) {
+  (void)test;
+  (void)states;
+  (void)threads;
+  return 0;
+}
+
+#endif /* EZCTEST_THREADS_AVAILABLE */
+
+#endif /* EZCTEST_IMPLEMENTATION */
 
 /* ============================================================================
- * 浮点数比较辅助函数
+ * 微基准测试
  * ========================================================================== */
 
 /**
- * @brief 比较两个 float 是否近似相等
- * @param a 第一个浮点数
- * @param b 第二个浮点数
- * @param epsilon 容差（默认 1e-6f）
- * @return 相等返回1，不等返回0
+ * @brief BENCHMARK_LOOP 的慢路径：首次调用时开始计时，迭代用完时停止计时
+ * @return 需要继续迭代返回1，本轮结束返回0
  */
-static int ezctest_float_eq(float a, float b, float epsilon) {
-  float diff;
-  float abs_a;
-  float abs_b;
-  float largest;
+EZCTEST_API int ezctest_bench_keep_running(ezctest_bench_state_t *state);
 
-  diff = a - b;
-  if (diff < 0)
-    diff = -diff;
+/**
+ * @brief 运行一个基准测试：自动放大迭代次数直到单轮耗时达到
+ *        EZCTEST_BENCH_MIN_TIME_MS，然后输出每次迭代的纳秒数
+ * @param test 测试信息（bench_func 非空）
+ */
+EZCTEST_API void ezctest_bench_run(const ezctest_info_t *test);
 
-  /* 处理特殊值 */
-  if (a == b)
-    return 1; /* 处理无穷大、零等 */
+/**
+ * @brief 复杂度类别的显示名，例如 "O(n log n)"
+ */
+EZCTEST_API const char *ezctest_complexity_name(int complexity);
 
-  /* 使用相对误差和绝对误差的混合方式 */
-  abs_a = a < 0 ? -a : a;
-  abs_b = b < 0 ? -b : b;
-  largest = abs_a > abs_b ? abs_a : abs_b;
+/**
+ * @brief 用最小二乘把 t 拟合为 coef * f(n)，选相对 RMS 误差最小的模型
+ * @param n 输入规模
+ * @param t 各规模的耗时（ns/op）
+ * @param count 数据点个数
+ * @param coef 输出：最佳模型的系数（ns）
+ * @param rms 输出：RMS 误差占 t 均值的比例
+ * @return 最佳模型的复杂度类别（EZCTEST_O_*）
+ * @note 模型 f(n) 为 1、log2(n)、n、n*log2(n)、n^2，均过原点
+ */
+EZCTEST_API int ezctest_complexity_fit(const double *n, const double *t,
+                                       int count, double *coef, double *rms);
 
-  return diff <= epsilon * largest || diff < epsilon;
-}
+/**
+ * @brief 优化屏障的后备实现：把对象地址写入 volatile 变量，使对象逃逸
+ * @param p 对象地址
+ */
+EZCTEST_API void ezctest_do_not_optimize_sink(const volatile void *p);
 
 /**
- * @brief 比较两个 double 是否近似相等
- * @param a 第一个双精度浮点数
- * @param b 第二个双精度浮点数
- * @param epsilon 容差（默认 1e-10）
- * @return 相等返回1，不等返回0
+ * @brief 内存屏障的后备实现：没有内联汇编和编译器内建函数时使用
  */
-static int ezctest_double_eq(double a, double b, double epsilon) {
-  double diff;
-  double abs_a;
-  double abs_b;
-  double largest;
+EZCTEST_API void ezctest_clobber_memory_fallback(void);
 
-  diff = a - b;
-  if (diff < 0)
-    diff = -diff;
+/*
+ * 优化屏障：防止基准测试的循环体在 -O2 下被当作死代码删除
+ *
+ * EZCTEST_DO_NOT_OPTIMIZE(x)     x 的值被视为已使用，同时所有内存被视为
+ *                                可能已读写（相当于附带 CLOBBER_MEMORY）
+ * EZCTEST_DO_NOT_OPTIMIZE_REG(x) 只要求 x 的值被计算出来，允许留在寄存器，
+ *                                不强制把其他值写回内存
+ * EZCTEST_CLOBBER_MEMORY()       编译器屏障：之前的写入必须完成，之后的
+ *                                读取必须重新从内存读
+ *
+ * GCC/Clang 使用空的内联汇编，不产生任何指令；x 可以是任意标量表达式。
+ * MSVC/VC6/TinyCC 等使用 volatile 变量后备实现，此时 x 必须是左值，
+ * 为了可移植请总是传入变量。
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(__TINYC__)
+#define EZCTEST_DO_NOT_OPTIMIZE(x)                                             \
+  __asm__ __volatile__("" : : "r,m"(x) : "memory")
+#define EZCTEST_DO_NOT_OPTIMIZE_REG(x) __asm__ __volatile__("" : : "r,m"(x))
+#define EZCTEST_CLOBBER_MEMORY() __asm__ __volatile__("" : : : "memory")
+#else
+#define EZCTEST_DO_NOT_OPTIMIZE(x)                                             \
+  (ezctest_do_not_optimize_sink((const volatile void *)&(x)),                  \
+   EZCTEST_CLOBBER_MEMORY())
+#define EZCTEST_DO_NOT_OPTIMIZE_REG(x)                                         \
+  ezctest_do_not_optimize_sink((const volatile void *)&(x))
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+#define EZCTEST_CLOBBER_MEMORY() _ReadWriteBarrier()
+#else
+#define EZCTEST_CLOBBER_MEMORY() ezctest_clobber_memory_fallback()
+#endif
+#endif
 
-  /* 处理特殊值 */
-  if (a == b)
-    return 1; /* 处理无穷大、零等 */
+#ifdef EZCTEST_IMPLEMENTATION
 
-  /* 使用相对误差和绝对误差的混合方式 */
-  abs_a = a < 0 ? -a : a;
-  abs_b = b < 0 ? -b : b;
-  largest = abs_a > abs_b ? abs_a : abs_b;
+/* 优化屏障后备实现的接收变量：编译器不能假设它们不会被外部读取 */
+static const volatile void *volatile g_ezctest_opt_sink = NULL;
+static volatile int g_ezctest_opt_clobber = 0;
 
-  return diff <= epsilon * largest || diff < epsilon;
+void ezctest_do_not_optimize_sink(const volatile void *p) {
+  g_ezctest_opt_sink = p;
 }
 
-/* ============================================================================
- * 断言实现
- * ========================================================================== */
+void ezctest_clobber_memory_fallback(void) { g_ezctest_opt_clobber++; }
+
+/* 单线程计时循环内的分配统计（多线程时计数器混有其他线程，不统计） */
+static ezctest_alloc_stats_t g_ezctest_bench_allocs;
+
+int ezctest_bench_keep_running(ezctest_bench_state_t *state) {
+  if (state->started == EZCTEST_BENCH_IDLE) {
+    state->started = EZCTEST_BENCH_TIMING;
+    state->remaining = state->iterations - 1;
+    if (state->gate != NULL) {
+      ezctest_bench_threads_arrive(state->gate, 1); /* 等其他线程到齐 */
+    } else {
+      ezctest_alloc_begin(&g_ezctest_bench_allocs);
+      ezctest_perf_counters_start();
+    }
+    state->start_ns = ezctest_now_ns();
+    return 1;
+  }
+  if (state->started == EZCTEST_BENCH_TIMING) {
+    state->elapsed_ns = ezctest_now_ns() - state->start_ns;
+    if (state->gate == NULL) {
+      ezctest_perf_counters_stop();
+      ezctest_alloc_end(&g_ezctest_bench_allocs);
+    }
+    state->started = EZCTEST_BENCH_DONE;
+  }
+  return 0;
+}
 
 /**
- * @brief 断言失败处理
- * @param file 源文件名
- * @param line 行号
- * @param is_fatal 是否为致命错误（ASSERT vs EXPECT）
- * @param format 格式化字符串
- *
- * @note
- * - 所有使用 EXPECT_/ASSERT_ 宏的编译单元都需要看到函数声明
- * - 实现仅在定义了 EZCTEST_IMPLEMENTATION 的编译单元中提供
+ * @brief 在 threads 个线程上各运行 iterations 次，state 汇总为墙钟耗时
+ * @return 成功测得耗时返回1
  */
-EZCTEST_API void ezctest_assertion_failed(const char *file, int line,
-                                          int is_fatal, const char *format,
-                                          ...);
+static int ezctest_bench_once_threads(const ezctest_info_t *test,
+                                      unsigned long iterations, int threads,
+                                      ezctest_bench_state_t *state) {
+  ezctest_bench_state_t *states;
+  ezctest_u64 first_start = 0;
+  ezctest_u64 last_end = 0;
+  int ok;
+  int i;
+
+  states = (ezctest_bench_state_t *)calloc((size_t)threads, sizeof(*states));
+  if (states == NULL) {
+    return 0;
+  }
+  for (i = 0; i < threads; i++) {
+    states[i].iterations = iterations;
+  }
+  ok = ezctest_bench_threads_run(test, states, threads);
+  if (!ok) {
+    printf("  Failed to start %d benchmark threads\n", threads);
+  }
+
+  for (i = 0; ok && i < threads; i++) {
+    ezctest_u64 end;
+
+    if (states[i].started == EZCTEST_BENCH_IDLE) {
+      g_ezctest_current_failed = 1;
+      printf("  Benchmark body never entered BENCHMARK_LOOP(state)\n");
+      ok = 0;
+      break;
+    }
+    end = states[i].start_ns + states[i].elapsed_ns;
+    if (i == 0 || states[i].start_ns < first_start) {
+      first_start = states[i].start_ns;
+    }
+    if (i == 0 || end > last_end) {
+      last_end = end;
+    }
+  }
+  *state = states[0];
+  state->elapsed_ns = last_end - first_start;
+  state->gate = NULL;
+  free(states);
+  if (g_ezctest_current_failed || g_ezctest_current_assertion_failed) {
+    return 0;
+  }
+  return ok;
+}
 
 /**
- * @brief 断言成功处理
- *
- * @note 同上，声明对所有编译单元可见，实现仅在 EZCTEST_IMPLEMENTATION 下提供
+ * @brief 以固定迭代次数运行一轮基准测试
+ * @param threads 0 表示在当前线程运行，否则在这么多个新线程上同时运行
+ * @return 成功测得耗时返回1；未进入 BENCHMARK_LOOP 或断言失败返回0
  */
-EZCTEST_API void ezctest_assertion_passed(void);
+static int ezctest_bench_once(const ezctest_info_t *test,
+                              unsigned long iterations, unsigned long range,
+                              int threads, ezctest_bench_state_t *state) {
+  if (threads > 0) {
+    return ezctest_bench_once_threads(test, iterations, threads, state);
+  }
+  memset(state, 0, sizeof(*state));
+  state->iterations = iterations;
+  state->range = range;
+  state->threads = 1;
+  test->bench_func(state);
+
+  if (state->started == EZCTEST_BENCH_IDLE) {
+    g_ezctest_current_failed = 1;
+    printf("  Benchmark body never entered BENCHMARK_LOOP(state)\n");
+    return 0;
+  }
+  if (state->started == EZCTEST_BENCH_TIMING) {
+    /* 用 break 跳出了循环：计到此刻为止 */
+    state->elapsed_ns = ezctest_now_ns() - state->start_ns;
+    ezctest_perf_counters_stop();
+    ezctest_alloc_end(&g_ezctest_bench_allocs);
+  }
+  /* 断言失败的基准测试不输出结果 */
+  return !(g_ezctest_current_failed || g_ezctest_current_assertion_failed);
+}
+
+/**
+ * @brief 在一个输入规模上完成标定、预热和重复测量，输出结果
+ * @param median 输出：ns/op 的中位数
+ * @return 测量成功返回1，断言失败等返回0
+ */
+static int ezctest_bench_measure(const ezctest_info_t *test, const char *name,
+                                 unsigned long range, int threads,
+                                 ezctest_bench_state_t *state,
+                                 double *median) {
+  /* 多线程时每轮共执行 iterations * threads 次操作 */
+  double ops_per_iteration = (threads > 0) ? (double)threads : 1.0;
+  ezctest_u64 min_ns = (ezctest_u64)EZCTEST_BENCH_MIN_TIME_MS * 1000000;
+  unsigned long iterations = 1;
+  int reps = g_ezctest_config.bench_repetitions;
+  double *samples;
+  double total_ns = 0.0;
+  double alloc_peak = 0.0;
+  ezctest_stats_t st;
+  int r;
+
+  /* 标定：放大迭代次数直到单轮耗时达到最短测量时间 */
+  for (;;) {
+    double next;
+
+    if (!ezctest_bench_once(test, iterations, range, threads, state)) {
+      return 0;
+    }
+    if (state->elapsed_ns >= min_ns ||
+        iterations >= EZCTEST_BENCH_MAX_ITERATIONS) {
+      break;
+    }
+
+    /* 按本轮速度估算所需次数并多放大 40%，避免每轮都差一点；
+     * 本轮太短（计时误差大）时只放大 10 倍 */
+    if (state->elapsed_ns * 10 < min_ns) {
+      next = (double)iterations * 10.0;
+    } else {
+      next = (double)iterations * 1.4 * (double)min_ns /
+             (double)state->elapsed_ns;
+    }
+    if (next > (double)EZCTEST_BENCH_MAX_ITERATIONS) {
+      next = (double)EZCTEST_BENCH_MAX_ITERATIONS;
+    }
+    iterations = (next > (double)iterations) ? (unsigned long)next
+                                             : iterations + 1;
+  }
+
+  /* 预热：让缓存、分支预测和 CPU 频率进入稳态，结果丢弃 */
+  for (r = 0; r < g_ezctest_config.bench_warmup; r++) {
+    if (!ezctest_bench_once(test, iterations, range, threads, state)) {
+      return 0;
+    }
+  }
+
+  /* 正式测量：每轮一个 ns/op 样本 */
+  samples = (double *)malloc(sizeof(double) * (size_t)reps);
+  if (samples == NULL) {
+    return 0;
+  }
+  for (r = 0; r < reps; r++) {
+    if (!ezctest_bench_once(test, iterations, range, threads, state)) {
+      free(samples);
+      return 0;
+    }
+    samples[r] = (double)state->elapsed_ns /
+                 ((double)iterations * ops_per_iteration);
+    total_ns += (double)state->elapsed_ns;
+    if (threads == 0 && (double)g_ezctest_bench_allocs.peak > alloc_peak) {
+      alloc_peak = (double)g_ezctest_bench_allocs.peak;
+    }
+  }
+  ezctest_stats_compute(samples, reps, &st);
+  ezctest_bench_results_add(name, samples, reps);
+  free(samples);
+  if (threads == 0 && ezctest_alloc_tracking()) {
+    /* 分配次数按最后一轮折算（各轮相同迭代次数，通常完全一致） */
+    ezctest_bench_results_alloc(
+        name, (double)g_ezctest_bench_allocs.allocs / (double)iterations,
+        (double)g_ezctest_bench_allocs.bytes / (double)iterations,
+        alloc_peak);
+  }
+
+  ezctest_printf_colored(EZCTEST_COLOR_CYAN, "[ BENCHMARK] ");
+  printf("%s  %.2f ns/op (%lu iterations x %d run(s), %.0f ms)\n", name,
+         st.median, iterations, reps, total_ns / 1000000.0);
+  if (reps > 1) {
+    ezctest_stats_print(name, &st, "ns/op");
+  }
+  if (threads == 0) {
+    ezctest_perf_counters_print("perf/op", (double)iterations);
+  }
+  if (threads == 0 && ezctest_alloc_tracking()) {
+    printf("  allocs/op: count=%.2f bytes=%.1f peak=%.0f\n",
+           (double)g_ezctest_bench_allocs.allocs / (double)iterations,
+           (double)g_ezctest_bench_allocs.bytes / (double)iterations,
+           alloc_peak);
+  }
+  fflush(stdout);
+  *median = st.median;
+  return 1;
+}
+
+const char *ezctest_complexity_name(int complexity) {
+  switch (complexity) {
+  case EZCTEST_O_1:
+    return "O(1)";
+  case EZCTEST_O_LOG_N:
+    return "O(log n)";
+  case EZCTEST_O_N:
+    return "O(n)";
+  case EZCTEST_O_N_LOG_N:
+    return "O(n log n)";
+  case EZCTEST_O_N_SQUARED:
+    return "O(n^2)";
+  default:
+    return "O(?)";
+  }
+}
+
+/* 复杂度模型 f(n) */
+static double ezctest_complexity_model(int complexity, double n) {
+  double log2n = ezctest_stats_log(n) / 0.69314718055994530942;
+
+  switch (complexity) {
+  case EZCTEST_O_LOG_N:
+    return log2n;
+  case EZCTEST_O_N:
+    return n;
+  case EZCTEST_O_N_LOG_N:
+    return n * log2n;
+  case EZCTEST_O_N_SQUARED:
+    return n * n;
+  default:
+    return 1.0;
+  }
+}
+
+int ezctest_complexity_fit(const double *n, const double *t, int count,
+                           double *coef, double *rms) {
+  int best = EZCTEST_O_1;
+  double mean = 0.0;
+  int c;
+  int i;
 
-#ifdef EZCTEST_IMPLEMENTATION
+  *coef = 0.0;
+  *rms = -1.0;
+  for (i = 0; i < count; i++) {
+    mean += t[i];
+  }
+  if (count <= 0 || mean <= 0.0) {
+    return best;
+  }
+  mean /= (double)count;
+
+  for (c = EZCTEST_O_1; c <= EZCTEST_O_N_SQUARED; c++) {
+    double sff = 0.0;
+    double sft = 0.0;
+    double err = 0.0;
+    double k;
+    double r;
+
+    for (i = 0; i < count; i++) {
+      double f = ezctest_complexity_model(c, n[i]);
+      sff += f * f;
+      sft += f * t[i];
+    }
+    if (sff <= 0.0) {
+      continue; /* 例如所有 n 都为1时 log n 恒为0 */
+    }
+    k = sft / sff; /* 过原点的最小二乘系数 */
+    for (i = 0; i < count; i++) {
+      double d = t[i] - k * ezctest_complexity_model(c, n[i]);
+      err += d * d;
+    }
+    r = ezctest_stats_sqrt(err / (double)count) / mean;
+    /* 按增长速度从低到高尝试，误差相同时取较低的复杂度 */
+    if (*rms < 0.0 || r < *rms) {
+      best = c;
+      *coef = k;
+      *rms = r;
+    }
+  }
+  return best;
+}
 
-void ezctest_assertion_failed(const char *file, int line, int is_fatal,
-                              const char *format, ...) {
-  va_list args;
+/* 输出拟合结果并检查 EXPECT_COMPLEXITY 声明的上界 */
+static void
+ezctest_bench_report_complexity(const char *name, const double *n,
+                                const double *t, int count,
+                                const ezctest_bench_state_t *state) {
+  double coef;
+  double rms;
+  int fitted;
+
+  if (count < 2) {
+    printf("  Complexity fit needs at least 2 input sizes\n");
+    if (state->complexity != 0) {
+      ezctest_assertion_failed(state->complexity_file, state->complexity_line,
+                               0, "EXPECT_COMPLEXITY needs at least 2 sizes");
+    }
+    return;
+  }
+  fitted = ezctest_complexity_fit(n, t, count, &coef, &rms);
+  ezctest_printf_colored(EZCTEST_COLOR_CYAN, "[    BIG-O ] ");
+  printf("%s  %s  coef %.4g ns  RMS %.1f%%\n", name,
+         ezctest_complexity_name(fitted), coef, rms * 100.0);
 
-  g_ezctest_result.total_assertions++;
-  g_ezctest_result.failed_assertions++;
-  g_ezctest_current_assertion_failed = 1;
+  if (state->complexity == 0) {
+    return;
+  }
+  if (fitted > state->complexity) {
+    ezctest_assertion_failed(state->complexity_file, state->complexity_line, 0,
+                             "Expected: complexity at most %s\n"
+                             "  Actual: %s (RMS %.1f%%)",
+                             ezctest_complexity_name(state->complexity),
+                             ezctest_complexity_name(fitted), rms * 100.0);
+  } else {
+    ezctest_assertion_passed();
+  }
+}
 
-  ezctest_printf_colored(EZCTEST_COLOR_RED, "%s:%d: Failure\n", file, line);
+/* 输出吞吐量随线程数的变化；ns_per_op 是总吞吐量的倒数 */
+static void ezctest_bench_report_scaling(const char *name, const int *threads,
+                                         const double *ns_per_op, int count) {
+  double base = 1000.0 / ns_per_op[0] / (double)threads[0];
+  int i;
 
-  va_start(args, format);
-  printf("  ");
-  vprintf(format, args);
-  printf("\n");
-  va_end(args);
+  ezctest_printf_colored(EZCTEST_COLOR_CYAN, "[  SCALING ] ");
+  printf("%s\n", name);
+  printf("  %7s  %14s  %14s  %8s  %10s\n", "threads", "total Mops/s",
+         "Mops/s/thread", "speedup", "efficiency");
+  for (i = 0; i < count; i++) {
+    double total = 1000.0 / ns_per_op[i]; /* ns/op -> 百万次操作/秒 */
+    double speedup = total / base;
+
+    printf("  %7d  %14.2f  %14.2f  %7.2fx  %9.1f%%\n", threads[i], total,
+           total / (double)threads[i], speedup,
+           100.0 * speedup / (double)threads[i]);
+  }
+}
 
-  if (is_fatal) {
-    g_ezctest_current_failed = 1;
+/* 依次以 1, 2, 4, ..., max 个线程测量 */
+static void ezctest_bench_run_threads(const ezctest_info_t *test,
+                                      const char *name) {
+  ezctest_bench_state_t state;
+  char sized[EZCTEST_MAX_NAME_LENGTH * 2 + 24];
+  int threads[EZCTEST_BENCH_MAX_RANGE_POINTS];
+  double t[EZCTEST_BENCH_MAX_RANGE_POINTS];
+  int count = 0;
+  int n = 1;
+
+#if defined(EZCTEST_THREADS_AVAILABLE)
+  while (count < EZCTEST_BENCH_MAX_RANGE_POINTS) {
+    snprintf(sized, sizeof(sized), "%s/threads:%d", name, n);
+    if (!ezctest_bench_measure(test, sized, 0, n, &state, &t[count])) {
+      return;
+    }
+    threads[count++] = n;
+    if (n >= test->bench_threads) {
+      break;
+    }
+    n = (n > test->bench_threads / 2) ? test->bench_threads : n * 2;
   }
+  ezctest_bench_report_scaling(name, threads, t, count);
+#else
+  (void)sized;
+  (void)threads;
+  (void)count;
+  (void)n;
+  printf("  Threads are not available, measuring on the calling thread\n");
+  ezctest_bench_measure(test, name, 0, 0, &state, &t[0]);
+#endif
 }
 
-void ezctest_assertion_passed(void) { g_ezctest_result.total_assertions++; }
+void ezctest_bench_run(const ezctest_info_t *test) {
+  const ezctest_bench_range_t *range = test->bench_range;
+  ezctest_bench_state_t state;
+  char name[EZCTEST_MAX_NAME_LENGTH * 2];
+  char sized[EZCTEST_MAX_NAME_LENGTH * 2 + 24];
+  double n[EZCTEST_BENCH_MAX_RANGE_POINTS];
+  double t[EZCTEST_BENCH_MAX_RANGE_POINTS];
+  unsigned long size;
+  int count = 0;
+
+  snprintf(name, sizeof(name), "%s.%s", test->suite_name, test->test_name);
+  if (test->bench_threads > 0) {
+    ezctest_bench_run_threads(test, name);
+    return;
+  }
+  if (range == NULL) {
+    if (ezctest_bench_measure(test, name, 0, 0, &state, &t[0]) &&
+        state.complexity != 0) {
+      ezctest_assertion_failed(state.complexity_file, state.complexity_line,
+                               0, "EXPECT_COMPLEXITY needs BENCHMARK_RANGE");
+    }
+    return;
+  }
+
+  /* lo, lo*m, lo*m*m, ...，最后一个规模截到 hi */
+  size = range->lo;
+  while (count < EZCTEST_BENCH_MAX_RANGE_POINTS) {
+    snprintf(sized, sizeof(sized), "%s/%lu", name, size);
+    if (!ezctest_bench_measure(test, sized, size, 0, &state, &t[count])) {
+      return;
+    }
+    n[count++] = (double)size;
+    if (size >= range->hi || range->multiplier < 2) {
+      break;
+    }
+    if (size == 0) {
+      size = 1;
+    } else {
+      size = (size > range->hi / range->multiplier) ? range->hi
+                                                    : size * range->multiplier;
+    }
+  }
+  ezctest_bench_report_complexity(name, n, t, count, &state);
+}
 
 #endif /* EZCTEST_IMPLEMENTATION */
 
@@ -1349,6 +8799,73 @@ static void ezctest_parse_arguments(int argc, char *argv[]) {
     } else if (strcmp(arg, "--ezctest_no_exec") == 0 ||
                strcmp(arg, "--no_exec") == 0) {
       g_ezctest_config.no_exec = 1;
+    } else if (strcmp(arg, "--ezctest_update_golden") == 0 ||
+               strcmp(arg, "--update_golden") == 0) {
+      g_ezctest_config.update_golden = 1;
+    } else if (strcmp(arg, "--ezctest_assertion_report") == 0 ||
+               strcmp(arg, "--assertion_report") == 0) {
+      g_ezctest_config.assertion_report = 1;
+    } else if (strcmp(arg, "--ezctest_leak_check") == 0 ||
+               strcmp(arg, "--leak_check") == 0) {
+      g_ezctest_config.leak_check = 1;
+    } else if (strcmp(arg, "--ezctest_fd_check") == 0 ||
+               strcmp(arg, "--fd_check") == 0) {
+      g_ezctest_config.fd_check = 1;
+    } else if (strcmp(arg, "--ezctest_rusage") == 0 ||
+               strcmp(arg, "--rusage") == 0) {
+      g_ezctest_config.rusage = 1;
+    } else if (strncmp(arg, "--ezctest_rusage_report=", 24) == 0 ||
+               strncmp(arg, "--rusage_report=", 16) == 0) {
+      g_ezctest_config.rusage_report = strchr(arg, '=') + 1;
+    } else if (strcmp(arg, "--ezctest_fork_template") == 0 ||
+               strcmp(arg, "--fork_template") == 0) {
+      g_ezctest_config.fork_template = 1;
+    } else if (strncmp(arg, "--ezctest_max_rss=", 18) == 0 ||
+               strncmp(arg, "--max_rss=", 10) == 0) {
+      g_ezctest_config.max_rss = ezctest_parse_size(strchr(arg, '=') + 1);
+    } else if (strncmp(arg, "--ezctest_max_cpu=", 18) == 0 ||
+               strncmp(arg, "--max_cpu=", 10) == 0) {
+      g_ezctest_config.max_cpu = atof(strchr(arg, '=') + 1);
+    } else if (strncmp(arg, "--ezctest_max_fds=", 18) == 0 ||
+               strncmp(arg, "--max_fds=", 10) == 0) {
+      g_ezctest_config.max_fds = atof(strchr(arg, '=') + 1);
+    } else if (strncmp(arg, "--ezctest_max_core=", 19) == 0 ||
+               strncmp(arg, "--max_core=", 11) == 0) {
+      g_ezctest_config.max_core = ezctest_parse_size(strchr(arg, '=') + 1);
+    } else if (strcmp(arg, "--ezctest_benchmarks") == 0 ||
+               strcmp(arg, "--benchmarks") == 0) {
+      g_ezctest_config.benchmarks = 1;
+    } else if (strncmp(arg, "--ezctest_benchmark_warmup=", 27) == 0 ||
+               strncmp(arg, "--benchmark_warmup=", 19) == 0) {
+      g_ezctest_config.bench_warmup = atoi(strchr(arg, '=') + 1);
+      if (g_ezctest_config.bench_warmup < 0) {
+        g_ezctest_config.bench_warmup = 0;
+      }
+    } else if (strncmp(arg, "--ezctest_benchmark_repetitions=", 32) == 0 ||
+               strncmp(arg, "--benchmark_repetitions=", 24) == 0) {
+      g_ezctest_config.bench_repetitions = atoi(strchr(arg, '=') + 1);
+      if (g_ezctest_config.bench_repetitions < 1) {
+        g_ezctest_config.bench_repetitions = 1;
+      }
+    } else if (strncmp(arg, "--ezctest_benchmark_save=", 25) == 0 ||
+               strncmp(arg, "--benchmark_save=", 17) == 0) {
+      g_ezctest_config.bench_save = strchr(arg, '=') + 1;
+    } else if (strncmp(arg, "--ezctest_benchmark_compare=", 28) == 0 ||
+               strncmp(arg, "--benchmark_compare=", 20) == 0) {
+      g_ezctest_config.bench_compare = strchr(arg, '=') + 1;
+    } else if (strncmp(arg, "--ezctest_benchmark_threshold=", 30) == 0 ||
+               strncmp(arg, "--benchmark_threshold=", 22) == 0) {
+      /* 接受 "5" 或 "5%" */
+      g_ezctest_config.bench_threshold = atof(strchr(arg, '=') + 1);
+    } else if (strncmp(arg, "--ezctest_cpu=", 14) == 0 ||
+               strncmp(arg, "--cpu=", 6) == 0) {
+      g_ezctest_config.cpu_list = strchr(arg, '=') + 1;
+    } else if (strncmp(arg, "--ezctest_perf_counters=", 24) == 0 ||
+               strncmp(arg, "--perf_counters=", 16) == 0) {
+      g_ezctest_config.perf_counters = strchr(arg, '=') + 1;
+    } else if (strncmp(arg, "--ezctest_report_file=", 22) == 0) {
+      /* 内部参数：Windows worker 进程的统计上报文件 */
+      ezctest_channel_attach(arg + 22);
     } else if (strncmp(arg, "--ezctest_worker=", 15) == 0) {
       const char *eq = strchr(arg, '=');
       g_ezctest_worker_index = atoi(eq + 1);
@@ -1362,6 +8879,59 @@ static void ezctest_parse_arguments(int argc, char *argv[]) {
       printf("  --ezctest_list_tests        List all tests without running\n");
       printf("  --ezctest_no_exec           Disable process isolation (run in "
              "same process)\n");
+      printf("  --ezctest_update_golden     Rewrite golden files with actual "
+             "output\n");
+      printf("  --ezctest_assertion_report  Print pass/fail counts for every "
+             "assertion site\n");
+      printf("  --ezctest_leak_check        Fail tests that leave heap blocks "
+             "unfreed\n"
+             "                              (glibc, needs "
+             "EZCTEST_ALLOC_HOOKS)\n");
+      printf("  --ezctest_fd_check          Fail tests that leave file "
+             "descriptors open or\n"
+             "                              threads running (Linux/Unix)\n");
+      printf("  --ezctest_rusage            Print peak RSS, page faults, "
+             "context switches and\n"
+             "                              CPU time of each isolated "
+             "test\n");
+      printf("  --ezctest_rusage_report=FILE  Write the same figures and "
+             "per-test allocations\n"
+             "                              to FILE\n");
+      printf("  --ezctest_fork_template     Run each suite's SETUP once in a "
+             "template process and\n"
+             "                              fork every test from it "
+             "(Linux/Unix)\n");
+      printf("  --ezctest_max_rss=SIZE      Limit each isolated test's address "
+             "space (e.g. 2G)\n");
+      printf("  --ezctest_max_cpu=SECONDS   Limit each isolated test's CPU "
+             "time\n");
+      printf("  --ezctest_max_fds=COUNT     Limit each isolated test's open "
+             "file descriptors\n");
+      printf("  --ezctest_max_core=SIZE     Limit core dump size (0 disables "
+             "core dumps)\n");
+      printf("  --ezctest_benchmarks        Run BENCHMARK()s instead of "
+             "TEST()s\n");
+      printf("  --ezctest_benchmark_warmup=N       Discarded runs per "
+             "benchmark (default %d)\n",
+             EZCTEST_BENCH_WARMUP);
+      printf("  --ezctest_benchmark_repetitions=N  Measured runs per "
+             "benchmark (default %d)\n",
+             EZCTEST_BENCH_REPETITIONS);
+      printf("  --ezctest_benchmark_save=FILE      Save benchmark samples as "
+             "a baseline\n");
+      printf("  --ezctest_benchmark_compare=FILE   Compare with a baseline; "
+             "fail on significant\n"
+             "                                     regressions\n");
+      printf("  --ezctest_benchmark_threshold=PCT  Regression threshold "
+             "(default 5%%)\n");
+      printf("  --ezctest_perf_counters=LIST  Count hardware events per test "
+             "(Linux),\n"
+             "                              e.g. cycles,instructions,"
+             "LLC-misses\n");
+      printf("  --ezctest_cpu=LIST          Pin the runner, isolated children "
+             "and benchmark\n"
+             "                              threads to CPUs, e.g. 2,3 or "
+             "4-7\n");
       printf("  --help, -h                Show this help message\n");
       printf("\nFilter patterns:\n");
       printf("  *          Match any characters\n");
@@ -1404,17 +8974,29 @@ static const ezctest_fixture_t *ezctest_find_fixture(const char *suite_name) {
  * 异常安全的测试执行包装函数
  * ========================================================================== */
 
+/**
+ * @brief 调用测试体：普通测试直接调用，基准测试交给标定循环
+ * @param test 测试信息
+ */
+static void ezctest_invoke_test(const ezctest_info_t *test) {
+  if (test->bench_func) {
+    ezctest_bench_run(test);
+  } else {
+    test->test_func();
+  }
+}
+
 #if defined(__cplusplus) && defined(_MSC_VER) && !defined(__clang__)
 /**
  * @brief C++ 异常处理包装函数（用于 MSVC）
- * @param test_func 测试函数指针
+ * @param test 测试信息
  * @return 是否有异常（0=无异常，1=有异常）
  * @note 这个函数必须独立，因为 MSVC 不允许在同一函数中混合 SEH 和 C++ 异常
  */
-static int ezctest_run_with_cpp_exception(void (*test_func)(void)) {
+static int ezctest_run_with_cpp_exception(const ezctest_info_t *test) {
   int has_exception = 0;
   try {
-    test_func();
+    ezctest_invoke_test(test);
   } catch (const std::exception &e) {
     g_ezctest_current_failed = 1;
     printf("  Uncaught C++ exception (std::exception): %s\n", e.what());
@@ -1447,11 +9029,16 @@ ezctest_run_test_with_exception_guard(const ezctest_info_t *test,
       fixture->setup();
     }
 
+    /* 硬件计数器只覆盖测试体（基准测试由 BENCHMARK_LOOP 自行启停） */
+    if (!test->bench_func) {
+      ezctest_perf_counters_start();
+    }
+
     /* 执行测试 - 带异常保护 */
 #if defined(__cplusplus) && defined(_MSC_VER) && !defined(__clang__)
     /* MSVC C++: SEH 包装 C++ 异常处理（分离到不同函数以避免 C2713 错误） */
     __try {
-      has_exception = ezctest_run_with_cpp_exception(test->test_func);
+      has_exception = ezctest_run_with_cpp_exception(test);
     } __except (EXCEPTION_EXECUTE_HANDLER) {
       g_ezctest_current_failed = 1;
       printf("  Windows Structured Exception (SEH): 0x%08lX\n",
@@ -1489,7 +9076,7 @@ ezctest_run_test_with_exception_guard(const ezctest_info_t *test,
 #elif defined(__cplusplus)
     /* GCC/Clang C++: 只支持C++异常 */
     try {
-      test->test_func();
+      ezctest_invoke_test(test);
     } catch (const std::exception &e) {
       g_ezctest_current_failed = 1;
       printf("  Uncaught C++ exception (std::exception): %s\n", e.what());
@@ -1503,7 +9090,7 @@ ezctest_run_test_with_exception_guard(const ezctest_info_t *test,
 #elif defined(_MSC_VER) && !defined(__clang__)
     /* MSVC C模式: 支持SEH */
     __try {
-      test->test_func();
+      ezctest_invoke_test(test);
     } __except (EXCEPTION_EXECUTE_HANDLER) {
       g_ezctest_current_failed = 1;
       printf("  Windows Structured Exception (SEH): 0x%08lX\n",
@@ -1530,11 +9117,13 @@ ezctest_run_test_with_exception_guard(const ezctest_info_t *test,
 
 #else
     /* 纯C模式: 无异常保护 */
-    test->test_func();
+    ezctest_invoke_test(test);
 #endif
 
+    ezctest_perf_counters_stop();
   } else {
     /* longjmp跳转到这里 - ASSERT失败 */
+    ezctest_perf_counters_stop();
     has_exception = 2; /* 标记为longjmp */
   }
 
@@ -1542,111 +9131,578 @@ ezctest_run_test_with_exception_guard(const ezctest_info_t *test,
 }
 
 /**
- * @brief 执行单个测试
- * @param test 测试信息
+ * @brief 执行单个测试
+ * @param test 测试信息
+ */
+/* 套件模板的子进程中为模板 SETUP 之前的 DEFER 栈深度：继承来的 SETUP 清理
+ * 和每测试 SETUP 时一样由测试执行；-1 表示从当前栈顶开始 */
+static int g_ezctest_inherited_defer_base = -1;
+
+static void ezctest_run_test(const ezctest_info_t *test) {
+  ezctest_u64 wall_start, cpu_start;
+  double wall_us, cpu_us;
+  ezctest_alloc_stats_t allocs;
+  char alloc_note[96];
+  const ezctest_fixture_t *fixture;
+  int exception_type = 0; /* 0=无, 1=C++/SEH异常, 2=longjmp */
+  int is_worker = (g_ezctest_worker_index >= 0); /* 是否为子进程 */
+  /* 基准测试的结果记录会跨测试保留，不做泄漏检测 */
+  int leak_check = g_ezctest_config.leak_check && !test->bench_func;
+  int fd_check = g_ezctest_config.fd_check && !test->bench_func;
+  int defer_base;
+
+  g_ezctest_current_failed = 0;
+  g_ezctest_current_assertion_failed = 0;
+  ezctest_mark_runner_thread();
+  /* 本测试的 DEFER 从当前栈顶开始；下面是全局和套件级的清理，留给它们自己 */
+  defer_base = g_ezctest_defer_stack.count;
+  if (g_ezctest_inherited_defer_base >= 0 &&
+      g_ezctest_inherited_defer_base < defer_base) {
+    defer_base = g_ezctest_inherited_defer_base;
+  }
+  g_ezctest_defer_stack.scope_depth = 0;
+  ezctest_perf_reset(); /* 丢弃上一个测试中被中断的性能预算作用域 */
+
+  /* Worker 模式下不输出（避免重复） */
+  if (!is_worker) {
+    ezctest_printf_colored(EZCTEST_COLOR_GREEN, "[ RUN      ] ");
+    printf("%s.%s\n", test->suite_name, test->test_name);
+  }
+
+  /* 查找fixture */
+  fixture = ezctest_find_fixture(test->suite_name);
+
+  if (fd_check) {
+    ezctest_fd_check_begin(); /* 快照本身会分配内存，放在泄漏检测窗口之外 */
+  }
+  if (leak_check) {
+    ezctest_leak_begin(); /* 从 Setup 之前开始记录 */
+  }
+  ezctest_alloc_begin(&allocs);
+  wall_start = ezctest_now_ns();
+  cpu_start = ezctest_cpu_time_ns();
+
+  /* 执行测试（带异常保护） */
+  exception_type = ezctest_run_test_with_exception_guard(test, fixture);
+
+  /* 无论如何都执行清理 */
+  g_ezctest_longjmp_ctx.has_jumped = 0;
+
+  /* 执行本测试的DEFER清理（LIFO） */
+  ezctest_defer_unwind(defer_base);
+  g_ezctest_defer_stack.scope_depth = 0;
+
+  /* 执行Teardown */
+  if (fixture && fixture->teardown) {
+    fixture->teardown();
+  }
+
+  /* 回收测试内存池和保护页分配（Teardown 可能还在使用其中的内存） */
+  ezctest_arena_reset();
+  ezctest_guarded_free_all();
+
+  wall_us = (double)(ezctest_now_ns() - wall_start) / 1000.0;
+  cpu_us = (double)(ezctest_cpu_time_ns() - cpu_start) / 1000.0;
+  ezctest_alloc_end(&allocs);
+  ezctest_test_time_set(wall_us * 1000.0);
+
+  /* DEFER 和 Teardown 之后仍未释放的块即为泄漏 */
+  if (leak_check) {
+    ezctest_leak_end();
+  }
+  if (fd_check) {
+    ezctest_fd_check_end();
+  }
+
+  /* 基准测试的分配情况按每次操作另行输出 */
+  alloc_note[0] = '\0';
+  if (ezctest_alloc_tracking() && !test->bench_func) {
+    snprintf(alloc_note, sizeof(alloc_note),
+             ", %lu allocs, %.0f bytes, peak %.0f bytes", allocs.allocs,
+             (double)allocs.bytes, (double)allocs.peak);
+    ezctest_test_allocs_set(allocs.allocs, (double)allocs.bytes,
+                            (double)allocs.peak);
+  }
+
+  /* 输出异常信息（子进程也输出，因为需要知道错误原因） */
+  if (exception_type == 1) {
+    printf("  (test terminated by exception)\n");
+  } else if (exception_type == 2) {
+    printf("  (test terminated by ASSERT failure)\n");
+  }
+
+  /* Worker 模式：只在结束时输出结果（含毫秒） */
+  /* 非 Worker 模式：也输出结果 */
+  if (g_ezctest_current_failed || g_ezctest_current_assertion_failed) {
+    ezctest_printf_colored(EZCTEST_COLOR_RED, "[  FAILED  ] ");
+    printf("%s.%s (wall %.0f us, cpu %.0f us%s)\n", test->suite_name,
+           test->test_name, wall_us, cpu_us, alloc_note);
+    if (!test->bench_func) {
+      ezctest_perf_counters_print("perf", 1.0);
+    }
+    fflush(stdout); /* 立即刷新输出 */
+    g_ezctest_result.failed_tests++;
+  } else {
+    ezctest_printf_colored(EZCTEST_COLOR_GREEN, "[       OK ] ");
+    printf("%s.%s (wall %.0f us, cpu %.0f us%s)\n", test->suite_name,
+           test->test_name, wall_us, cpu_us, alloc_note);
+    if (!test->bench_func) {
+      ezctest_perf_counters_print("perf", 1.0);
+    }
+    fflush(stdout); /* 立即刷新输出 */
+    g_ezctest_result.passed_tests++;
+  }
+}
+
+/**
+ * @brief 调用套件级fixture函数（C++ 异常不外泄）
+ * @param func fixture函数
+ * @return 是否有异常（0=无异常，1=有异常）
+ */
+static int ezctest_call_suite_fixture(void (*func)(void)) {
+#if defined(__cplusplus)
+  try {
+    func();
+  } catch (const std::exception &e) {
+    printf("  Uncaught C++ exception (std::exception): %s\n", e.what());
+    return 1;
+  } catch (...) {
+    printf("  Uncaught C++ exception (unknown type)\n");
+    return 1;
+  }
+#else
+  func();
+#endif
+  return 0;
+}
+
+/**
+ * @brief 执行 SETUP_SUITE 或 TEARDOWN_SUITE
+ * @param suite_name 测试套件名称
+ * @param func fixture函数
+ * @param label 输出用的名称
+ * @return 成功返回1，断言失败或异常返回0
+ */
+static int ezctest_run_suite_fixture(const char *suite_name,
+                                     void (*func)(void), const char *label) {
+  int failed = 0;
+
+  g_ezctest_current_failed = 0;
+  g_ezctest_current_assertion_failed = 0;
+  g_ezctest_defer_stack.scope_depth = 0;
+
+  /* ASSERT 失败跳回这里 */
+  g_ezctest_longjmp_ctx.has_jumped = 1;
+  if (setjmp(g_ezctest_longjmp_ctx.jmp_env) == 0) {
+    failed = ezctest_call_suite_fixture(func);
+  } else {
+    failed = 1;
+  }
+  g_ezctest_longjmp_ctx.has_jumped = 0;
+
+  if (failed || g_ezctest_current_failed ||
+      g_ezctest_current_assertion_failed) {
+    ezctest_printf_colored(EZCTEST_COLOR_RED, "[  FAILED  ] ");
+    if (suite_name != NULL) {
+      printf("%s (%s)\n", suite_name, label);
+    } else {
+      printf("%s\n", label);
+    }
+    fflush(stdout);
+    return 0;
+  }
+  return 1;
+}
+
+/* GLOBAL_SETUP 中注册的 DEFER 的起点：保留到 GLOBAL_TEARDOWN 之后执行 */
+static int g_ezctest_global_defer_mark = 0;
+
+/**
+ * @brief 按注册顺序执行全部 GLOBAL_SETUP，遇到失败即停止
+ * @return 全部成功返回1
+ */
+static int ezctest_global_setup_run(void) {
+  int i;
+  g_ezctest_global_defer_mark = g_ezctest_defer_stack.count;
+  for (i = 0; i < g_ezctest_global_setup_count; i++) {
+    if (!ezctest_run_suite_fixture(NULL, g_ezctest_global_setups[i],
+                                   "GLOBAL_SETUP")) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief 按注册的逆序执行全部 GLOBAL_TEARDOWN（GLOBAL_SETUP 失败时也执行）
+ * @return 全部成功返回1
+ */
+static int ezctest_global_teardown_run(void) {
+  int i;
+  int ok = 1;
+  for (i = g_ezctest_global_teardown_count - 1; i >= 0; i--) {
+    if (!ezctest_run_suite_fixture(NULL, g_ezctest_global_teardowns[i],
+                                   "GLOBAL_TEARDOWN")) {
+      ok = 0;
+    }
+  }
+  if (g_ezctest_global_defer_mark <= g_ezctest_defer_stack.count) {
+    ezctest_defer_unwind(g_ezctest_global_defer_mark);
+  }
+  return ok;
+}
+
+/**
+ * @brief 生成执行计划：同一套件的测试相邻，套件按首次出现的顺序
+ * @param shuffle 是否随机打乱（套件内部和套件之间，套件仍然连续）
+ * @return 计划中的测试数
+ */
+static int ezctest_plan_build(int shuffle) {
+  int i, p, n = 0;
+
+  for (i = 0; i < g_ezctest_count; i++) {
+    if (ezctest_is_selected(&g_ezctest_registry[i])) {
+      g_ezctest_plan[n++] = i;
+    }
+  }
+
+  /* 先整体洗牌（Fisher-Yates），分组时保持洗牌后的相对顺序 */
+  if (shuffle) {
+    srand((unsigned int)time(NULL));
+    for (i = n - 1; i > 0; i--) {
+      int j = rand() % (i + 1);
+      int temp = g_ezctest_plan[i];
+      g_ezctest_plan[i] = g_ezctest_plan[j];
+      g_ezctest_plan[j] = temp;
+    }
+  }
+
+  /* 稳定分组：把同一套件后面的测试依次移到该套件组的末尾 */
+  for (p = 0; p < n;) {
+    const char *suite = g_ezctest_registry[g_ezctest_plan[p]].suite_name;
+    int end = p + 1;
+    int q;
+
+    for (q = end; q < n; q++) {
+      int moved = g_ezctest_plan[q];
+      if (strcmp(g_ezctest_registry[moved].suite_name, suite) == 0) {
+        int k;
+        for (k = q; k > end; k--) {
+          g_ezctest_plan[k] = g_ezctest_plan[k - 1];
+        }
+        g_ezctest_plan[end++] = moved;
+      }
+    }
+    p = end;
+  }
+
+  g_ezctest_plan_count = n;
+  return n;
+}
+
+/* ============================================================================
+ * 套件模板进程（fork-after-setup）
+ * ========================================================================== */
+
+#if defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+
+/*
+ * --ezctest_fork_template：父进程为套件 fork 一个模板进程，模板执行一次
+ * SETUP，之后父进程每发来一个测试下标，模板就 fork 一个测试子进程。
+ * 子进程通过写时复制得到 SETUP 之后的原始状态，只执行测试体和 DEFER
+ * （包括 SETUP 中注册、随 fork 继承的 DEFER）；TEARDOWN 在套件结束时
+ * 于模板中执行一次，之后模板执行 SETUP 的 DEFER。
+ * 父进程 -> 模板：命令管道，每个测试一个 int 下标，-1 表示套件结束
+ * 模板 -> 父进程：上报通道记录，"ready <0|1>" 表示 SETUP 是否成功，
+ *                 每个测试以 "status <退出码> <rusage...>" 结束
+ */
+
+typedef struct {
+  pid_t pid;          /* 模板进程 */
+  int cmd_fd;         /* 命令管道写端 */
+  FILE *reply;        /* 记录管道读端 */
+  void (*old_sigpipe)(int);
+} ezctest_template_t;
+
+/**
+ * @brief 模板进程中：从模板 fork 并运行一个测试，等待它结束
+ * @param defer_mark 模板 SETUP 之前的 DEFER 栈深度
+ */
+static void ezctest_template_fork_test(int index, FILE *reply,
+                                       int defer_mark) {
+  const ezctest_info_t *test = &g_ezctest_registry[index];
+  ezctest_rusage_t usage;
+  int status = 0;
+  int code = 2;
+  pid_t pid;
+
+  fflush(stdout);
+  fflush(stderr);
+  fflush(reply);
+
+  pid = fork();
+  if (pid == 0) {
+    ezctest_fixture_t *fixture;
+    int i;
+
+    /* 模板已执行 SETUP，TEARDOWN 留给模板：本进程的 fixture 副本中去掉 */
+    for (i = 0; i < g_ezctest_fixture_count; i++) {
+      fixture = &g_ezctest_fixtures[i];
+      if (strcmp(fixture->suite_name, test->suite_name) == 0) {
+        fixture->setup = NULL;
+        fixture->teardown = NULL;
+      }
+    }
+
+    g_ezctest_worker_index = index;
+    g_ezctest_inherited_defer_base = defer_mark;
+    g_ezctest_result.total_tests = 0;
+    g_ezctest_result.passed_tests = 0;
+    g_ezctest_result.failed_tests = 0;
+    g_ezctest_result.total_assertions = 0;
+    g_ezctest_result.failed_assertions = 0;
+    ezctest_channel_attach_stream(reply);
+    ezctest_limits_apply(fileno(reply));
+    ezctest_guarded_attach(fileno(reply));
+
+    ezctest_run_test(test);
+    ezctest_channel_finish_child();
+    exit((g_ezctest_current_failed || g_ezctest_current_assertion_failed) ? 1
+                                                                          : 0);
+  }
+
+  memset(&usage, 0, sizeof(usage));
+  if (pid > 0) {
+#ifdef EZCTEST_HAVE_WAIT4
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) == pid) {
+      ezctest_rusage_from(&ru);
+      ezctest_rusage_take(&usage);
+    }
+#else
+    waitpid(pid, &status, 0);
+#endif
+    if (WIFEXITED(status)) {
+      code = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+      code = 128 + WTERMSIG(status);
+    }
+  } else {
+    code = -1; /* fork 失败，父进程回退到普通隔离 */
+  }
+
+  fprintf(reply, "status %d %lu %lu %lu %lu %lu %.0f %.0f\n", code,
+          usage.max_rss_kb, usage.minor_faults, usage.major_faults,
+          usage.voluntary_switches, usage.involuntary_switches, usage.user_us,
+          usage.sys_us);
+  fflush(reply);
+}
+
+/**
+ * @brief 模板进程主体：SETUP 一次，按命令 fork 测试，最后 TEARDOWN
+ */
+static void ezctest_template_main(const char *suite_name,
+                                  const ezctest_fixture_t *fixture,
+                                  int cmd_fd, FILE *reply) {
+  int defer_mark = g_ezctest_defer_stack.count;
+  int index;
+  int ok;
+
+  ok = ezctest_run_suite_fixture(suite_name, fixture->setup, "SETUP");
+  fprintf(reply, "ready %d\n", ok);
+  fflush(reply);
+
+  while (ok && read(cmd_fd, &index, sizeof(index)) == (ssize_t)sizeof(index) &&
+         index >= 0 && index < g_ezctest_count) {
+    ezctest_template_fork_test(index, reply, defer_mark);
+  }
+
+  /* 与每个测试的 TEARDOWN 一样，SETUP 失败也执行 */
+  if (fixture->teardown &&
+      !ezctest_run_suite_fixture(suite_name, fixture->teardown, "TEARDOWN")) {
+    ok = 0;
+  }
+  /* 每个子进程清理的是自己的写时复制副本，SETUP 的 DEFER 在模板中也执行一次 */
+  ezctest_defer_unwind(defer_mark);
+  fflush(stdout);
+  fflush(reply);
+  _exit(ok ? 0 : 1);
+}
+
+/**
+ * @brief 结束模板进程（发送结束命令，等待 TEARDOWN 完成）
+ * @return TEARDOWN 成功返回1
  */
-static void ezctest_run_test(const ezctest_info_t *test) {
-  clock_t start, end;
-  double elapsed_ms;
-  const ezctest_fixture_t *fixture;
-  int exception_type = 0; /* 0=无, 1=C++/SEH异常, 2=longjmp */
-  int is_worker = (g_ezctest_worker_index >= 0); /* 是否为子进程 */
+static int ezctest_template_stop(ezctest_template_t *tmpl) {
+  int end = -1;
+  int status = 0;
 
-  g_ezctest_current_failed = 0;
-  g_ezctest_current_assertion_failed = 0;
-  ezctest_defer_clear(); /* 清空DEFER栈 */
-
-  /* Worker 模式下不输出（避免重复） */
-  if (!is_worker) {
-    ezctest_printf_colored(EZCTEST_COLOR_GREEN, "[ RUN      ] ");
-    printf("%s.%s\n", test->suite_name, test->test_name);
+  if (tmpl->pid <= 0) {
+    return 1;
   }
+  if (write(tmpl->cmd_fd, &end, sizeof(end)) != (ssize_t)sizeof(end)) {
+    /* 模板已退出，下面的 waitpid 取得其状态 */
+  }
+  close(tmpl->cmd_fd);
+  ezctest_channel_read(tmpl->reply, NULL, NULL, 0);
+  fclose(tmpl->reply);
+  waitpid(tmpl->pid, &status, 0);
+  signal(SIGPIPE, tmpl->old_sigpipe);
+  tmpl->pid = 0;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
 
-  /* 查找fixture */
-  fixture = ezctest_find_fixture(test->suite_name);
-
-  start = clock();
-
-  /* 执行测试（带异常保护） */
-  exception_type = ezctest_run_test_with_exception_guard(test, fixture);
+/**
+ * @brief 为套件启动模板进程并等待其 SETUP 完成
+ * @return 模板可用返回1；失败（包括 SETUP 失败）返回0，调用方按普通隔离运行
+ */
+static int ezctest_template_start(ezctest_template_t *tmpl,
+                                  const char *suite_name,
+                                  const ezctest_fixture_t *fixture) {
+  int cmd[2], reply[2];
+  char line[32];
+
+  tmpl->pid = 0;
+  if (pipe(cmd) != 0) {
+    return 0;
+  }
+  if (pipe(reply) != 0) {
+    close(cmd[0]);
+    close(cmd[1]);
+    return 0;
+  }
 
-  /* 无论如何都执行清理 */
-  g_ezctest_longjmp_ctx.has_jumped = 0;
+  fflush(stdout);
+  fflush(stderr);
+  tmpl->pid = fork();
+  if (tmpl->pid == 0) {
+    FILE *out;
+    close(cmd[1]);
+    close(reply[0]);
+    out = fdopen(reply[1], "w");
+    if (out == NULL) {
+      _exit(1);
+    }
+    ezctest_template_main(suite_name, fixture, cmd[0], out);
+  }
 
-  /* 执行DEFER清理（LIFO） */
-  ezctest_defer_execute();
-  ezctest_defer_clear();
+  close(cmd[0]);
+  close(reply[1]);
+  if (tmpl->pid < 0) {
+    close(cmd[1]);
+    close(reply[0]);
+    tmpl->pid = 0;
+    return 0;
+  }
 
-  /* 执行Teardown */
-  if (fixture && fixture->teardown) {
-    fixture->teardown();
+  /* 模板意外退出时写命令管道不能让父进程被 SIGPIPE 终止 */
+  tmpl->old_sigpipe = signal(SIGPIPE, SIG_IGN);
+  tmpl->cmd_fd = cmd[1];
+  tmpl->reply = fdopen(reply[0], "r");
+  if (tmpl->reply == NULL) {
+    close(reply[0]);
+    close(cmd[1]);
+    waitpid(tmpl->pid, NULL, 0);
+    signal(SIGPIPE, tmpl->old_sigpipe);
+    tmpl->pid = 0;
+    return 0;
   }
 
-  end = clock();
-  elapsed_ms = ((double)(end - start) * 1000.0) / CLOCKS_PER_SEC;
+  if (!ezctest_channel_read(tmpl->reply, "ready ", line, sizeof(line)) ||
+      strcmp(line, "ready 1") != 0) {
+    ezctest_template_stop(tmpl);
+    ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "Note: ");
+    printf("template SETUP for %s failed; running its tests with per-test "
+           "SETUP\n",
+           suite_name);
+    return 0;
+  }
+  return 1;
+}
 
-  /* 输出异常信息（子进程也输出，因为需要知道错误原因） */
-  if (exception_type == 1) {
-    printf("  (test terminated by exception)\n");
-  } else if (exception_type == 2) {
-    printf("  (test terminated by ASSERT failure)\n");
+/**
+ * @brief 从模板进程 fork 一个测试并等待结果
+ * @return 与 ezctest_exec_child 相同的退出码；模板不可用时返回 -1
+ */
+static int ezctest_template_run(ezctest_template_t *tmpl, int index) {
+  char line[256];
+  ezctest_rusage_t usage;
+  int code;
+
+  if (tmpl->pid <= 0 ||
+      write(tmpl->cmd_fd, &index, sizeof(index)) != (ssize_t)sizeof(index) ||
+      !ezctest_channel_read(tmpl->reply, "status ", line, sizeof(line))) {
+    ezctest_template_stop(tmpl);
+    return -1;
   }
 
-  /* Worker 模式：只在结束时输出结果（含毫秒） */
-  /* 非 Worker 模式：也输出结果 */
-  if (g_ezctest_current_failed || g_ezctest_current_assertion_failed) {
-    ezctest_printf_colored(EZCTEST_COLOR_RED, "[  FAILED  ] ");
-    printf("%s.%s (%.0f ms)\n", test->suite_name, test->test_name, elapsed_ms);
-    fflush(stdout); /* 立即刷新输出 */
-    g_ezctest_result.failed_tests++;
-  } else {
-    ezctest_printf_colored(EZCTEST_COLOR_GREEN, "[       OK ] ");
-    printf("%s.%s (%.0f ms)\n", test->suite_name, test->test_name, elapsed_ms);
-    fflush(stdout); /* 立即刷新输出 */
-    g_ezctest_result.passed_tests++;
+  memset(&usage, 0, sizeof(usage));
+  if (sscanf(line + 7, "%d %lu %lu %lu %lu %lu %lf %lf", &code,
+             &usage.max_rss_kb, &usage.minor_faults, &usage.major_faults,
+             &usage.voluntary_switches, &usage.involuntary_switches,
+             &usage.user_us, &usage.sys_us) < 1) {
+    return 2;
   }
+  if (code >= 0) {
+    ezctest_rusage_set(&usage);
+  }
+  return code;
 }
 
+#endif
+
 /**
  * @brief Worker模式：只运行指定索引的测试
- * @param worker_index Worker索引（从0开始）
+ * @param worker_index 测试在注册表中的下标（不受 --ezctest_shuffle 影响）
  * @return 测试退出码（0=成功，1=失败）
  */
 static int ezctest_worker_mode(int worker_index) {
-  int i;
-  int test_count = 0;
-
-  /* 找到第worker_index个启用的测试 */
-  for (i = 0; i < g_ezctest_count; i++) {
-    if (!g_ezctest_registry[i].enabled) {
-      continue;
-    }
+  const ezctest_info_t *test;
+  const ezctest_fixture_t *fixture;
+  int suite_defer_mark;
+  int failed;
 
-    if (!ezctest_matches_filter(g_ezctest_registry[i].suite_name,
-                                g_ezctest_registry[i].test_name,
-                                g_ezctest_config.filter)) {
-      continue;
-    }
+  if (worker_index >= g_ezctest_count ||
+      !ezctest_is_selected(&g_ezctest_registry[worker_index])) {
+    fprintf(stderr, "Error: Worker index %d not found (total: %d)\n",
+            worker_index, g_ezctest_count);
+    return 1;
+  }
+  test = &g_ezctest_registry[worker_index];
 
-    if (test_count == worker_index) {
-      /* 找到了，运行这个测试 */
-      ezctest_run_test(&g_ezctest_registry[i]);
+  /* 独立启动的子进程没有父进程的全局和套件状态，自行执行初始化 */
+  if (!ezctest_global_setup_run()) {
+    ezctest_global_teardown_run();
+    ezctest_channel_finish_child();
+    return 1;
+  }
+  suite_defer_mark = g_ezctest_defer_stack.count;
+  fixture = ezctest_find_fixture(test->suite_name);
+  if (fixture && fixture->suite_setup &&
+      !ezctest_run_suite_fixture(test->suite_name, fixture->suite_setup,
+                                 "SETUP_SUITE")) {
+    ezctest_defer_unwind(suite_defer_mark);
+    ezctest_global_teardown_run();
+    ezctest_channel_finish_child();
+    return 1;
+  }
 
-      /* 返回退出码 */
-      if (g_ezctest_current_failed || g_ezctest_current_assertion_failed) {
-        return 1; /* 失败 */
-      } else {
-        return 0; /* 成功 */
-      }
-    }
+  ezctest_run_test(test);
+  failed = g_ezctest_current_failed || g_ezctest_current_assertion_failed;
 
-    test_count++;
+  if (fixture && fixture->suite_teardown &&
+      !ezctest_run_suite_fixture(test->suite_name, fixture->suite_teardown,
+                                 "TEARDOWN_SUITE")) {
+    failed = 1;
+  }
+  ezctest_defer_unwind(suite_defer_mark); /* SETUP_SUITE 中注册的 DEFER */
+  if (!ezctest_global_teardown_run()) {
+    failed = 1;
   }
+  ezctest_channel_finish_child();
 
-  /* 没找到测试 */
-  fprintf(stderr, "Error: Worker index %d not found (total enabled: %d)\n",
-          worker_index, test_count);
-  return 1;
+  /* 返回退出码 */
+  return failed ? 1 : 0;
 }
 
 /**
@@ -1660,12 +9716,7 @@ static void ezctest_list_tests(void) {
   for (i = 0; i < g_ezctest_count; i++) {
     const ezctest_info_t *test = &g_ezctest_registry[i];
 
-    if (!test->enabled) {
-      continue;
-    }
-
-    if (!ezctest_matches_filter(test->suite_name, test->test_name,
-                                g_ezctest_config.filter)) {
+    if (!ezctest_is_selected(test)) {
       continue;
     }
 
@@ -1678,7 +9729,8 @@ static void ezctest_list_tests(void) {
     count++;
   }
 
-  printf("\nTotal: %d test(s)\n", count);
+  printf("\nTotal: %d %s\n", count,
+         g_ezctest_config.benchmarks ? "benchmark(s)" : "test(s)");
 }
 
 /**
@@ -1747,7 +9799,8 @@ static void ezctest_scan_tests_in_memory(void) {
           /* 验证数据有效性 */
           __try {
             if (meta->info.suite_name != NULL && meta->info.test_name != NULL &&
-                meta->info.test_func != NULL &&
+                (meta->info.test_func != NULL ||
+                 meta->info.bench_func != NULL) &&
                 strlen(meta->info.suite_name) > 0 &&
                 strlen(meta->info.suite_name) < 100 &&
                 strlen(meta->info.test_name) > 0 &&
@@ -1771,6 +9824,20 @@ static void ezctest_scan_tests_in_memory(void) {
 #endif
           }
         }
+        /* 检查断言位置 magic number */
+        else if (meta->magic == EZCTEST_SITE_MAGIC) {
+          ezctest_site_t *site = (ezctest_site_t *)addr;
+          __try {
+            if (!site->linked && site->file != NULL && site->expr != NULL &&
+                site->line > 0 && strlen(site->file) < 1024 &&
+                (strncmp(site->expr, "EXPECT_", 7) == 0 ||
+                 strncmp(site->expr, "ASSERT_", 7) == 0)) {
+              ezctest_site_link(site);
+            }
+          } __except (EXCEPTION_EXECUTE_HANDLER) {
+            /* 忽略无效指针 */
+          }
+        }
         /* 检查fixture magic number */
         else if (fixture_meta->magic == EZCTEST_FIXTURE_MAGIC) {
           __try {
@@ -1778,14 +9845,29 @@ static void ezctest_scan_tests_in_memory(void) {
                 strlen(fixture_meta->suite_name) > 0 &&
                 strlen(fixture_meta->suite_name) < 100) {
 
-              /* 注册SETUP或TEARDOWN */
-              if (fixture_meta->is_setup && fixture_meta->setup != NULL) {
+              /* 注册SETUP/TEARDOWN或SETUP_SUITE/TEARDOWN_SUITE */
+              if (fixture_meta->is_setup == 1 &&
+                  fixture_meta->setup != NULL) {
                 ezctest_register_setup(fixture_meta->suite_name,
                                        fixture_meta->setup);
-              } else if (!fixture_meta->is_setup &&
+              } else if (fixture_meta->is_setup == 0 &&
                          fixture_meta->teardown != NULL) {
                 ezctest_register_teardown(fixture_meta->suite_name,
                                           fixture_meta->teardown);
+              } else if (fixture_meta->is_setup == 2 &&
+                         fixture_meta->setup != NULL) {
+                ezctest_register_suite_setup(fixture_meta->suite_name,
+                                             fixture_meta->setup);
+              } else if (fixture_meta->is_setup == 3 &&
+                         fixture_meta->teardown != NULL) {
+                ezctest_register_suite_teardown(fixture_meta->suite_name,
+                                                fixture_meta->teardown);
+              } else if (fixture_meta->is_setup == 4 &&
+                         fixture_meta->setup != NULL) {
+                ezctest_register_global_setup(fixture_meta->setup);
+              } else if (fixture_meta->is_setup == 5 &&
+                         fixture_meta->teardown != NULL) {
+                ezctest_register_global_teardown(fixture_meta->teardown);
               }
             }
           } __except (EXCEPTION_EXECUTE_HANDLER) {
@@ -1827,24 +9909,27 @@ static void ezctest_scan_tests_in_memory(void) {
  * @brief 运行所有匹配的测试
  */
 static int ezctest_run_all_tests_internal(void) {
-  int i, repeat;
-  clock_t start_time, end_time;
-  double total_time_ms;
-  int enabled_count = 0;
+  int i, k, repeat;
+  ezctest_u64 wall_start, cpu_start, children_cpu_start;
+  double wall_us, cpu_us;
+  int enabled_count;
   int use_process_isolation = 0;
+  int regressions = 0;    /* 显著变慢的基准测试数，-1 表示基线不可读 */
+  int suite_failures = 0; /* 失败的套件级/全局 fixture 数 */
+#if defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+  ezctest_template_t tmpl; /* 当前套件的模板进程 */
 
-  /* 统计启用的测试数量 */
-  for (i = 0; i < g_ezctest_count; i++) {
-    if (g_ezctest_registry[i].enabled &&
-        ezctest_matches_filter(g_ezctest_registry[i].suite_name,
-                               g_ezctest_registry[i].test_name,
-                               g_ezctest_config.filter)) {
-      enabled_count++;
-    }
-  }
+  tmpl.pid = 0;
+#endif
+
+  /* 执行计划：选中的测试，同一套件连续（洗牌只在重复运行前做一次） */
+  enabled_count = ezctest_plan_build(g_ezctest_config.shuffle);
 
   if (enabled_count == 0) {
-    ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "No tests to run\n");
+    ezctest_printf_colored(EZCTEST_COLOR_YELLOW,
+                           g_ezctest_config.benchmarks
+                               ? "No benchmarks to run\n"
+                               : "No tests to run\n");
     return 0;
   }
 
@@ -1863,6 +9948,7 @@ static int ezctest_run_all_tests_internal(void) {
 #else
   /* STM32平台不支持进程隔离 */
   use_process_isolation = 0;
+  (void)use_process_isolation;
 #endif
 
   /* 输出测试开始信息 */
@@ -1880,11 +9966,66 @@ static int ezctest_run_all_tests_internal(void) {
 #endif
   printf("\n");
 
-  start_time = clock();
+  if ((g_ezctest_config.max_rss > 0 || g_ezctest_config.max_cpu > 0 ||
+       g_ezctest_config.max_fds > 0 || g_ezctest_config.max_core >= 0)) {
+#if defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+    if (!use_process_isolation) {
+      ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "Note: ");
+      printf("resource limits apply to isolated tests; ignored without "
+             "process isolation\n");
+    }
+#else
+    ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "Note: ");
+    printf("resource limits need setrlimit(); ignored on this platform\n");
+#endif
+  }
+  if (g_ezctest_config.fork_template && !use_process_isolation) {
+    ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "Note: ");
+    printf("--ezctest_fork_template needs process isolation; ignored\n");
+  }
+#if !defined(EZCTEST_PLATFORM_LINUX) || defined(EZCTEST_STM32_MODE)
+  else if (g_ezctest_config.fork_template) {
+    ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "Note: ");
+    printf("--ezctest_fork_template needs fork(); ignored on this platform\n");
+  }
+#endif
+
+  /* 资源占用按子进程统计，不隔离时无从测量 */
+  if ((g_ezctest_config.rusage || g_ezctest_config.rusage_report != NULL) &&
+      !use_process_isolation) {
+    ezctest_printf_colored(EZCTEST_COLOR_YELLOW, "Note: ");
+    printf("resource usage is measured per isolated test; "
+           "not available without process isolation\n");
+  }
+
+  /* 进程级初始化：在第一次 fork 之前执行，隔离的子进程写时复制继承 */
+  if (!ezctest_global_setup_run()) {
+    ezctest_global_teardown_run();
+    ezctest_printf_colored(EZCTEST_COLOR_RED, "[==========] ");
+    printf("GLOBAL_SETUP failed; aborting without running any test\n");
+    return 1;
+  }
+
+  /* 计时敏感的运行：记录测量环境，并预热 CPU 让频率稳定 */
+  if (g_ezctest_config.benchmarks || g_ezctest_config.cpu_list != NULL) {
+    ezctest_env_report();
+    ezctest_cpu_warmup(EZCTEST_CPU_WARMUP_MS);
+  }
+
+  wall_start = ezctest_now_ns();
+  cpu_start = ezctest_cpu_time_ns();
+  children_cpu_start = ezctest_children_cpu_time_ns();
+
+  /* 重复运行时保留每次的耗时，结束后输出统计 */
+  if (g_ezctest_config.repeat > 1) {
+    ezctest_samples_begin(g_ezctest_count, g_ezctest_config.repeat);
+  }
 
   /* 重复执行测试 */
   for (repeat = 0; repeat < g_ezctest_config.repeat; repeat++) {
-    int test_count = 0; /* 用于worker索引计数 */
+    const ezctest_fixture_t *suite_fixture = NULL;
+    int suite_ok = 1;
+    int suite_defer_mark = 0; /* SETUP_SUITE 之前的 DEFER 栈深度 */
 
     /* 重置所有测试的失败标志 */
     for (i = 0; i < g_ezctest_count; i++) {
@@ -1896,33 +10037,54 @@ static int ezctest_run_all_tests_internal(void) {
       printf("Iteration %d/%d\n", repeat + 1, g_ezctest_config.repeat);
     }
 
-    /* 随机化测试顺序 */
-    if (g_ezctest_config.shuffle && repeat == 0) {
-      /* 简单的Fisher-Yates洗牌算法 */
-      srand((unsigned int)time(NULL));
-      for (i = g_ezctest_count - 1; i > 0; i--) {
-        int j = rand() % (i + 1);
-        ezctest_info_t temp = g_ezctest_registry[i];
-        g_ezctest_registry[i] = g_ezctest_registry[j];
-        g_ezctest_registry[j] = temp;
-      }
-    }
-
-    /* 执行测试 */
-    for (i = 0; i < g_ezctest_count; i++) {
-      ezctest_info_t *test = &g_ezctest_registry[i];
-
-      if (!test->enabled) {
-        continue;
-      }
-
-      if (!ezctest_matches_filter(test->suite_name, test->test_name,
-                                  g_ezctest_config.filter)) {
-        continue;
+    /* 按计划执行测试 */
+    for (k = 0; k < g_ezctest_plan_count; k++) {
+      ezctest_info_t *test;
+      int first_in_suite, last_in_suite;
+
+      i = g_ezctest_plan[k];
+      test = &g_ezctest_registry[i];
+      first_in_suite =
+          (k == 0 ||
+           strcmp(g_ezctest_registry[g_ezctest_plan[k - 1]].suite_name,
+                  test->suite_name) != 0);
+      last_in_suite =
+          (k + 1 == g_ezctest_plan_count ||
+           strcmp(g_ezctest_registry[g_ezctest_plan[k + 1]].suite_name,
+                  test->suite_name) != 0);
+
+      /* 套件的第一个测试之前执行 SETUP_SUITE（隔离的子进程继承其状态） */
+      if (first_in_suite) {
+        suite_fixture = ezctest_find_fixture(test->suite_name);
+        suite_ok = 1;
+        suite_defer_mark = g_ezctest_defer_stack.count;
+        if (suite_fixture && suite_fixture->suite_setup) {
+          suite_ok = ezctest_run_suite_fixture(
+              test->suite_name, suite_fixture->suite_setup, "SETUP_SUITE");
+          if (!suite_ok) {
+            suite_failures++;
+          }
+        }
+#if defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+        /* 模板进程在 SETUP_SUITE 之后 fork，同样继承其状态 */
+        if (suite_ok && use_process_isolation &&
+            g_ezctest_config.fork_template && suite_fixture &&
+            suite_fixture->setup) {
+          ezctest_template_start(&tmpl, test->suite_name, suite_fixture);
+        }
+#endif
       }
 
       g_ezctest_result.total_tests++;
 
+      if (!suite_ok) {
+        /* SETUP_SUITE 失败：跳过套件中的测试 */
+        ezctest_printf_colored(EZCTEST_COLOR_RED, "[  FAILED  ] ");
+        printf("%s.%s (skipped: SETUP_SUITE failed)\n", test->suite_name,
+               test->test_name);
+        g_ezctest_result.failed_tests++;
+        test->failed = 1;
+      } else
 #ifndef EZCTEST_STM32_MODE
       /* 根据配置选择执行方式 */
       if (use_process_isolation) {
@@ -1934,8 +10096,16 @@ static int ezctest_run_all_tests_internal(void) {
         printf("%s.%s\n", test->suite_name, test->test_name);
         fflush(stdout); /* 立即刷新输出 */
 
-        /* 执行子进程 */
-        child_exit_code = ezctest_exec_child(test, test_count);
+        /* 执行子进程（Windows 子进程按注册表下标找到测试） */
+#if defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+        child_exit_code = ezctest_template_run(&tmpl, i);
+        if (child_exit_code == -1) {
+          /* 没有模板或模板已退出：照常 fork，由子进程执行 SETUP */
+          child_exit_code = ezctest_exec_child(test, i);
+        }
+#else
+        child_exit_code = ezctest_exec_child(test, i);
+#endif
 
         /* 父进程：根据子进程退出码决定是否输出 */
         if (child_exit_code == 0) {
@@ -1955,11 +10125,24 @@ static int ezctest_run_all_tests_internal(void) {
             test->failed = 1;
           }
         } else {
+          char guard_reason[96];
+          char limit_reason[128];
+          /* 两条记录都取出，不留给下一个测试 */
+          int guarded = ezctest_guarded_reason(guard_reason,
+                                               sizeof(guard_reason));
+          int limited = ezctest_limits_reason(child_exit_code, limit_reason,
+                                              sizeof(limit_reason));
+
           /* 子进程异常退出（崩溃），父进程输出详细错误信息 */
           printf("  Test terminated abnormally with exit code %d\n",
                  child_exit_code);
 
-          /* 解析退出码 */
+          /* 解析退出码：先看是否访问了保护页或超出了资源限制 */
+          if (guarded) {
+            printf("  Reason: %s\n", guard_reason);
+          } else if (limited) {
+            printf("  Reason: %s\n", limit_reason);
+          } else
 #ifdef EZCTEST_PLATFORM_LINUX
           /* Linux: 128+信号值表示被信号终止 */
           if (child_exit_code >= 128 && child_exit_code < 256) {
@@ -2005,7 +10188,13 @@ static int ezctest_run_all_tests_internal(void) {
           test->failed = 1;
         }
 
-        test_count++; /* worker索引递增 */
+        /* 子进程的资源占用（崩溃的子进程同样有记录） */
+        {
+          ezctest_rusage_t usage;
+          if (ezctest_rusage_take(&usage)) {
+            ezctest_rusage_emit(test, &usage);
+          }
+        }
       } else
 #endif
       {
@@ -2016,16 +10205,55 @@ static int ezctest_run_all_tests_internal(void) {
           test->failed = 1;
         }
       }
+
+      /* 记录本次耗时（崩溃的子进程没有上报则跳过） */
+      {
+        double wall_ns;
+        unsigned long allocs;
+        double bytes;
+        double peak;
+        if (ezctest_test_time_take(&wall_ns)) {
+          ezctest_samples_add(i, wall_ns);
+        }
+        /* 未写入报告的分配统计不留给下一个测试 */
+        ezctest_test_allocs_take(&allocs, &bytes, &peak);
+      }
+
+#if defined(EZCTEST_PLATFORM_LINUX) && !defined(EZCTEST_STM32_MODE)
+      /* 模板在套件结束时执行 TEARDOWN 并退出 */
+      if (last_in_suite && tmpl.pid > 0 && !ezctest_template_stop(&tmpl)) {
+        suite_failures++;
+      }
+#endif
+
+      /* 套件的最后一个测试之后执行 TEARDOWN_SUITE */
+      if (last_in_suite && suite_fixture && suite_fixture->suite_teardown &&
+          !ezctest_run_suite_fixture(test->suite_name,
+                                     suite_fixture->suite_teardown,
+                                     "TEARDOWN_SUITE")) {
+        suite_failures++;
+      }
+      /* SETUP_SUITE/TEARDOWN_SUITE 中注册的 DEFER 在套件结束时执行 */
+      if (last_in_suite) {
+        ezctest_defer_unwind(suite_defer_mark);
+      }
     }
   }
 
-  end_time = clock();
-  total_time_ms = ((double)(end_time - start_time) * 1000.0) / CLOCKS_PER_SEC;
+  if (!ezctest_global_teardown_run()) {
+    suite_failures++;
+  }
+
+  /* CPU时间包含隔离子进程消耗的部分 */
+  wall_us = (double)(ezctest_now_ns() - wall_start) / 1000.0;
+  cpu_us = ((double)(ezctest_cpu_time_ns() - cpu_start) +
+            (double)(ezctest_children_cpu_time_ns() - children_cpu_start)) /
+           1000.0;
 
   /* 输出测试总结 */
   ezctest_printf_colored(EZCTEST_COLOR_GREEN, "[==========] ");
-  printf("%d test(s) ran (%.0f ms total)\n", g_ezctest_result.total_tests,
-         total_time_ms);
+  printf("%d test(s) ran (wall %.0f us, cpu %.0f us total)\n",
+         g_ezctest_result.total_tests, wall_us, cpu_us);
 
   ezctest_printf_colored(EZCTEST_COLOR_GREEN, "[  PASSED  ] ");
   printf("%d test(s)\n", g_ezctest_result.passed_tests);
@@ -2044,26 +10272,55 @@ static int ezctest_run_all_tests_internal(void) {
     }
   }
 
-  /* 断言统计：仅在非进程隔离模式下有效 */
-  if (use_process_isolation) {
-#if 0
-        printf("\nAssertions: N/A (process isolation mode - assertion counts not available)\n");
-#endif
-  } else {
-    printf("\nAssertions: %d total, %d passed, %d failed\n",
-           g_ezctest_result.total_assertions,
-           g_ezctest_result.total_assertions -
-               g_ezctest_result.failed_assertions,
+  if (suite_failures > 0) {
+    ezctest_printf_colored(EZCTEST_COLOR_RED, "[  FAILED  ] ");
+    printf("%d suite/global fixture failure(s)\n", suite_failures);
+  }
+
+  ezctest_samples_report();
+
+  /* 基准测试基线：先与旧基线比较，再保存（可以比较后原地更新同一文件） */
+  if (g_ezctest_config.bench_compare != NULL) {
+    regressions = ezctest_bench_results_compare(
+        g_ezctest_config.bench_compare, g_ezctest_config.bench_threshold);
+    if (regressions > 0) {
+      ezctest_printf_colored(EZCTEST_COLOR_RED, "[  FAILED  ] ");
+      printf("%d benchmark regression(s)\n", regressions);
+    }
+  }
+  if (g_ezctest_config.bench_save != NULL) {
+    ezctest_bench_results_save(g_ezctest_config.bench_save);
+  }
+  ezctest_rusage_report_close();
+
+  /* 断言统计：通过的断言计在各自的位置记录中，
+   * 隔离模式下子进程的计数经上报通道汇总到父进程 */
+  {
+    unsigned long total_assertions =
+        (unsigned long)g_ezctest_result.total_assertions +
+        ezctest_sites_passed();
+    printf("\nAssertions: %lu total, %lu passed, %d failed\n",
+           total_assertions,
+           total_assertions -
+               (unsigned long)g_ezctest_result.failed_assertions,
            g_ezctest_result.failed_assertions);
   }
 
-  if (g_ezctest_result.total_tests == g_ezctest_result.passed_tests) {
+  if (g_ezctest_config.assertion_report) {
+    ezctest_sites_print_report();
+  }
+
+  if (g_ezctest_result.total_tests == g_ezctest_result.passed_tests &&
+      regressions == 0 && suite_failures == 0) {
     ezctest_set_color(EZCTEST_COLOR_GREEN);
     printf("ALL %d TESTS PASSED!\n", g_ezctest_result.total_tests);
     ezctest_reset_color();
   }
 
-  return (g_ezctest_result.failed_tests == 0) ? 0 : 1;
+  return (g_ezctest_result.failed_tests == 0 && regressions == 0 &&
+          suite_failures == 0)
+             ? 0
+             : 1;
 }
 
 /* ============================================================================
@@ -2213,19 +10470,48 @@ int ezctest_run_all_tests(int argc, char *argv[]) {
   /* MSVC: 扫描内存查找测试 */
   ezctest_scan_tests_in_memory();
 #endif
+  /* 登记断言位置（MSVC 已在内存扫描中完成） */
+  ezctest_sites_collect();
   /* 老版本GCC使用.ctors段自动注册，不需要扫描 */
 
+  /* 绑定 CPU（Windows worker 通过转发的 --ezctest_cpu 自行绑定） */
+  if (g_ezctest_config.cpu_list != NULL) {
+    if (ezctest_cpu_select(g_ezctest_config.cpu_list) <= 0) {
+      fprintf(stderr, "Error: invalid CPU list '%s'\n",
+              g_ezctest_config.cpu_list);
+      return 1;
+    }
+    if (!ezctest_cpu_pin_runner()) {
+      fprintf(stderr, "Warning: failed to pin to CPU %s\n",
+              g_ezctest_config.cpu_list);
+    }
+  }
+
   /* 如果是worker模式，只运行一个测试 */
   if (g_ezctest_worker_index >= 0) {
     return ezctest_worker_mode(g_ezctest_worker_index);
   }
 
+  if (g_ezctest_config.leak_check && !ezctest_leak_available()) {
+    fprintf(stderr, "Warning: leak checking unavailable (needs glibc and "
+                    "EZCTEST_ALLOC_HOOKS)\n");
+  }
+  if (g_ezctest_config.fd_check && !ezctest_fd_check_available()) {
+    fprintf(stderr, "Warning: descriptor leak checking unavailable (needs "
+                    "/proc/self/fd or /dev/fd)\n");
+  }
+
   /* 如果只是列出测试 */
   if (g_ezctest_config.list_tests) {
     ezctest_list_tests();
     return 0;
   }
 
+  /* 打开硬件性能计数器（隔离子进程通过 fork 继承选择结果） */
+  if (g_ezctest_config.perf_counters != NULL) {
+    ezctest_perf_counters_setup(g_ezctest_config.perf_counters);
+  }
+
   /* 执行测试 */
   return ezctest_run_all_tests_internal();
 }
@@ -2435,7 +10721,7 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
   static const ezctest_metadata_t ezctest_##suite_name##_##test_name##_meta =  \
       {EZCTEST_MAGIC,                                                          \
        {#suite_name, #test_name, ezctest_##suite_name##_##test_name##_func, 1, \
-        0}};                                                                   \
+        0, NULL, NULL, 0}};                                                    \
   static volatile const void *ezctest_keep_##suite_name##_##test_name##_meta = \
       &ezctest_##suite_name##_##test_name##_meta;                              \
   static void ezctest_##suite_name##_##test_name##_func(void)
@@ -2447,38 +10733,266 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
     ezctest_register(#suite_name, #test_name,                                  \
                      ezctest_##suite_name##_##test_name##_func);               \
   }                                                                            \
-  static void (*ezctest_##suite_name##_##test_name##_ctor_ptr)(void)           \
+  static void (*ezctest_##suite_name##_##test_name##_ctor_ptr)(void)           \
+      __attribute__((section(".ctors"), used)) =                               \
+          ezctest_##suite_name##_##test_name##_register;                       \
+  static void ezctest_##suite_name##_##test_name##_func(void)
+#else
+/* 现代GCC/Clang: 使用 constructor 属性自动注册 */
+#define TEST(suite_name, test_name)                                            \
+  static void ezctest_##suite_name##_##test_name##_func(void);                 \
+  static int ezctest_##suite_name##_##test_name##_registered = 0;              \
+  static void ezctest_##suite_name##_##test_name##_register(void) {            \
+    if (!ezctest_##suite_name##_##test_name##_registered) {                    \
+      ezctest_register(#suite_name, #test_name,                                \
+                       ezctest_##suite_name##_##test_name##_func);             \
+      ezctest_##suite_name##_##test_name##_registered = 1;                     \
+    }                                                                          \
+  }                                                                            \
+  static void __attribute__((constructor))                                     \
+  ezctest_##suite_name##_##test_name##_init(void) {                            \
+    ezctest_##suite_name##_##test_name##_register();                           \
+  }                                                                            \
+  static void ezctest_##suite_name##_##test_name##_func(void)
+#endif
+
+/**
+ * @brief BENCHMARK 宏：定义一个基准测试，与 TEST 共用注册表
+ * @param suite_name 测试套件名称
+ * @param bench_name 基准测试名称
+ *
+ * @details 函数体通过参数 state 访问 ezctest_bench_state_t，
+ * 被测代码放在 BENCHMARK_LOOP(state) 中；循环前后的准备与清理不计时。
+ * 基准测试只在 --ezctest_benchmarks 时运行，过滤器同样适用。
+ *
+ * 使用示例：
+ * @code
+ * BENCHMARK(StringBench, Strlen) {
+ *     BENCHMARK_LOOP(state) {
+ *         sink += strlen(text);
+ *     }
+ * }
+ * @endcode
+ */
+#if defined(_MSC_VER)
+#define BENCHMARK(suite_name, bench_name)                                      \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state);                                           \
+  static const ezctest_metadata_t ezctest_##suite_name##_##bench_name##_meta = \
+      {EZCTEST_MAGIC,                                                          \
+       {#suite_name, #bench_name, NULL, 1, 0,                                  \
+        ezctest_##suite_name##_##bench_name##_bench, NULL, 0}};                \
+  static volatile const void                                                   \
+      *ezctest_keep_##suite_name##_##bench_name##_meta =                       \
+          &ezctest_##suite_name##_##bench_name##_meta;                         \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state)
+#elif defined(EZCTEST_GCC_NO_CONSTRUCTOR)
+#define BENCHMARK(suite_name, bench_name)                                      \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state);                                           \
+  static void ezctest_##suite_name##_##bench_name##_register(void) {           \
+    ezctest_register_benchmark(#suite_name, #bench_name,                       \
+                               ezctest_##suite_name##_##bench_name##_bench);   \
+  }                                                                            \
+  static void (*ezctest_##suite_name##_##bench_name##_ctor_ptr)(void)          \
+      __attribute__((section(".ctors"), used)) =                               \
+          ezctest_##suite_name##_##bench_name##_register;                      \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state)
+#else
+#define BENCHMARK(suite_name, bench_name)                                      \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state);                                           \
+  static void __attribute__((constructor))                                     \
+  ezctest_##suite_name##_##bench_name##_init(void) {                           \
+    ezctest_register_benchmark(#suite_name, #bench_name,                       \
+                               ezctest_##suite_name##_##bench_name##_bench);   \
+  }                                                                            \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state)
+#endif
+
+/**
+ * @brief BENCHMARK_RANGE 宏：在一组输入规模上运行基准测试并拟合复杂度
+ * @param suite_name 测试套件名称
+ * @param bench_name 基准测试名称
+ * @param lo 最小输入规模
+ * @param hi 最大输入规模（总会被测量）
+ * @param multiplier 相邻规模的倍数
+ *
+ * @details 函数体通过 state->range 读取本轮的输入规模 n，按 n 准备数据后
+ * 进入 BENCHMARK_LOOP。每个规模单独标定和重复测量（结果名为 Suite.Name/n），
+ * 之后用最小二乘把各规模的 ns/op 中位数拟合为 O(1)、O(log n)、O(n)、
+ * O(n log n)、O(n^2)，输出相对 RMS 误差最小的模型及其系数。
+ * 函数体中可以用 EXPECT_COMPLEXITY 声明复杂度上界。
+ *
+ * 使用示例：
+ * @code
+ * BENCHMARK_RANGE(Search, Binary, 64, 65536, 4) {
+ *     int *data = make_sorted(state->range);
+ *     EXPECT_COMPLEXITY(state, EZCTEST_O_LOG_N);
+ *     BENCHMARK_LOOP(state) {
+ *         int *hit = bsearch_int(data, state->range, 42);
+ *         EZCTEST_DO_NOT_OPTIMIZE(hit);
+ *     }
+ *     free(data);
+ * }
+ * @endcode
+ */
+#if defined(_MSC_VER)
+#define BENCHMARK_RANGE(suite_name, bench_name, lo, hi, multiplier)            \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state);                                           \
+  static const ezctest_bench_range_t                                           \
+      ezctest_##suite_name##_##bench_name##_range = {(lo), (hi),               \
+                                                     (multiplier)};            \
+  static const ezctest_metadata_t ezctest_##suite_name##_##bench_name##_meta = \
+      {EZCTEST_MAGIC,                                                          \
+       {#suite_name, #bench_name, NULL, 1, 0,                                  \
+        ezctest_##suite_name##_##bench_name##_bench,                           \
+        &ezctest_##suite_name##_##bench_name##_range, 0}};                     \
+  static volatile const void                                                   \
+      *ezctest_keep_##suite_name##_##bench_name##_meta =                       \
+          &ezctest_##suite_name##_##bench_name##_meta;                         \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state)
+#elif defined(EZCTEST_GCC_NO_CONSTRUCTOR)
+#define BENCHMARK_RANGE(suite_name, bench_name, lo, hi, multiplier)            \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state);                                           \
+  static const ezctest_bench_range_t                                           \
+      ezctest_##suite_name##_##bench_name##_range = {(lo), (hi),               \
+                                                     (multiplier)};            \
+  static void ezctest_##suite_name##_##bench_name##_register(void) {           \
+    ezctest_register_benchmark_range(                                          \
+        #suite_name, #bench_name, ezctest_##suite_name##_##bench_name##_bench, \
+        &ezctest_##suite_name##_##bench_name##_range);                         \
+  }                                                                            \
+  static void (*ezctest_##suite_name##_##bench_name##_ctor_ptr)(void)          \
+      __attribute__((section(".ctors"), used)) =                               \
+          ezctest_##suite_name##_##bench_name##_register;                      \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state)
+#else
+#define BENCHMARK_RANGE(suite_name, bench_name, lo, hi, multiplier)            \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state);                                           \
+  static const ezctest_bench_range_t                                           \
+      ezctest_##suite_name##_##bench_name##_range = {(lo), (hi),               \
+                                                     (multiplier)};            \
+  static void __attribute__((constructor))                                     \
+  ezctest_##suite_name##_##bench_name##_init(void) {                           \
+    ezctest_register_benchmark_range(                                          \
+        #suite_name, #bench_name, ezctest_##suite_name##_##bench_name##_bench, \
+        &ezctest_##suite_name##_##bench_name##_range);                         \
+  }                                                                            \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state)
+#endif
+
+/**
+ * @brief BENCHMARK_THREADS 宏：测量吞吐量随线程数的扩展性
+ * @param suite_name 测试套件名称
+ * @param bench_name 基准测试名称
+ * @param max_threads 最大线程数，依次测量 1, 2, 4, ..., max_threads
+ *
+ * @details 函数体在每个线程上各执行一次，可通过 state->thread_index 和
+ * state->threads 区分线程。各线程首次进入 BENCHMARK_LOOP 时在起跑线等待，
+ * 全部到齐后同时开始计时；每轮耗时取最早开始到最晚结束的墙钟时间。
+ * 每个线程数的结果名为 Suite.Name/threads:N，最后输出总吞吐量、单线程
+ * 吞吐量、相对1线程的加速比和并行效率。CPU 足够时各线程绑定到不同的
+ * CPU（优先不同物理核心）。
+ *
+ * @note 需要定义 EZCTEST_THREADS（POSIX 下链接 -pthread），否则只在调用
+ * 线程上测量。函数体在工作线程中运行：ASSERT_* 失败时记录失败并从函数体
+ * 返回（不 longjmp 到测试线程），也不采集硬件性能计数器。
+ *
+ * 使用示例：
+ * @code
+ * BENCHMARK_THREADS(Queue, PushPop, 8) {
+ *     BENCHMARK_LOOP(state) {
+ *         queue_push(&q, state->thread_index);
+ *         queue_pop(&q);
+ *     }
+ * }
+ * @endcode
+ */
+#if defined(_MSC_VER)
+#define BENCHMARK_THREADS(suite_name, bench_name, max_threads)                 \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state);                                           \
+  static const ezctest_metadata_t ezctest_##suite_name##_##bench_name##_meta = \
+      {EZCTEST_MAGIC,                                                          \
+       {#suite_name, #bench_name, NULL, 1, 0,                                  \
+        ezctest_##suite_name##_##bench_name##_bench, NULL,                     \
+        (max_threads)}};                                                       \
+  static volatile const void                                                   \
+      *ezctest_keep_##suite_name##_##bench_name##_meta =                       \
+          &ezctest_##suite_name##_##bench_name##_meta;                         \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state)
+#elif defined(EZCTEST_GCC_NO_CONSTRUCTOR)
+#define BENCHMARK_THREADS(suite_name, bench_name, max_threads)                 \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state);                                           \
+  static void ezctest_##suite_name##_##bench_name##_register(void) {           \
+    ezctest_register_benchmark_threads(                                        \
+        #suite_name, #bench_name, ezctest_##suite_name##_##bench_name##_bench, \
+        (max_threads));                                                        \
+  }                                                                            \
+  static void (*ezctest_##suite_name##_##bench_name##_ctor_ptr)(void)          \
       __attribute__((section(".ctors"), used)) =                               \
-          ezctest_##suite_name##_##test_name##_register;                       \
-  static void ezctest_##suite_name##_##test_name##_func(void)
+          ezctest_##suite_name##_##bench_name##_register;                      \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state)
 #else
-/* 现代GCC/Clang: 使用 constructor 属性自动注册 */
-#define TEST(suite_name, test_name)                                            \
-  static void ezctest_##suite_name##_##test_name##_func(void);                 \
-  static int ezctest_##suite_name##_##test_name##_registered = 0;              \
-  static void ezctest_##suite_name##_##test_name##_register(void) {            \
-    if (!ezctest_##suite_name##_##test_name##_registered) {                    \
-      ezctest_register(#suite_name, #test_name,                                \
-                       ezctest_##suite_name##_##test_name##_func);             \
-      ezctest_##suite_name##_##test_name##_registered = 1;                     \
-    }                                                                          \
-  }                                                                            \
+#define BENCHMARK_THREADS(suite_name, bench_name, max_threads)                 \
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state);                                           \
   static void __attribute__((constructor))                                     \
-  ezctest_##suite_name##_##test_name##_init(void) {                            \
-    ezctest_##suite_name##_##test_name##_register();                           \
+  ezctest_##suite_name##_##bench_name##_init(void) {                           \
+    ezctest_register_benchmark_threads(                                        \
+        #suite_name, #bench_name, ezctest_##suite_name##_##bench_name##_bench, \
+        (max_threads));                                                        \
   }                                                                            \
-  static void ezctest_##suite_name##_##test_name##_func(void)
+  static void ezctest_##suite_name##_##bench_name##_bench(                     \
+      ezctest_bench_state_t *state)
 #endif
 
+/**
+ * @brief 声明基准测试的复杂度上界：拟合出的复杂度更差时该测试失败
+ * @param state 基准测试状态
+ * @param big_o EZCTEST_O_1 / EZCTEST_O_LOG_N / EZCTEST_O_N /
+ *              EZCTEST_O_N_LOG_N / EZCTEST_O_N_SQUARED
+ * @note 只对 BENCHMARK_RANGE 有意义，在所有规模测完后才检查
+ */
+#define EXPECT_COMPLEXITY(state, big_o)                                        \
+  do {                                                                         \
+    (state)->complexity = (big_o);                                             \
+    (state)->complexity_file = __FILE__;                                       \
+    (state)->complexity_line = __LINE__;                                       \
+  } while (0)
+
+/**
+ * @brief 基准测试的计时循环，执行 state->iterations 次循环体
+ * @note 快路径只做一次递减和比较；state 会被多次求值
+ */
+#define BENCHMARK_LOOP(state)                                                  \
+  while ((state)->remaining != 0 ? ((state)->remaining--, 1)                   \
+                                 : ezctest_bench_keep_running(state))
+
 /* ============================================================================
  * 宏定义 - EXPECT断言（非致命）
  * ========================================================================== */
 
 #define EXPECT_TRUE(condition)                                                 \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_TRUE(" #condition ")");                               \
     if (condition) {                                                           \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 0,                          \
                                "Expected: (%s) is true\n  Actual: false",      \
                                #condition);                                    \
@@ -2487,9 +11001,11 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_FALSE(condition)                                                \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_FALSE(" #condition ")");                              \
     if (!(condition)) {                                                        \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 0,                          \
                                "Expected: (%s) is false\n  Actual: true",      \
                                #condition);                                    \
@@ -2498,10 +11014,12 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_EQ(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_EQ(" #val1 ", " #val2 ")");                           \
     if ((val1) == (val2)) {                                                    \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES("==", val1, val2, ezctest_msg_buf,                 \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 0, "%s", ezctest_msg_buf);  \
@@ -2510,10 +11028,12 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_NE(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_NE(" #val1 ", " #val2 ")");                           \
     if ((val1) != (val2)) {                                                    \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES("!=", val1, val2, ezctest_msg_buf,                 \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 0, "%s", ezctest_msg_buf);  \
@@ -2522,10 +11042,12 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_LT(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_LT(" #val1 ", " #val2 ")");                           \
     if ((val1) < (val2)) {                                                     \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES("<", val1, val2, ezctest_msg_buf,                  \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 0, "%s", ezctest_msg_buf);  \
@@ -2534,10 +11056,12 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_LE(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_LE(" #val1 ", " #val2 ")");                           \
     if ((val1) <= (val2)) {                                                    \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES("<=", val1, val2, ezctest_msg_buf,                 \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 0, "%s", ezctest_msg_buf);  \
@@ -2546,10 +11070,12 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_GT(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_GT(" #val1 ", " #val2 ")");                           \
     if ((val1) > (val2)) {                                                     \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES(">", val1, val2, ezctest_msg_buf,                  \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 0, "%s", ezctest_msg_buf);  \
@@ -2558,10 +11084,12 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_GE(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_GE(" #val1 ", " #val2 ")");                           \
     if ((val1) >= (val2)) {                                                    \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES(">=", val1, val2, ezctest_msg_buf,                 \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 0, "%s", ezctest_msg_buf);  \
@@ -2570,21 +11098,25 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_STREQ(str1, str2)                                               \
   do {                                                                         \
-    if (strcmp((str1), (str2)) == 0) {                                         \
-      ezctest_assertion_passed();                                              \
+    EZCTEST_SITE("EXPECT_STREQ(" #str1 ", " #str2 ")");                        \
+    const char *ezctest_s1 = (str1);                                           \
+    const char *ezctest_s2 = (str2);                                           \
+    if (strcmp(ezctest_s1, ezctest_s2) == 0) {                                 \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
-      ezctest_assertion_failed(                                                \
-          __FILE__, __LINE__, 0,                                               \
-          "Expected: %s == %s\n  Actual: \"%s\" != \"%s\"", #str1, #str2,      \
-          (str1), (str2));                                                     \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_text_assertion_failed(__FILE__, __LINE__, 0, #str1, #str2,       \
+                                    ezctest_s1, ezctest_s2, 0);                \
     }                                                                          \
   } while (0)
 
 #define EXPECT_STRNE(str1, str2)                                               \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_STRNE(" #str1 ", " #str2 ")");                        \
     if (strcmp((str1), (str2)) != 0) {                                         \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(                                                \
           __FILE__, __LINE__, 0,                                               \
           "Expected: %s != %s\n  Actual: both are \"%s\"", #str1, #str2,       \
@@ -2592,11 +11124,31 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
     }                                                                          \
   } while (0)
 
+/**
+ * @brief 期望两段文本相等，失败时总是输出带上下文的行级 unified diff
+ * @note 适合多行、大体积的序列化输出比较
+ */
+#define EXPECT_TEXT_EQ(str1, str2)                                             \
+  do {                                                                         \
+    EZCTEST_SITE("EXPECT_TEXT_EQ(" #str1 ", " #str2 ")");                      \
+    const char *ezctest_s1 = (str1);                                           \
+    const char *ezctest_s2 = (str2);                                           \
+    if (strcmp(ezctest_s1, ezctest_s2) == 0) {                                 \
+      EZCTEST_SITE_PASSED();                                                   \
+    } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_text_assertion_failed(__FILE__, __LINE__, 0, #str1, #str2,       \
+                                    ezctest_s1, ezctest_s2, 1);                \
+    }                                                                          \
+  } while (0)
+
 #define EXPECT_NULL(ptr)                                                       \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_NULL(" #ptr ")");                                     \
     if ((ptr) == NULL) {                                                       \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 0,                          \
                                "Expected: %s is NULL\n  Actual: not NULL",     \
                                #ptr);                                          \
@@ -2605,9 +11157,11 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_NOT_NULL(ptr)                                                   \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_NOT_NULL(" #ptr ")");                                 \
     if ((ptr) != NULL) {                                                       \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 0,                          \
                                "Expected: %s is not NULL\n  Actual: NULL",     \
                                #ptr);                                          \
@@ -2616,6 +11170,7 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_EMPTY(ptr, size)                                                \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_EMPTY(" #ptr ", " #size ")");                         \
     int is_empty = 1;                                                          \
     int i;                                                                     \
     for (i = 0; i < (int)size; ++i) {                                          \
@@ -2625,8 +11180,9 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
       }                                                                        \
     }                                                                          \
     if (is_empty) {                                                            \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 0,                          \
                                "Expected: %s is not empty\n", #ptr);           \
     }                                                                          \
@@ -2634,6 +11190,7 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_NOT_EMPTY(ptr, size)                                            \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_NOT_EMPTY(" #ptr ", " #size ")");                     \
     int is_empty = 1;                                                          \
     int i;                                                                     \
     for (i = 0; i < (int)size; ++i) {                                          \
@@ -2643,8 +11200,9 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
       }                                                                        \
     }                                                                          \
     if (!is_empty) {                                                           \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 0,                          \
                                "Expected: %s is empty\n", #ptr);               \
     }                                                                          \
@@ -2656,11 +11214,13 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_FLOAT_EQ(val1, val2)                                            \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_FLOAT_EQ(" #val1 ", " #val2 ")");                     \
     float ezctest_v1 = (float)(val1);                                          \
     float ezctest_v2 = (float)(val2);                                          \
     if (ezctest_float_eq(ezctest_v1, ezctest_v2, 1e-6f)) {                     \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(                                                \
           __FILE__, __LINE__, 0,                                               \
           "Expected: %s == %s (float)\n  Actual: %g vs %g (diff: %g)", #val1,  \
@@ -2671,11 +11231,13 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_DOUBLE_EQ(val1, val2)                                           \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_DOUBLE_EQ(" #val1 ", " #val2 ")");                    \
     double ezctest_v1 = (double)(val1);                                        \
     double ezctest_v2 = (double)(val2);                                        \
     if (ezctest_double_eq(ezctest_v1, ezctest_v2, 1e-10)) {                    \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 0,                          \
                                "Expected: %s == %s (double)\n  Actual: %.15g " \
                                "vs %.15g (diff: %.15g)",                       \
@@ -2686,12 +11248,14 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
 
 #define EXPECT_NEAR(val1, val2, epsilon)                                       \
   do {                                                                         \
+    EZCTEST_SITE("EXPECT_NEAR(" #val1 ", " #val2 ", " #epsilon ")");           \
     double ezctest_v1 = (double)(val1);                                        \
     double ezctest_v2 = (double)(val2);                                        \
     double ezctest_eps = (double)(epsilon);                                    \
     if (ezctest_double_eq(ezctest_v1, ezctest_v2, ezctest_eps)) {              \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(                                                \
           __FILE__, __LINE__, 0,                                               \
           "Expected: |%s - %s| <= %s\n  Actual: |%.15g - %.15g| = %.15g "      \
@@ -2703,6 +11267,143 @@ int ezctest_run_all_tests_w(int argc, wchar_t *wargv[]) {
     }                                                                          \
   } while (0)
 
+/* ============================================================================
+ * 宏定义 - EXPECT哈希断言（非致命）
+ * ========================================================================== */
+
+/**
+ * @brief 期望内存块的 XXH64 哈希等于给定的十六进制字符串
+ * @param ptr 数据指针
+ * @param size 数据字节数
+ * @param hex 期望的哈希值，如 "ef46db3751d8e999"
+ *
+ * @details
+ * 适合只保存校验和作为期望值的超大输出。失败时打印实际哈希值，
+ * 便于在确认变更后直接更新期望值。
+ */
+#define EXPECT_HASH_EQ(ptr, size, hex)                                         \
+  do {                                                                         \
+    EZCTEST_SITE("EXPECT_HASH_EQ(" #ptr ", " #size ", " #hex ")");             \
+    char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                          \
+    if (ezctest_hash_check(#ptr, (ptr), (size_t)(size), (hex),                 \
+                           ezctest_msg_buf, EZCTEST_MAX_MESSAGE_LENGTH)) {     \
+      EZCTEST_SITE_PASSED();                                                   \
+    } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_assertion_failed(__FILE__, __LINE__, 0, "%s", ezctest_msg_buf);  \
+    }                                                                          \
+  } while (0)
+
+/**
+ * @brief 期望文件内容的 XXH64 哈希等于给定的十六进制字符串
+ * @param path 文件路径
+ * @param hex 期望的哈希值
+ */
+#define EXPECT_FILE_HASH_EQ(path, hex)                                         \
+  do {                                                                         \
+    EZCTEST_SITE("EXPECT_FILE_HASH_EQ(" #path ", " #hex ")");                  \
+    char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                          \
+    if (ezctest_file_hash_check((path), (hex), ezctest_msg_buf,                \
+                                EZCTEST_MAX_MESSAGE_LENGTH)) {                 \
+      EZCTEST_SITE_PASSED();                                                   \
+    } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_assertion_failed(__FILE__, __LINE__, 0, "%s", ezctest_msg_buf);  \
+    }                                                                          \
+  } while (0)
+
+/* ============================================================================
+ * 宏定义 - EXPECT文件比较断言（非致命）
+ * ========================================================================== */
+
+/**
+ * @brief 期望两个文件内容逐字节相同
+ * @param actual_path 实际输出文件路径
+ * @param golden_path 黄金（期望）文件路径
+ *
+ * @details
+ * 两个文件按窗口映射后分块比较，比较 GB 级文件时常驻内存不会翻倍。
+ * 失败时报告首个差异的字节偏移和行列号。以 --ezctest_update_golden
+ * 运行时改为用实际输出原子地重写黄金文件。
+ */
+#define EXPECT_FILE_EQ(actual_path, golden_path)                               \
+  do {                                                                         \
+    EZCTEST_SITE("EXPECT_FILE_EQ(" #actual_path ", " #golden_path ")");        \
+    char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                          \
+    if (ezctest_file_eq_check((actual_path), (golden_path), ezctest_msg_buf,   \
+                              EZCTEST_MAX_MESSAGE_LENGTH)) {                   \
+      EZCTEST_SITE_PASSED();                                                   \
+    } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_assertion_failed(__FILE__, __LINE__, 0, "%s", ezctest_msg_buf);  \
+    }                                                                          \
+  } while (0)
+
+/**
+ * @brief 期望内存块与黄金文件内容逐字节相同
+ * @param ptr 数据指针
+ * @param size 数据字节数
+ * @param golden_path 黄金文件路径
+ */
+#define EXPECT_BUFFER_MATCHES_GOLDEN(ptr, size, golden_path)                   \
+  do {                                                                         \
+    EZCTEST_SITE("EXPECT_BUFFER_MATCHES_GOLDEN(" #ptr ", " #size ", "          \
+                 #golden_path ")");                                            \
+    char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                          \
+    if (ezctest_golden_check(#ptr, (ptr), (size_t)(size), (golden_path),       \
+                             ezctest_msg_buf, EZCTEST_MAX_MESSAGE_LENGTH)) {   \
+      EZCTEST_SITE_PASSED();                                                   \
+    } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_assertion_failed(__FILE__, __LINE__, 0, "%s", ezctest_msg_buf);  \
+    }                                                                          \
+  } while (0)
+
+/* ============================================================================
+ * 宏定义 - EXPECT性能预算断言（非致命）
+ * ========================================================================== */
+
+/* 内部宏：为紧随其后的代码块建立性能预算作用域（text 为预算表达式文本） */
+#define EZCTEST_PERF_SCOPE(kind, budget, text, runs)                           \
+  for (ezctest_perf_scope_begin((kind), (double)(budget), (runs), 0, __FILE__, \
+                                __LINE__, (text));                             \
+       ezctest_perf_scope_next();)
+
+/**
+ * @brief 期望代码块的墙钟耗时小于 budget 微秒
+ * @param budget 时间预算（微秒）
+ *
+ * @details
+ * 用法：EXPECT_DURATION_LT_US(500) { parse(input); }
+ * 使用单调高精度时钟测量。代码块中不要使用 break/return 跳出。
+ */
+#define EXPECT_DURATION_LT_US(budget)                                          \
+  EZCTEST_PERF_SCOPE(EZCTEST_PERF_WALL, budget, #budget, 1)
+
+/**
+ * @brief 代码块最多运行 runs 次，取最快的一次与预算比较
+ * @details 用于抑制调度、缓存等噪声；某次运行已满足预算时立即结束
+ */
+#define EXPECT_DURATION_LT_US_BEST_OF(budget, runs)                            \
+  EZCTEST_PERF_SCOPE(EZCTEST_PERF_WALL, budget, #budget, runs)
+
+/**
+ * @brief 期望代码块消耗的进程CPU时间小于 budget 微秒
+ */
+#define EXPECT_CPU_TIME_LT_US(budget)                                          \
+  EZCTEST_PERF_SCOPE(EZCTEST_PERF_CPU, budget, #budget, 1)
+
+#define EXPECT_CPU_TIME_LT_US_BEST_OF(budget, runs)                            \
+  EZCTEST_PERF_SCOPE(EZCTEST_PERF_CPU, budget, #budget, runs)
+
+/**
+ * @brief 期望代码块中的内存分配次数不超过 n
+ * @note 需要定义 EZCTEST_ALLOC_HOOKS（glibc 或 MSVC Debug），
+ *       否则只打印提示，不检查预算
+ */
+#define EXPECT_MAX_ALLOCS(n)                                                   \
+  EZCTEST_PERF_SCOPE(EZCTEST_PERF_ALLOCS, n, #n, 1)
+
 /* ============================================================================
  * 类型安全的值格式化辅助宏（C++/C11支持）
  * ========================================================================== */
@@ -2874,13 +11575,15 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_TRUE(condition)                                                 \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_TRUE(" #condition ")");                               \
     if (condition) {                                                           \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 1,                          \
                                "Expected: (%s) is true\n  Actual: false",      \
                                #condition);                                    \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -2889,13 +11592,15 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_FALSE(condition)                                                \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_FALSE(" #condition ")");                              \
     if (!(condition)) {                                                        \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 1,                          \
                                "Expected: (%s) is false\n  Actual: true",      \
                                #condition);                                    \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -2904,14 +11609,16 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_EQ(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_EQ(" #val1 ", " #val2 ")");                           \
     if ((val1) == (val2)) {                                                    \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES("==", val1, val2, ezctest_msg_buf,                 \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 1, "%s", ezctest_msg_buf);  \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -2920,14 +11627,16 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_NE(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_NE(" #val1 ", " #val2 ")");                           \
     if ((val1) != (val2)) {                                                    \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES("!=", val1, val2, ezctest_msg_buf,                 \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 1, "%s", ezctest_msg_buf);  \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -2936,14 +11645,16 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_LT(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_LT(" #val1 ", " #val2 ")");                           \
     if ((val1) < (val2)) {                                                     \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES("<", val1, val2, ezctest_msg_buf,                  \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 1, "%s", ezctest_msg_buf);  \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -2952,14 +11663,16 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_LE(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_LE(" #val1 ", " #val2 ")");                           \
     if ((val1) <= (val2)) {                                                    \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES("<=", val1, val2, ezctest_msg_buf,                 \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 1, "%s", ezctest_msg_buf);  \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -2968,14 +11681,16 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_GT(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_GT(" #val1 ", " #val2 ")");                           \
     if ((val1) > (val2)) {                                                     \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES(">", val1, val2, ezctest_msg_buf,                  \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 1, "%s", ezctest_msg_buf);  \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -2984,14 +11699,16 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_GE(val1, val2)                                                  \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_GE(" #val1 ", " #val2 ")");                           \
     if ((val1) >= (val2)) {                                                    \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
       char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                        \
+      EZCTEST_SITE_FAILED();                                                   \
       EZCTEST_FORMAT_VALUES(">=", val1, val2, ezctest_msg_buf,                 \
                             EZCTEST_MAX_MESSAGE_LENGTH);                       \
       ezctest_assertion_failed(__FILE__, __LINE__, 1, "%s", ezctest_msg_buf);  \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -3000,14 +11717,16 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_STREQ(str1, str2)                                               \
   do {                                                                         \
-    if (strcmp((str1), (str2)) == 0) {                                         \
-      ezctest_assertion_passed();                                              \
+    EZCTEST_SITE("ASSERT_STREQ(" #str1 ", " #str2 ")");                        \
+    const char *ezctest_s1 = (str1);                                           \
+    const char *ezctest_s2 = (str2);                                           \
+    if (strcmp(ezctest_s1, ezctest_s2) == 0) {                                 \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
-      ezctest_assertion_failed(                                                \
-          __FILE__, __LINE__, 1,                                               \
-          "Expected: %s == %s\n  Actual: \"%s\" != \"%s\"", #str1, #str2,      \
-          (str1), (str2));                                                     \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_text_assertion_failed(__FILE__, __LINE__, 1, #str1, #str2,       \
+                                    ezctest_s1, ezctest_s2, 0);                \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -3016,14 +11735,37 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_STRNE(str1, str2)                                               \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_STRNE(" #str1 ", " #str2 ")");                        \
     if (strcmp((str1), (str2)) != 0) {                                         \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(                                                \
           __FILE__, __LINE__, 1,                                               \
           "Expected: %s != %s\n  Actual: both are \"%s\"", #str1, #str2,       \
           (str1));                                                             \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
+        longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
+      }                                                                        \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+/**
+ * @brief 断言两段文本相等，失败时输出 unified diff 并终止测试
+ */
+#define ASSERT_TEXT_EQ(str1, str2)                                             \
+  do {                                                                         \
+    EZCTEST_SITE("ASSERT_TEXT_EQ(" #str1 ", " #str2 ")");                      \
+    const char *ezctest_s1 = (str1);                                           \
+    const char *ezctest_s2 = (str2);                                           \
+    if (strcmp(ezctest_s1, ezctest_s2) == 0) {                                 \
+      EZCTEST_SITE_PASSED();                                                   \
+    } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_text_assertion_failed(__FILE__, __LINE__, 1, #str1, #str2,       \
+                                    ezctest_s1, ezctest_s2, 1);                \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -3032,13 +11774,15 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_NULL(ptr)                                                       \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_NULL(" #ptr ")");                                     \
     if ((ptr) == NULL) {                                                       \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 1,                          \
                                "Expected: %s is NULL\n  Actual: not NULL",     \
                                #ptr);                                          \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -3047,13 +11791,15 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_NOT_NULL(ptr)                                                   \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_NOT_NULL(" #ptr ")");                                 \
     if ((ptr) != NULL) {                                                       \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 1,                          \
                                "Expected: %s is not NULL\n  Actual: NULL",     \
                                #ptr);                                          \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -3066,17 +11812,19 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_FLOAT_EQ(val1, val2)                                            \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_FLOAT_EQ(" #val1 ", " #val2 ")");                     \
     float ezctest_v1 = (float)(val1);                                          \
     float ezctest_v2 = (float)(val2);                                          \
     if (ezctest_float_eq(ezctest_v1, ezctest_v2, 1e-6f)) {                     \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(                                                \
           __FILE__, __LINE__, 1,                                               \
           "Expected: %s == %s (float)\n  Actual: %g vs %g (diff: %g)", #val1,  \
           #val2, (double)ezctest_v1, (double)ezctest_v2,                       \
           (double)(ezctest_v1 - ezctest_v2));                                  \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -3085,17 +11833,19 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_DOUBLE_EQ(val1, val2)                                           \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_DOUBLE_EQ(" #val1 ", " #val2 ")");                    \
     double ezctest_v1 = (double)(val1);                                        \
     double ezctest_v2 = (double)(val2);                                        \
     if (ezctest_double_eq(ezctest_v1, ezctest_v2, 1e-10)) {                    \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 1,                          \
                                "Expected: %s == %s (double)\n  Actual: %.15g " \
                                "vs %.15g (diff: %.15g)",                       \
                                #val1, #val2, ezctest_v1, ezctest_v2,           \
                                (ezctest_v1 - ezctest_v2));                     \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -3104,12 +11854,14 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_NEAR(val1, val2, epsilon)                                       \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_NEAR(" #val1 ", " #val2 ", " #epsilon ")");           \
     double ezctest_v1 = (double)(val1);                                        \
     double ezctest_v2 = (double)(val2);                                        \
     double ezctest_eps = (double)(epsilon);                                    \
     if (ezctest_double_eq(ezctest_v1, ezctest_v2, ezctest_eps)) {              \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(                                                \
           __FILE__, __LINE__, 1,                                               \
           "Expected: |%s - %s| <= %s\n  Actual: |%.15g - %.15g| = %.15g "      \
@@ -3118,7 +11870,7 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
           (ezctest_v1 > ezctest_v2 ? ezctest_v1 - ezctest_v2                   \
                                    : ezctest_v2 - ezctest_v1),                 \
           ezctest_eps);                                                        \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -3127,6 +11879,7 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_EMPTY(ptr, size)                                                \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_EMPTY(" #ptr ", " #size ")");                         \
     int is_empty = 1;                                                          \
     int i;                                                                     \
     for (i = 0; i < (int)size; ++i) {                                          \
@@ -3136,11 +11889,12 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
       }                                                                        \
     }                                                                          \
     if (is_empty) {                                                            \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 1,                          \
                                "Expected: %s is not empty\n", #ptr);           \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
@@ -3149,6 +11903,7 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
 
 #define ASSERT_NOT_EMPTY(ptr, size)                                            \
   do {                                                                         \
+    EZCTEST_SITE("ASSERT_NOT_EMPTY(" #ptr ", " #size ")");                     \
     int is_empty = 1;                                                          \
     int i;                                                                     \
     for (i = 0; i < (int)size; ++i) {                                          \
@@ -3158,17 +11913,128 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
       }                                                                        \
     }                                                                          \
     if (!is_empty) {                                                           \
-      ezctest_assertion_passed();                                              \
+      EZCTEST_SITE_PASSED();                                                   \
     } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
       ezctest_assertion_failed(__FILE__, __LINE__, 1,                          \
                                "Expected: %s is empty\n", #ptr);               \
-      if (g_ezctest_longjmp_ctx.has_jumped) {                                  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
+        longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
+      }                                                                        \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+/* ============================================================================
+ * 宏定义 - ASSERT哈希断言（致命）
+ * ========================================================================== */
+
+#define ASSERT_HASH_EQ(ptr, size, hex)                                         \
+  do {                                                                         \
+    EZCTEST_SITE("ASSERT_HASH_EQ(" #ptr ", " #size ", " #hex ")");             \
+    char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                          \
+    if (ezctest_hash_check(#ptr, (ptr), (size_t)(size), (hex),                 \
+                           ezctest_msg_buf, EZCTEST_MAX_MESSAGE_LENGTH)) {     \
+      EZCTEST_SITE_PASSED();                                                   \
+    } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_assertion_failed(__FILE__, __LINE__, 1, "%s", ezctest_msg_buf);  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
+        longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
+      }                                                                        \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+#define ASSERT_FILE_HASH_EQ(path, hex)                                         \
+  do {                                                                         \
+    EZCTEST_SITE("ASSERT_FILE_HASH_EQ(" #path ", " #hex ")");                  \
+    char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                          \
+    if (ezctest_file_hash_check((path), (hex), ezctest_msg_buf,                \
+                                EZCTEST_MAX_MESSAGE_LENGTH)) {                 \
+      EZCTEST_SITE_PASSED();                                                   \
+    } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_assertion_failed(__FILE__, __LINE__, 1, "%s", ezctest_msg_buf);  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
         longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
       }                                                                        \
       return;                                                                  \
     }                                                                          \
   } while (0)
 
+/* ============================================================================
+ * 宏定义 - ASSERT文件比较断言（致命）
+ * ========================================================================== */
+
+#define ASSERT_FILE_EQ(actual_path, golden_path)                               \
+  do {                                                                         \
+    EZCTEST_SITE("ASSERT_FILE_EQ(" #actual_path ", " #golden_path ")");        \
+    char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                          \
+    if (ezctest_file_eq_check((actual_path), (golden_path), ezctest_msg_buf,   \
+                              EZCTEST_MAX_MESSAGE_LENGTH)) {                   \
+      EZCTEST_SITE_PASSED();                                                   \
+    } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_assertion_failed(__FILE__, __LINE__, 1, "%s", ezctest_msg_buf);  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
+        longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
+      }                                                                        \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+#define ASSERT_BUFFER_MATCHES_GOLDEN(ptr, size, golden_path)                   \
+  do {                                                                         \
+    EZCTEST_SITE("ASSERT_BUFFER_MATCHES_GOLDEN(" #ptr ", " #size ", "          \
+                 #golden_path ")");                                            \
+    char ezctest_msg_buf[EZCTEST_MAX_MESSAGE_LENGTH];                          \
+    if (ezctest_golden_check(#ptr, (ptr), (size_t)(size), (golden_path),       \
+                             ezctest_msg_buf, EZCTEST_MAX_MESSAGE_LENGTH)) {   \
+      EZCTEST_SITE_PASSED();                                                   \
+    } else {                                                                   \
+      EZCTEST_SITE_FAILED();                                                   \
+      ezctest_assertion_failed(__FILE__, __LINE__, 1, "%s", ezctest_msg_buf);  \
+      if (EZCTEST_CAN_LONGJMP()) {                                             \
+        longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                             \
+      }                                                                        \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+/* ============================================================================
+ * 宏定义 - ASSERT性能预算断言（致命）
+ * ========================================================================== */
+
+/* 内部宏：超出预算时在代码块结束后返回 */
+#define EZCTEST_PERF_SCOPE_FATAL(kind, budget, text, runs)                     \
+  for (ezctest_perf_scope_begin((kind), (double)(budget), (runs), 1, __FILE__, \
+                                __LINE__, (text));;)                           \
+    if (!ezctest_perf_scope_next()) {                                          \
+      if (ezctest_perf_scope_failed()) {                                       \
+        if (EZCTEST_CAN_LONGJMP()) {                                           \
+          longjmp(g_ezctest_longjmp_ctx.jmp_env, 1);                           \
+        }                                                                      \
+        return;                                                                \
+      }                                                                        \
+      break;                                                                   \
+    } else
+
+#define ASSERT_DURATION_LT_US(budget)                                          \
+  EZCTEST_PERF_SCOPE_FATAL(EZCTEST_PERF_WALL, budget, #budget, 1)
+
+#define ASSERT_DURATION_LT_US_BEST_OF(budget, runs)                            \
+  EZCTEST_PERF_SCOPE_FATAL(EZCTEST_PERF_WALL, budget, #budget, runs)
+
+#define ASSERT_CPU_TIME_LT_US(budget)                                          \
+  EZCTEST_PERF_SCOPE_FATAL(EZCTEST_PERF_CPU, budget, #budget, 1)
+
+#define ASSERT_CPU_TIME_LT_US_BEST_OF(budget, runs)                            \
+  EZCTEST_PERF_SCOPE_FATAL(EZCTEST_PERF_CPU, budget, #budget, runs)
+
+#define ASSERT_MAX_ALLOCS(n)                                                   \
+  EZCTEST_PERF_SCOPE_FATAL(EZCTEST_PERF_ALLOCS, n, #n, 1)
+
 /* ============================================================================
  * Setup/Teardown 和 DEFER 宏
  * ========================================================================== */
@@ -3272,6 +12138,202 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
   static void ezctest_teardown_##suite_name##_func(void)
 #endif
 
+/**
+ * @brief 定义测试套件的一次性Setup函数
+ * @param suite_name 测试套件名称
+ *
+ * @details
+ * SETUP_SUITE在套件的第一个测试之前执行一次，用于准备昂贵的共享资源；
+ * 执行计划保证同一套件的测试连续运行（--ezctest_shuffle 也只在套件内部
+ * 和套件之间打乱）。进程隔离时由父进程执行，各测试的子进程继承其结果
+ * （Windows 的子进程各自执行一次）。失败时跳过该套件的全部测试。
+ * 每个测试的SETUP/TEARDOWN照常执行。其中注册的 DEFER 不会被测试执行，
+ * 在套件结束、TEARDOWN_SUITE 之后执行。
+ *
+ * 使用示例：
+ * @code
+ * SETUP_SUITE(DatabaseTest) {
+ *     g_dataset = load_dataset("big.db");
+ * }
+ * @endcode
+ */
+#if defined(_MSC_VER)
+/* MSVC: 使用内存扫描机制 */
+#define SETUP_SUITE(suite_name)                                                \
+  static void ezctest_suite_setup_##suite_name##_func(void);                   \
+  static const ezctest_fixture_metadata_t                                      \
+      ezctest_suite_setup_##suite_name##_meta =                                \
+      {EZCTEST_FIXTURE_MAGIC, #suite_name,                                     \
+       ezctest_suite_setup_##suite_name##_func, NULL, 2};                      \
+  static volatile const void *ezctest_keep_suite_setup_##suite_name##_meta =   \
+      &ezctest_suite_setup_##suite_name##_meta;                                \
+  static void ezctest_suite_setup_##suite_name##_func(void)
+#elif defined(EZCTEST_GCC_NO_CONSTRUCTOR)
+/* 老版本GCC: 使用.ctors段 */
+#define SETUP_SUITE(suite_name)                                                \
+  static void ezctest_suite_setup_##suite_name##_func(void);                   \
+  static void ezctest_suite_setup_##suite_name##_init(void) {                  \
+    ezctest_register_suite_setup(#suite_name,                                  \
+        ezctest_suite_setup_##suite_name##_func);                              \
+  }                                                                            \
+  static void (*ezctest_suite_setup_##suite_name##_ctor_ptr)(void)             \
+      __attribute__((section(".ctors"), used)) =                               \
+          ezctest_suite_setup_##suite_name##_init;                             \
+  static void ezctest_suite_setup_##suite_name##_func(void)
+#else
+/* 现代GCC/Clang: 使用constructor属性 */
+#define SETUP_SUITE(suite_name)                                                \
+  static void ezctest_suite_setup_##suite_name##_func(void);                   \
+  static void __attribute__((constructor))                                     \
+  ezctest_suite_setup_##suite_name##_init(void) {                              \
+    ezctest_register_suite_setup(#suite_name,                                  \
+        ezctest_suite_setup_##suite_name##_func);                              \
+  }                                                                            \
+  static void ezctest_suite_setup_##suite_name##_func(void)
+#endif
+
+/**
+ * @brief 定义测试套件的一次性Teardown函数
+ * @param suite_name 测试套件名称
+ *
+ * @details
+ * TEARDOWN_SUITE在套件的最后一个测试之后执行一次，SETUP_SUITE失败时也执行。
+ *
+ * 使用示例：
+ * @code
+ * TEARDOWN_SUITE(DatabaseTest) {
+ *     free_dataset(g_dataset);
+ * }
+ * @endcode
+ */
+#if defined(_MSC_VER)
+/* MSVC: 使用内存扫描机制 */
+#define TEARDOWN_SUITE(suite_name)                                             \
+  static void ezctest_suite_teardown_##suite_name##_func(void);                \
+  static const ezctest_fixture_metadata_t                                      \
+      ezctest_suite_teardown_##suite_name##_meta =                             \
+      {EZCTEST_FIXTURE_MAGIC, #suite_name,                                     \
+       NULL, ezctest_suite_teardown_##suite_name##_func, 3};                   \
+  static volatile const void                                                   \
+      *ezctest_keep_suite_teardown_##suite_name##_meta =                       \
+          &ezctest_suite_teardown_##suite_name##_meta;                         \
+  static void ezctest_suite_teardown_##suite_name##_func(void)
+#elif defined(EZCTEST_GCC_NO_CONSTRUCTOR)
+/* 老版本GCC: 使用.ctors段 */
+#define TEARDOWN_SUITE(suite_name)                                             \
+  static void ezctest_suite_teardown_##suite_name##_func(void);                \
+  static void ezctest_suite_teardown_##suite_name##_init(void) {               \
+    ezctest_register_suite_teardown(#suite_name,                               \
+        ezctest_suite_teardown_##suite_name##_func);                           \
+  }                                                                            \
+  static void (*ezctest_suite_teardown_##suite_name##_ctor_ptr)(void)          \
+      __attribute__((section(".ctors"), used)) =                               \
+          ezctest_suite_teardown_##suite_name##_init;                          \
+  static void ezctest_suite_teardown_##suite_name##_func(void)
+#else
+/* 现代GCC/Clang: 使用constructor属性 */
+#define TEARDOWN_SUITE(suite_name)                                             \
+  static void ezctest_suite_teardown_##suite_name##_func(void);                \
+  static void __attribute__((constructor))                                     \
+  ezctest_suite_teardown_##suite_name##_init(void) {                           \
+    ezctest_register_suite_teardown(#suite_name,                               \
+        ezctest_suite_teardown_##suite_name##_func);                           \
+  }                                                                            \
+  static void ezctest_suite_teardown_##suite_name##_func(void)
+#endif
+
+/**
+ * @brief 定义进程级的全局Setup函数
+ *
+ * @details
+ * GLOBAL_SETUP在第一个测试之前、第一次 fork 之前执行一次，适合加载模型、
+ * 构建查找表等进程级初始化；隔离的子进程通过写时复制直接继承结果
+ * （Windows 的子进程各自执行一次）。失败时不运行任何测试，执行
+ * GLOBAL_TEARDOWN 后返回失败。每个源文件可以定义一个，按注册顺序执行。
+ * 其中注册的 DEFER 在全部 GLOBAL_TEARDOWN 之后执行。
+ *
+ * 使用示例：
+ * @code
+ * GLOBAL_SETUP() {
+ *     g_model = load_model("model.bin");
+ *     ASSERT_NOT_NULL(g_model);
+ * }
+ * @endcode
+ */
+#if defined(_MSC_VER)
+/* MSVC: 使用内存扫描机制 */
+#define GLOBAL_SETUP()                                                         \
+  static void ezctest_global_setup_func(void);                                 \
+  static const ezctest_fixture_metadata_t ezctest_global_setup_meta = {        \
+      EZCTEST_FIXTURE_MAGIC, "(global)", ezctest_global_setup_func, NULL, 4};  \
+  static volatile const void *ezctest_keep_global_setup_meta =                 \
+      &ezctest_global_setup_meta;                                              \
+  static void ezctest_global_setup_func(void)
+#elif defined(EZCTEST_GCC_NO_CONSTRUCTOR)
+/* 老版本GCC: 使用.ctors段 */
+#define GLOBAL_SETUP()                                                         \
+  static void ezctest_global_setup_func(void);                                 \
+  static void ezctest_global_setup_init(void) {                                \
+    ezctest_register_global_setup(ezctest_global_setup_func);                  \
+  }                                                                            \
+  static void (*ezctest_global_setup_ctor_ptr)(void)                           \
+      __attribute__((section(".ctors"), used)) = ezctest_global_setup_init;    \
+  static void ezctest_global_setup_func(void)
+#else
+/* 现代GCC/Clang: 使用constructor属性 */
+#define GLOBAL_SETUP()                                                         \
+  static void ezctest_global_setup_func(void);                                 \
+  static void __attribute__((constructor)) ezctest_global_setup_init(void) {   \
+    ezctest_register_global_setup(ezctest_global_setup_func);                  \
+  }                                                                            \
+  static void ezctest_global_setup_func(void)
+#endif
+
+/**
+ * @brief 定义进程级的全局Teardown函数
+ *
+ * @details
+ * GLOBAL_TEARDOWN在全部测试之后执行一次（按注册的逆序），
+ * GLOBAL_SETUP 失败时也执行。
+ *
+ * 使用示例：
+ * @code
+ * GLOBAL_TEARDOWN() {
+ *     free_model(g_model);
+ * }
+ * @endcode
+ */
+#if defined(_MSC_VER)
+/* MSVC: 使用内存扫描机制 */
+#define GLOBAL_TEARDOWN()                                                      \
+  static void ezctest_global_teardown_func(void);                              \
+  static const ezctest_fixture_metadata_t ezctest_global_teardown_meta = {     \
+      EZCTEST_FIXTURE_MAGIC, "(global)", NULL,                                 \
+      ezctest_global_teardown_func, 5};                                        \
+  static volatile const void *ezctest_keep_global_teardown_meta =              \
+      &ezctest_global_teardown_meta;                                           \
+  static void ezctest_global_teardown_func(void)
+#elif defined(EZCTEST_GCC_NO_CONSTRUCTOR)
+/* 老版本GCC: 使用.ctors段 */
+#define GLOBAL_TEARDOWN()                                                      \
+  static void ezctest_global_teardown_func(void);                              \
+  static void ezctest_global_teardown_init(void) {                             \
+    ezctest_register_global_teardown(ezctest_global_teardown_func);            \
+  }                                                                            \
+  static void (*ezctest_global_teardown_ctor_ptr)(void)                        \
+      __attribute__((section(".ctors"), used)) = ezctest_global_teardown_init; \
+  static void ezctest_global_teardown_func(void)
+#else
+/* 现代GCC/Clang: 使用constructor属性 */
+#define GLOBAL_TEARDOWN()                                                      \
+  static void ezctest_global_teardown_func(void);                              \
+  static void __attribute__((constructor))                                     \
+  ezctest_global_teardown_init(void) {                                         \
+    ezctest_register_global_teardown(ezctest_global_teardown_func);            \
+  }                                                                            \
+  static void ezctest_global_teardown_func(void)
+#endif
+
 /**
  * @brief 注册DEFER清理回调
  * @param func 清理函数指针
@@ -3304,6 +12366,35 @@ static inline const void *ezctest_vcast_ptr(const void *p) { return p; }
     }                                                                          \
   } while (0)
 
+/**
+ * @brief DEFER作用域：作用域内注册的清理回调在 DEFER_SCOPE_END 处提前执行
+ *
+ * @details
+ * 循环体中反复注册的 DEFER 不必堆到测试结束；作用域可以嵌套
+ * （最多 EZCTEST_DEFER_MAX_SCOPES 层，宏不声明局部变量，嵌套不触发 -Wshadow）。
+ * BEGIN 和 END 必须成对出现在同一代码块中（BEGIN 打开一个花括号块）。
+ * 用 break/continue/return 或 ASSERT 失败离开作用域时跳过了 END，
+ * 外层的 END 只执行到被跳过作用域的起点，其余回调在测试结束时执行。
+ *
+ * 使用示例：
+ * @code
+ * for (i = 0; i < 10000; i++) {
+ *     DEFER_SCOPE_BEGIN
+ *     char *item = make_item(i);
+ *     DEFER(free, item);
+ *     EXPECT_TRUE(check_item(item));
+ *     DEFER_SCOPE_END  // 这里释放 item
+ * }
+ * @endcode
+ */
+#define DEFER_SCOPE_BEGIN                                                      \
+  {                                                                            \
+    ezctest_defer_scope_begin();
+
+#define DEFER_SCOPE_END                                                        \
+  ezctest_defer_scope_end();                                                   \
+  }
+
 /* ============================================================================
  * 主入口宏
  * ========================================================================== */
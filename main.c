@@ -6,12 +6,16 @@
 
 /* 定义实现宏，必须在某个.c文件中定义一次 */
 #define EZCTEST_IMPLEMENTATION
+/* 启用分配计数（EXPECT_MAX_ALLOCS），glibc 和 MSVC Debug 下生效 */
+#define EZCTEST_ALLOC_HOOKS
 #include "ezctest.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #if !defined(_WIN32)
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #endif
 
@@ -51,6 +55,11 @@ static void cleanup_file(void *ptr) {
     }
 }
 
+/* 辅助函数：用于演示 DEFER 删除临时文件 */
+static void cleanup_remove_file(void *path) {
+    remove((const char *)path);
+}
+
 /* ============================================================================
  * 基础断言测试 - EXPECT 系列（非致命）
  * ========================================================================== */
@@ -127,6 +136,15 @@ TEST(StringAssertions, ExpectStrNE) {
     EXPECT_STRNE("test", "demo");
 }
 
+TEST(StringAssertions, ExpectTextEQ) {
+    /* EXPECT_TEXT_EQ: 期望两段（多行）文本相等，失败时输出 unified diff */
+    const char *expected = "line 1\nline 2\nline 3\n";
+    char actual[64];
+    SAFE_STRCPY(actual, sizeof(actual), "line 1\nline 2\nline 3\n");
+    EXPECT_TEXT_EQ(actual, expected);
+    ASSERT_TEXT_EQ("", "");
+}
+
 /* ============================================================================
  * 指针断言测试
  * ========================================================================== */
@@ -163,6 +181,128 @@ TEST(MemoryAssertions, ExpectNotEmpty) {
     EXPECT_NOT_EMPTY(buffer, sizeof(buffer));
 }
 
+/* ============================================================================
+ * 哈希断言测试
+ * ========================================================================== */
+
+TEST(HashAssertions, ExpectHashEQ) {
+    /* EXPECT_HASH_EQ: 期望内存块的 XXH64 等于给定值（与 xxh64sum 一致） */
+    const char *text = "Nobody inspects the spammish repetition";
+    EXPECT_HASH_EQ("", 0, "ef46db3751d8e999");
+    EXPECT_HASH_EQ("abc", 3, "0x44BC2CF5AD770999");
+    ASSERT_HASH_EQ(text, strlen(text), "fbcea83c8a378bf1");
+}
+
+TEST(HashAssertions, ExpectFileHashEQ) {
+    /* EXPECT_FILE_HASH_EQ: 流式计算文件内容的 XXH64 */
+    FILE *fp;
+    SAFE_FOPEN(fp, "test_hash.txt", "wb");
+    ASSERT_NOT_NULL(fp);
+    fputs("abc", fp);
+    fclose(fp);
+    DEFER(cleanup_remove_file, "test_hash.txt");
+    EXPECT_FILE_HASH_EQ("test_hash.txt", "44bc2cf5ad770999");
+}
+
+/* ============================================================================
+ * 文件比较断言测试
+ * ========================================================================== */
+
+static void write_text_file(const char *path, const char *text) {
+    FILE *fp;
+    SAFE_FOPEN(fp, path, "wb");
+    if (fp != NULL) {
+        fputs(text, fp);
+        fclose(fp);
+    }
+}
+
+TEST(FileAssertions, ExpectFileEQ) {
+    /* EXPECT_FILE_EQ: 期望两个文件逐字节相同（按窗口映射，不复制到堆上） */
+    write_text_file("test_actual.txt", "line 1\nline 2\n");
+    DEFER(cleanup_remove_file, "test_actual.txt");
+    write_text_file("test_golden.txt", "line 1\nline 2\n");
+    DEFER(cleanup_remove_file, "test_golden.txt");
+    EXPECT_FILE_EQ("test_actual.txt", "test_golden.txt");
+}
+
+TEST(FileAssertions, ExpectBufferMatchesGolden) {
+    /* EXPECT_BUFFER_MATCHES_GOLDEN: 期望内存块与黄金文件内容相同 */
+    const char *output = "{\"name\": \"ezctest\"}\n";
+    write_text_file("test_golden.json", output);
+    DEFER(cleanup_remove_file, "test_golden.json");
+    ASSERT_BUFFER_MATCHES_GOLDEN(output, strlen(output), "test_golden.json");
+}
+
+/* ============================================================================
+ * 性能预算断言测试
+ * ========================================================================== */
+
+TEST(PerfAssertions, ExpectDurationLtUs) {
+    /* EXPECT_DURATION_LT_US: 期望代码块的墙钟耗时小于预算（微秒） */
+    volatile unsigned long sum = 0;
+    int i;
+
+    EXPECT_DURATION_LT_US(100000) {
+        for (i = 0; i < 1000; i++) {
+            sum += (unsigned long)i;
+        }
+    }
+
+    /* _BEST_OF: 最多运行3次，取最快的一次，抑制偶发噪声 */
+    EXPECT_DURATION_LT_US_BEST_OF(100000, 3) {
+        for (i = 0; i < 1000; i++) {
+            sum += (unsigned long)i;
+        }
+    }
+
+    /* EXPECT_CPU_TIME_LT_US: 期望代码块消耗的CPU时间小于预算 */
+    EXPECT_CPU_TIME_LT_US(100000) {
+        for (i = 0; i < 1000; i++) {
+            sum += (unsigned long)i;
+        }
+    }
+}
+
+TEST(PerfAssertions, ExpectMaxAllocs) {
+    /* EXPECT_MAX_ALLOCS: 期望代码块中的内存分配次数不超过 n */
+    char buffer[64];
+    char *p = NULL;
+
+    EXPECT_MAX_ALLOCS(0) {
+        memset(buffer, 0, sizeof(buffer));
+    }
+    ASSERT_MAX_ALLOCS(1) {
+        p = (char *)malloc(sizeof(buffer));
+    }
+    free(p);
+}
+
+TEST(PerfAssertions, AllocStats) {
+    /* ezctest_alloc_begin/end: 统计一段代码的分配次数、字节数和峰值 */
+    ezctest_alloc_stats_t stats;
+    char *a;
+    char *b;
+
+    if (!ezctest_alloc_tracking()) {
+        return; /* 当前平台无法拦截分配 */
+    }
+    ezctest_alloc_begin(&stats);
+    a = (char *)malloc(100);
+    b = (char *)malloc(200);
+    /* 防止编译器把成对的 malloc/free 整体删除 */
+    EZCTEST_DO_NOT_OPTIMIZE(a);
+    EZCTEST_DO_NOT_OPTIMIZE(b);
+    free(a);
+    free(b);
+    ezctest_alloc_end(&stats);
+
+    EXPECT_EQ(stats.allocs, 2ul);
+    EXPECT_EQ((unsigned long)stats.bytes, 300ul);
+    /* 峰值按块的实际大小计，不小于同时存活的请求字节数 */
+    EXPECT_GE((unsigned long)stats.peak, 300ul);
+}
+
 /* ============================================================================
  * 浮点数断言测试
  * ========================================================================== */
@@ -336,6 +476,112 @@ TEST(FixtureDemo, TestWithSetup3) {
     //printf("  测试 3 修改了数据，但不影响其他测试\n");
 }
 
+/* 昂贵的 SETUP：用来对比有无 --ezctest_fork_template 时的总耗时，例如
+ *   time ./test --ezctest_filter=TemplateDemo.*
+ *   time ./test --ezctest_filter=TemplateDemo.* --ezctest_fork_template
+ * 前者每个隔离子进程都重新执行 SETUP，后者只在模板进程中执行一次 */
+#define TEMPLATE_FIXTURE_INTS (1024 * 1024)
+
+static unsigned int *g_template_table = NULL;
+
+SETUP(TemplateDemo) {
+    unsigned int h = 2166136261u;
+    int i;
+
+    g_template_table =
+        (unsigned int *)malloc(sizeof(unsigned int) * TEMPLATE_FIXTURE_INTS);
+    for (i = 0; g_template_table != NULL && i < TEMPLATE_FIXTURE_INTS; i++) {
+        h = (h ^ (unsigned int)i) * 16777619u;
+        g_template_table[i] = h;
+    }
+}
+
+TEARDOWN(TemplateDemo) {
+    free(g_template_table);
+    g_template_table = NULL;
+}
+
+/* 每个测试都先检查拿到的是 SETUP 之后的原始数据，再修改它；
+ * 无论从模板 fork 还是重新 SETUP，修改都不能影响后面的测试 */
+static void check_template_pristine(void) {
+    ASSERT_NOT_NULL(g_template_table);
+    EXPECT_EQ(g_template_table[0], 2166136261u * 16777619u);
+    EXPECT_NE(g_template_table[TEMPLATE_FIXTURE_INTS - 1], 0u);
+    g_template_table[0] = 0;
+}
+
+TEST(TemplateDemo, First) {
+    check_template_pristine();
+}
+
+TEST(TemplateDemo, Second) {
+    check_template_pristine();
+}
+
+TEST(TemplateDemo, Third) {
+    check_template_pristine();
+}
+
+/* GLOBAL_SETUP/GLOBAL_TEARDOWN: 整个进程只执行一次，在第一次 fork 之前 */
+static unsigned char g_popcount_table[256];
+static int g_global_setup_count = 0;
+
+GLOBAL_SETUP() {
+    int i;
+    /* 进程级的查找表：隔离的子进程写时复制继承，不必各自重建 */
+    for (i = 0; i < 256; i++) {
+        g_popcount_table[i] =
+            (unsigned char)((i & 1) + g_popcount_table[i / 2]);
+    }
+    g_global_setup_count++;
+}
+
+GLOBAL_TEARDOWN() {
+    memset(g_popcount_table, 0, sizeof(g_popcount_table));
+}
+
+TEST(GlobalFixtureDemo, UsesLookupTable) {
+    EXPECT_EQ(g_global_setup_count, 1);
+    EXPECT_EQ(g_popcount_table[0xFF], 8);
+    EXPECT_EQ(g_popcount_table[0x81], 2);
+}
+
+/* SETUP_SUITE/TEARDOWN_SUITE: 在整个套件前后各执行一次
+ * （--ezctest_repeat 的每一轮都会重新执行，计数在 TEARDOWN_SUITE 中归零）；
+ * SETUP_SUITE 中注册的 DEFER 在 TEARDOWN_SUITE 之后执行 */
+static int *g_suite_table = NULL;
+static int g_suite_setup_count = 0;
+
+SETUP_SUITE(SuiteFixtureDemo) {
+    int i;
+    /* 昂贵的共享资源只准备一次 */
+    g_suite_table = (int *)malloc(1000 * sizeof(int));
+    ASSERT_NOT_NULL(g_suite_table);
+    DEFER(free, g_suite_table);
+    for (i = 0; i < 1000; i++) {
+        g_suite_table[i] = i * i;
+    }
+    g_suite_setup_count++;
+}
+
+TEARDOWN_SUITE(SuiteFixtureDemo) {
+    g_suite_table = NULL;
+    g_suite_setup_count = 0;
+}
+
+TEST(SuiteFixtureDemo, UsesSharedTable) {
+    ASSERT_NOT_NULL(g_suite_table);
+    EXPECT_EQ(g_suite_setup_count, 1);
+    EXPECT_EQ(g_suite_table[30], 900);
+}
+
+TEST(SuiteFixtureDemo, SetupRanOnce) {
+    /* 即使 --ezctest_shuffle，套件内的测试也连续执行 */
+    ASSERT_NOT_NULL(g_suite_table);
+    EXPECT_EQ(g_suite_setup_count, 1);
+    EXPECT_EQ(g_suite_table[999], 998001);
+}
+
 /* ============================================================================
  * DEFER 清理机制测试（类似 Go 的 defer）
  * ========================================================================== */
@@ -419,6 +665,109 @@ TEST(DeferDemo, DeferWithAssertFailure) {
     /* 清理函数会在测试结束时执行 */
 }
 
+/* 辅助函数：记录清理回调的执行顺序 */
+static int g_defer_order[2000];
+static int g_defer_ran = 0;
+
+static void record_cleanup(void *data) {
+    g_defer_order[g_defer_ran++] = (int)(size_t)data;
+}
+
+TEST(DeferDemo, ManyDefers) {
+    /* 超出内联容量的 DEFER 自动分块扩展，不会丢失 */
+    int i;
+
+    g_defer_ran = 0;
+    DEFER_SCOPE_BEGIN
+    for (i = 0; i < 2000; i++) {
+        DEFER(record_cleanup, (size_t)i);
+    }
+    DEFER_SCOPE_END
+
+    ASSERT_EQ(g_defer_ran, 2000);
+    EXPECT_EQ(g_defer_order[0], 1999);  /* LIFO */
+    EXPECT_EQ(g_defer_order[1999], 0);
+}
+
+TEST(DeferDemo, ScopedDefer) {
+    /* DEFER_SCOPE_BEGIN/END: 循环体内的清理在每轮结束时执行，可以嵌套 */
+    int i;
+
+    g_defer_ran = 0;
+    for (i = 0; i < 3; i++) {
+        DEFER_SCOPE_BEGIN
+        char *item = (char *)malloc(16);
+        ASSERT_NOT_NULL(item);
+        DEFER(cleanup_buffer, item);
+        DEFER(record_cleanup, (size_t)(i * 10));
+
+        DEFER_SCOPE_BEGIN
+        DEFER(record_cleanup, (size_t)(i * 10 + 1));
+        DEFER_SCOPE_END  /* 内层先执行 */
+
+        EXPECT_EQ(g_defer_ran, i * 2 + 1);
+        DEFER_SCOPE_END  /* 释放 item */
+    }
+    EXPECT_EQ(g_defer_ran, 6);
+    EXPECT_EQ(g_defer_order[0], 1);
+    EXPECT_EQ(g_defer_order[1], 0);
+}
+
+TEST(DeferDemo, ArenaAlloc) {
+    /* 测试内存池：不需要 free/DEFER，测试结束统一回收 */
+    int i;
+    int *values = EZCTEST_ALLOC(int, 1000);
+    double *aligned = (double *)ezctest_arena_alloc_aligned(64, 64);
+    char *big = EZCTEST_ALLOC(char, 256 * 1024);  /* 超过块大小也可以 */
+
+    ASSERT_NOT_NULL(values);
+    ASSERT_NOT_NULL(aligned);
+    ASSERT_NOT_NULL(big);
+    EXPECT_EQ((size_t)values % EZCTEST_ARENA_ALIGN, 0);
+    EXPECT_EQ((size_t)aligned % 64, 0);
+
+    for (i = 0; i < 1000; i++) {
+        values[i] = i;
+    }
+    big[256 * 1024 - 1] = 'x';
+    EXPECT_EQ(values[999], 999);
+    EXPECT_EQ(big[256 * 1024 - 1], 'x');
+}
+
+TEST(DeferDemo, GuardedAlloc) {
+    /* 数据紧贴保护页：越过末尾（或开头）的第一个字节就会崩溃 */
+    char *tail = (char *)ezctest_guarded_alloc(6);
+    char *head = (char *)ezctest_guarded_alloc_underflow(6);
+
+    ASSERT_NOT_NULL(tail);
+    ASSERT_NOT_NULL(head);
+    memcpy(tail, "hello", 6);  /* 恰好写满，包括结尾的 '\0' */
+    memcpy(head, tail, 6);
+    EXPECT_STREQ(head, "hello");
+}
+
+TEST(DeferDemo, ResourceLimit) {
+    /* 只收紧本测试的隔离子进程；超出时报告 "exceeded RLIMIT_NOFILE ..." */
+    FILE *fp;
+
+#if !defined(_WIN32)
+    /* 不隔离时限制不会生效（会限制整个测试进程），只在隔离子进程中检查 */
+    if (g_ezctest_worker_index >= 0) {
+        struct rlimit rl;
+
+        ASSERT_EQ(TEST_LIMIT_FDS(64), 1);
+        ASSERT_EQ(TEST_LIMIT_CPU(10), 1);
+        ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &rl), 0);
+        EXPECT_EQ((long)rl.rlim_cur, 64L);
+    }
+#endif
+
+    SAFE_FOPEN(fp, "test_limit.txt", "w");
+    ASSERT_NOT_NULL(fp);
+    DEFER(cleanup_file, fp);
+    EXPECT_NE(fputc('x', fp), EOF);
+}
+
 /* ============================================================================
  * EXPECT vs ASSERT 区别演示
  * ========================================================================== */
@@ -602,6 +951,9 @@ TEST(FailureDemo, ExpectFailure) {
     // 故意失败的 EXPECT 测试
     EXPECT_EQ(1, 2);  // 这会失败但继续
     EXPECT_TRUE(0);   // 这也会失败但继续
+    EXPECT_TEXT_EQ("a\nb\nc\n", "a\nB\nc\n");  // 输出 unified diff
+    EXPECT_FILE_EQ("main.c", "main.cpp");  // 输出首个差异的偏移和行列号
+    EXPECT_MAX_ALLOCS(0) { free(malloc(1)); }  // 输出实际分配次数
     //printf("  即使失败，测试也会继续到这里\n");
 }
 
@@ -611,8 +963,200 @@ TEST(FailureDemo, AssertFailure) {
     ASSERT_EQ(1, 2);  // 这会失败并立即停止
     //printf("  这行永远不会输出\n");
 }
+
+TEST(FailureDemo, LeakCheck) {
+    // 忘记 DEFER(cleanup_buffer, buffer)：--ezctest_leak_check 时报告
+    // 泄漏的字节数、块数和分配处的调用栈，并让测试失败
+    char *buffer = (char *)malloc(32);
+    EXPECT_NOT_NULL(buffer);
+}
+
+TEST(FailureDemo, GuardedOverrun) {
+    // 多写一个结尾的 '\0'：报告
+    // "Reason: overrun of guarded allocation 5 bytes at offset 5"
+    char *name = (char *)ezctest_guarded_alloc(5);
+    strcpy(name, "hello");
+}
 */
 
+/* ============================================================================
+ * 基准测试示例（只在 --benchmarks 时运行）
+ * ========================================================================== */
+
+BENCHMARK(StringBench, Strlen) {
+    /* BENCHMARK_LOOP 之外的准备工作不计时 */
+    char text[] = "The quick brown fox jumps over the lazy dog";
+    char *p = text;
+
+    /* 让 text 逃逸，否则 strlen 会在编译期算出常量 */
+    EZCTEST_DO_NOT_OPTIMIZE(p);
+    BENCHMARK_LOOP(state) {
+        size_t len = strlen(text);
+        EZCTEST_DO_NOT_OPTIMIZE(len);
+    }
+}
+
+BENCHMARK(StringBench, Memcpy64) {
+    char src[64];
+    char dst[64];
+    char *p = dst;
+
+    memset(src, 'x', sizeof(src));
+    EZCTEST_DO_NOT_OPTIMIZE(p);
+    BENCHMARK_LOOP(state) {
+        memcpy(dst, src, sizeof(dst));
+        /* dst 的写入必须真正发生 */
+        EZCTEST_CLOBBER_MEMORY();
+    }
+}
+
+/* 在 state->range 个有序整数中查找（找不到），时间随规模增长 */
+static int *make_sorted_ints(unsigned long n) {
+    int *data = (int *)malloc(sizeof(int) * (n ? n : 1));
+    unsigned long i;
+
+    for (i = 0; data != NULL && i < n; i++) {
+        data[i] = (int)(i * 2);
+    }
+    return data;
+}
+
+BENCHMARK_RANGE(SearchBench, Linear, 64, 4096, 4) {
+    unsigned long n = state->range;
+    int *data = make_sorted_ints(n);
+    int key = -1;
+
+    ASSERT_TRUE(data != NULL);
+    EXPECT_COMPLEXITY(state, EZCTEST_O_N);
+    EZCTEST_DO_NOT_OPTIMIZE(data);
+    BENCHMARK_LOOP(state) {
+        unsigned long i;
+        int found = 0;
+        for (i = 0; i < n; i++) {
+            found |= (data[i] == key);
+        }
+        EZCTEST_DO_NOT_OPTIMIZE(found);
+    }
+    free(data);
+}
+
+BENCHMARK_RANGE(SearchBench, Binary, 64, 16384, 4) {
+    unsigned long n = state->range;
+    int *data = make_sorted_ints(n);
+    int key = -1;
+
+    ASSERT_TRUE(data != NULL);
+    EXPECT_COMPLEXITY(state, EZCTEST_O_LOG_N);
+    EZCTEST_DO_NOT_OPTIMIZE(data);
+    BENCHMARK_LOOP(state) {
+        unsigned long lo = 0;
+        unsigned long hi = n;
+        while (lo < hi) {
+            unsigned long mid = lo + (hi - lo) / 2;
+            if (data[mid] < key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        EZCTEST_DO_NOT_OPTIMIZE(lo);
+    }
+    free(data);
+}
+
+/* 每个线程只写自己的计数器：相邻计数器共享缓存行时（伪共享）扩展性很差 */
+#define BENCH_MAX_THREADS 4
+#define BENCH_CACHE_LINE 64
+
+static volatile unsigned long g_shared_counters[BENCH_MAX_THREADS];
+static volatile unsigned long
+    g_padded_counters[BENCH_MAX_THREADS][BENCH_CACHE_LINE / sizeof(long)];
+
+BENCHMARK_THREADS(ThreadBench, PaddedCounters, BENCH_MAX_THREADS) {
+    volatile unsigned long *counter =
+        &g_padded_counters[state->thread_index][0];
+
+    BENCHMARK_LOOP(state) {
+        (*counter)++;
+    }
+}
+
+BENCHMARK_THREADS(ThreadBench, FalseSharing, BENCH_MAX_THREADS) {
+    volatile unsigned long *counter = &g_shared_counters[state->thread_index];
+
+    BENCHMARK_LOOP(state) {
+        (*counter)++;
+    }
+}
+
+/* 定义 EZCTEST_ALLOC_HOOKS 时额外输出每次操作的分配次数和字节数 */
+BENCHMARK(AllocBench, MallocFree) {
+    BENCHMARK_LOOP(state) {
+        void *p = malloc(64);
+        EZCTEST_DO_NOT_OPTIMIZE(p);
+        free(p);
+    }
+}
+
+#if !defined(_WIN32)
+/* --ezctest_fork_template 开销的模型：这里手写 fork 循环，并不经过框架的
+ * 模板进程，只估算"每次 fork 后重新 SETUP"与"SETUP 一次后每次只 fork
+ * （写时复制得到准备好的数据）"的差距；真实对比见上面的 TemplateDemo 套件 */
+#define BENCH_FIXTURE_INTS (256 * 1024)
+
+static int *make_fixture(void) {
+    int *data = (int *)malloc(sizeof(int) * BENCH_FIXTURE_INTS);
+    int i;
+
+    for (i = 0; data != NULL && i < BENCH_FIXTURE_INTS; i++) {
+        data[i] = i * 7;
+    }
+    return data;
+}
+
+static void wait_fixture_child(pid_t pid) {
+    int status;
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+    }
+}
+
+BENCHMARK(ForkBench, SetupPerFork) {
+    BENCHMARK_LOOP(state) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            int *data = make_fixture();
+            _exit(data != NULL && data[BENCH_FIXTURE_INTS - 1] > 0 ? 0 : 1);
+        }
+        wait_fixture_child(pid);
+    }
+}
+
+BENCHMARK(ForkBench, ForkFromTemplate) {
+    int *data = make_fixture();
+
+    ASSERT_NOT_NULL(data);
+    BENCHMARK_LOOP(state) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(data[BENCH_FIXTURE_INTS - 1] > 0 ? 0 : 1);
+        }
+        wait_fixture_child(pid);
+    }
+    free(data);
+}
+#endif
+
+BENCHMARK(ArithBench, MulAdd) {
+    unsigned long acc = 1;
+
+    BENCHMARK_LOOP(state) {
+        acc = acc * 33 + 7;
+        /* 只要求结果被算出来，acc 可以一直留在寄存器 */
+        EZCTEST_DO_NOT_OPTIMIZE_REG(acc);
+    }
+}
+
 /* ============================================================================
  * 主函数
  * ========================================================================== */
@@ -656,5 +1200,6 @@ int main(int argc, char *argv[]) {
  *   ./main --filter=FixtureDemo.*  # 运行 FixtureDemo 套件的所有测试
  *   ./main --repeat=5              # 重复运行 5 次
  *   ./main --list                  # 列出所有测试
+ *   ./main --benchmarks            # 运行基准测试（自动标定迭代次数）
  */
 
@@ -18,4 +18,26 @@
   #endif
 #endif
 
-#include "main.c"
\ No newline at end of file
+#include "main.c"
+
+/* ============================================================================
+ * C++：inline 函数和模板中的断言
+ * ========================================================================== */
+
+/* 断言位于 COMDAT 组（inline/模板）时，与普通测试中的断言同在一个文件 */
+inline void ExpectPositive(int value) {
+    EXPECT_GT(value, 0);
+}
+
+template <typename T>
+void ExpectRoundTrip(T value) {
+    T copy = value;
+    EXPECT_EQ(copy, value);
+}
+
+TEST(CppDemo, AssertionsInTemplates) {
+    ExpectPositive(3);
+    ExpectRoundTrip<int>(42);
+    ExpectRoundTrip<long>(42L);
+    EXPECT_TRUE(true);
+}